@@ -5,128 +5,196 @@ SETI group
 Space Sciences Lab
 University of California, Berkeley
 
+To compile: gcc -O -Wall -o analyze gnuplot_i.c datparse.c txtexport.c npyexport.c follow.c seqtrack.c tdigest.c runstats.c checkpoint.c pyramid.c analyze.c -lm -lpthread
+
 This program analyzes the binary data files created by the receive code.
 
 Usage: <program> [filename] [options]
  -e <error checking>  Enable error checking.
  -w <write to file>  Write packets to text file.
+ -csv  Write hits to a comma separated file instead, one hit per row.
+ -tsv  The same, tab separated.
+ -npy <prefix>  Write hits and coarse spectra of the whole series as .npy arrays (not with -j).
  -g <graph>  Plot the data.
+ -j [threads]  Analyze several files at once (not with -g); without a number, one per CPU.
+ -F <follow>  Keep going as receive writes the files, until interrupted (not with -j).
+ -stats <prefix>  Gather statistics of the mean and hit powers of each coarse channel over the run.
+ -ckpt [seconds]  Save the state of the run every so often (default 60 s) and on Ctrl-C, and carry on
+                  from there when started again with the same options (not with -j).
 
   [filename] is the name of the files minus the "_<integer>.dat" to be analyzed.
 First the file "[filename]_1.dat" will be analyzed, then "[filename]_2.dat", and so on
 until no file is found.
 
+With -F the program does not stop at the last file: it waits for receive to add records to
+it and to start the next file, and carries on as they arrive, so error checking and the plot
+stay within about a spectrum (and receive's write buffer) of the capture.  Ctrl-C stops it
+and prints the final report.  It can be started before the first file exists.
+
+With -ckpt the program saves where it is, with everything it has gathered (error counts, the
+sequence check, -stats and -npy state, how much of the text file is written), to
+[filename]_analyze.ckpt every so often and when it is interrupted.  Run again with the same
+options, it carries on from there: output written after the checkpoint is cut off and written
+again, so the results are those of one uninterrupted run (reports already printed before a crash
+may be printed twice).  A run that gets to the end removes the checkpoint.
+
+With -g each spectrum is summed up as it comes in (see pyramid.h), so a plot never has more
+than a screen's worth of points, however far in it is zoomed: the mean power of each coarse bin
+in view and, of the hits, the strongest in each column.  + and - zoom in and out by two, down to
+64 fine bins across, the Left and Right keys move along the band and z shows all of it again.
+
+With -j the files are handed to a pool of worker threads and the reports are put back
+together in file order, so the output is the same as without it, only sooner.
+
 Outputs.
    If error checking is enabled, errors will be reported as output to the screen.
    If write to file is enabled, files will be copied from binary format to text format
    with the same filename but with the extension ".txt" in place of ".dat"
-
+   With -csv or -tsv the extension is ".csv" or ".tsv" and each file has a header row and then
+   a row of time, coarse (PFB) bin, absolute fine bin and power for every hit (see txtexport.h).
+   With -npy <prefix> the hits of all the files go into typed column files <prefix>_time.npy,
+   <prefix>_fine_bin.npy, ... and the mean powers into a spectra by 4096 matrix
+   <prefix>_coarse.npy, which numpy can map without parsing (see npyexport.h).  Ctrl-C stops
+   the run after the record at hand and the arrays are closed with what they have so far.
+   With -stats <prefix> the count, mean, standard deviation, min, max and approximate quantiles
+   of the packet mean power and of the hit power of every coarse channel, over all the files,
+   go to <prefix>.rst (binary) and <prefix>_stats.txt (a table); see runstats.h.  They take the
+   same fixed memory however long the run.  With -j each worker keeps its own and they are
+   merged at the end, so the quantiles can come out a little different.
+
   
    
--------------- IN DEPTH EXPLANATION ----------------------
-
-Each frequency spectrum consists of 4096 polyphase filter bank bins (PFB bins).  Each PFB bin consists of
-32768 bins, which means that each spectrum consists of 134217728 (4096*32678) individual bins.
-
-THE UDP CODE --------------------------------------------------
-
-The UDP code spits UDP packets from the Bee2.  A packet reports all of the information
-regarding one particular PFB bin.  The first three numbers in a packet describe the PFB bin.
-The first number is the PFB bin number, the second number is the mean power, and
-the third number is an error code that is reported from the Bee2 (0 means no error).
-After the first three numbers are reported, every hit in the specified PFB bin is reported.
-Each hit consist of two numbers: which individual bin the hit belongs to, and the power of
-the hit.  Each number is 4 bytes
-
-To summarize, the data field of a UDP packet looks like this:
-PFB bin number
-mean power
-error code
-hit #1 bin number
-hit #1 power
-hit #2 bin number
-hit #2 power
-hit #3 bin number
-hit #3 power
-....
-
-There is a maximum number of hits per PFB bin that will be reported (all others will be ignored).
-This number has yet to be determined, but is temporarily set to 128.
-
-THE RECEIVE CODE ---------------------------------------------
-
+-------------- IN DEPTH EXPLANATION ----------------------
+
+Each frequency spectrum consists of 4096 polyphase filter bank bins (PFB bins).  Each PFB bin consists of
+32768 bins, which means that each spectrum consists of 134217728 (4096*32678) individual bins.
+
+THE UDP CODE --------------------------------------------------
+
+The UDP code spits UDP packets from the Bee2.  A packet reports all of the information
+regarding one particular PFB bin.  The first three numbers in a packet describe the PFB bin.
+The first number is the PFB bin number, the second number is the mean power, and
+the third number is an error code that is reported from the Bee2 (0 means no error).
+After the first three numbers are reported, every hit in the specified PFB bin is reported.
+Each hit consist of two numbers: which individual bin the hit belongs to, and the power of
+the hit.  Each number is 4 bytes
+
+To summarize, the data field of a UDP packet looks like this:
+PFB bin number
+mean power
+error code
+hit #1 bin number
+hit #1 power
+hit #2 bin number
+hit #2 power
+hit #3 bin number
+hit #3 power
+....
+
+There is a maximum number of hits per PFB bin that will be reported (all others will be ignored).
+This number has yet to be determined, but is temporarily set to 128.
+
+THE RECEIVE CODE ---------------------------------------------
+
 The receive code receives these UDP packets from the Bee2.  It then either writes the data to a<cr>
-file or graphs the data.  If the write to file options is chosen, it writes to file a header
-for each packet and the data from the packet.  The header consists of 3 numbers.  The first
-number is the size of the data field in bytes, and the last two numbers are the seconds and
-microseconds of the time stamp from when the packet was received (time since January 1st, 1970).
-Each number is 4 bytes.
-
-The packets are written to file in binary form, each packet representing a PFB bin number.
-A file is closed and the next begun when it has as many packets in it as was specified in
-program execution.  This means that a packet (PFB bin) will never be split up across files,
-but a spectrum may be split up and continued into the next file.
-
-To summarize, the data written to file looks like this:
-length of data
-seconds field of time stamp
-microseconds field of time stamp
-data (PFBbinNumber, meanPower, errorCode, hit #1 bin number, ...)
-
-The filenames will be based on the [filename] parameter entered at the execution of the receive
-code.  Each filename will consist of [filename], a time stamp (seconds since January 1st, 1970),
-the character '_', an integer (a counter for each file), and lastly the extension '.dat'
-
-For example, if I executed the code right now with "./receive -w -f gobears", the files would be named:
-gobears1117039029_1.dat
-gobears1117039029_2.dat
-gobears1117039029_3.dat
-...
-
-THE DATA ANALYSIS CODE ------------------------------------
-
-The data analysis code parses every file in a set.  The filename given as a parameter to the
-program is the name of the file excluding the "_<number>.dat".  For the files in the example
-above, the user would enter "gobears1117039029" as the filename parameter.  Then each file,
-beginning with "gobears1117039029_1.dat", would be parsed until the next file in the series
-cannot be found.
-
-If write to file is enabled, for every ".dat" file a new ".txt" file will be created with
-otherwise the same name, and the data files will be copied into the new files in text format.
-The two numbers representing the time stamp (<sec> and <usec>) will be combined into one
-number of the form '<sec>.<usec>' and the packets will be separated by an extra new line.
-
-If error checking is enabled any error code other than 0 will be reported, as well as any
-missing PFB bin number.
-*/
+file or graphs the data.  If the write to file options is chosen, it writes to file a header
+for each packet and the data from the packet.  The header consists of 3 numbers.  The first
+number is the size of the data field in bytes, and the last two numbers are the seconds and
+microseconds of the time stamp from when the packet was received (time since January 1st, 1970).
+Each number is 4 bytes.
+
+The packets are written to file in binary form, each packet representing a PFB bin number.
+A file is closed and the next begun when it has as many packets in it as was specified in
+program execution.  This means that a packet (PFB bin) will never be split up across files,
+but a spectrum may be split up and continued into the next file.
+
+To summarize, the data written to file looks like this:
+length of data
+seconds field of time stamp
+microseconds field of time stamp
+data (PFBbinNumber, meanPower, errorCode, hit #1 bin number, ...)
+
+The filenames will be based on the [filename] parameter entered at the execution of the receive
+code.  Each filename will consist of [filename], a time stamp (seconds since January 1st, 1970),
+the character '_', an integer (a counter for each file), and lastly the extension '.dat'
+
+For example, if I executed the code right now with "./receive -w -f gobears", the files would be named:
+gobears1117039029_1.dat
+gobears1117039029_2.dat
+gobears1117039029_3.dat
+...
+
+THE DATA ANALYSIS CODE ------------------------------------
+
+The data analysis code parses every file in a set.  The filename given as a parameter to the
+program is the name of the file excluding the "_<number>.dat".  For the files in the example
+above, the user would enter "gobears1117039029" as the filename parameter.  Then each file,
+beginning with "gobears1117039029_1.dat", would be parsed until the next file in the series
+cannot be found.
+
+If write to file is enabled, for every ".dat" file a new ".txt" file will be created with
+otherwise the same name, and the data files will be copied into the new files in text format.
+The two numbers representing the time stamp (<sec> and <usec>) will be combined into one
+number of the form '<sec>.<usec>' and the packets will be separated by an extra new line.
+
+If error checking is enabled any error code other than 0 will be reported, as well as any
+missing PFB bin number.
+
+In parallel mode (-j) each worker writes its file's text file directly and keeps what it would have
+printed in memory.  The main thread prints the reports in file order.  The PFB bin sequence
+runs on across files, so each worker checks its file with a tracker of its own and keeps only
+the records up to the point where that tracker has seen a spectrum start and closed the one
+before it; from there on its state no longer depends on the earlier files.  The main thread
+puts those first records through the run's tracker and, when the two agree, takes over the
+worker's counts, messages and end state.  A file that never gets that far (or a tracker that
+does not agree) is checked again by the main thread from the file itself.
+*/
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <errno.h>
 #include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
 #include "/home/danw/SPECTROSUITE/gnuplot_i-2.10/src/gnuplot_i.h"
+#include "datparse.h"
+#include "txtexport.h"
+#include "npyexport.h"
+#include "follow.h"
+#include "seqtrack.h"
+#include "runstats.h"
+#include "checkpoint.h"
+#include "pyramid.h"
 
 void setTitle();
 void quit();
+void stopFollowing();
+void stopAnalysis();
 void togglePaused();
 void toggleHits();
 void toggleLogPlot();
 void toggleKeyCommands();
 void zoomOut();
+void zoomIn();
+void zoomOutStep();
+void panLeft();
+void panRight();
+void centerView(int center);
+double plotPosition(double fine);
+void drawSpectrum(const pyramid *p);
 
 int endianSwap32(int x);
 
-#define FFT_OVERFLOW_MASK 0x20000000
-#define PFB_OVERFLOW_MASK 0x10000000
-#define CT_ERROR_MASK     0x0F000000
-#define FIFO_OVERRUN_MASK 0x00FFC000
-
 #define INTSIZE 10
 #define ERROR_CHECK 0
 #define PARSE 0
 #define BYTE_SWAPPING 0
-#define MAXHITS 424288
+#define CHECKPOINT_RECORDS 4096     /* records between looks at the clock */
+#define VIEW_DEEPEST 21             /* zoomed in to PYR_FINE >> 21 = 64 fine bins */
+#define CHECK_HEAD_LIMIT (3*SEQ_NUM_BINS)  /* records a worker keeps before its check joins the run's */
+#define NAME_ROOM 16                /* after the filename parameter: "_", 10 digits, ".tsv" and the NUL */
 
 
 gnuplot_ctrl *h1;
@@ -138,37 +206,690 @@ int domainBin = 0;
 int domainAdjustedFrequency = 1;
 char frequencyAdjustmentCmd[100];
 
-/* To be used for malloc..
-double *hitbins;
-double *hitpowers;
-*/
+int frequencyCenter = 2275;
+
+pyramid plotPyramids[2];
+pyramid *building = NULL;                     /* the spectrum coming in */
+pyramid *shown = NULL;                        /* the last one plotted, drawn again when the view moves */
+volatile sig_atomic_t viewLevel = 0;          /* PYR_FINE >> viewLevel fine bins in view */
+volatile sig_atomic_t viewCenter = PYR_FINE / 2;
+volatile sig_atomic_t viewChanged = 0;
+double plotX[PYR_COARSE + 1];
+double plotY[PYR_COARSE + 1];
+double columnStart[PYR_COARSE];
+pyrcell columns[PYR_COARSE];
+
+int errorChecking = 0;
+int writingToTextFile = 0;
+int textLayout = TXT_LEGACY;
+npyexport npyExport;
+int exportingNpy = 0;
+follower fileFollower;
+int following = 0;
+runstats channelStats;
+int gatheringStats = 0;
+int checkpointing = 0;
+int checkpointInterval = 60;
+char checkpointPath[4096];
+uint64_t checkpointKey;
+volatile sig_atomic_t stopRequested = 0;
+
+/* Where a checkpointed run is; the rest of its state is checker, channelStats and npyExport */
+typedef struct ckptposition_s {
+	int32_t file;               /* the next record to analyze is in this file */
+	int32_t errorCodes;         /* reported so far */
+	uint64_t offset;            /* at this byte */
+	uint64_t textBytes;         /* of the file's text output, covering the records before offset */
+} ckptposition;
+
+/* What error checking needs of a record; in parallel mode the workers keep the first few of a file */
+typedef struct checkrecord_s {
+	uint32_t pfbBin;
+	uint32_t errorCode;
+	int32_t sec;
+	int32_t usec;
+} checkrecord;
+
+/* Error checking: the PFB bin sequence, and when the spectra it still has open were seen */
+typedef struct errorcheck_s {
+	seqtrack sequence;
+	seqloss loss;
+	int32_t firstSec[2], firstUSec[2];    /* by spectrum number & 1 */
+	int32_t lastSec[2], lastUSec[2];
+} errorcheck;
+
+errorcheck checker;
+
+/* Where a worker printed a spectrum number counted from the start of its file */
+typedef struct checkpatch_s {
+	long offset;                /* in checkReport */
+	int digits;
+	uint64_t spectrum;
+} checkpatch;
+
+/* A file analyzed by a worker in parallel mode, waiting to be reported */
+typedef struct fileresult_s {
+	int done;
+	int textFailed;             /* its text file could not be created */
+	checkrecord *head;          /* its records up to the join, for the run's tracker */
+	size_t nhead;
+	size_t headCapacity;
+	int headOverflow;           /* more than CHECK_HEAD_LIMIT of them; the main thread reads the file again */
+	int joined;                 /* its own check got to a state that earlier files cannot change */
+	errorcheck *check;          /* its own check; counts only what came after the join */
+	int joinLastbin;            /* the state it was in at the join */
+	uint64_t joinSpectrum;
+	uint64_t joinCurrent[SEQ_BITMAP_WORDS];
+	int errorCodes;             /* reported after the join */
+	FILE *checkOut;
+	char *checkReport;          /* what its check printed; the part after joinOffset is used */
+	size_t checkReportBytes;
+	long joinOffset;
+	checkpatch *patches;        /* spectrum numbers in that part */
+	size_t npatches;
+	size_t patchCapacity;
+	char *report;               /* anything else serial mode would have printed for it */
+	size_t reportBytes;
+} fileresult;
+
+typedef struct filepool_s {
+	const char *fileheader;
+	int numberOfFiles;
+	int next;                   /* next file to hand out */
+	int reported;               /* files already printed by the main thread */
+	int window;                 /* how far ahead of the printing the workers may get */
+	fileresult *results;        /* indexed by file number */
+	runstats *stats;            /* one per worker with -stats, merged at the end */
+	int workers;                /* workers that have taken theirs */
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+} filepool;
+
+/* Puts the name of file i of the series, with the given extension, in name; 0 if it does not fit */
+int series_name(char *name, size_t size, const char *fileheader, int i, const char *extension)
+{
+	int n = snprintf(name, size, "%s%i.%s", fileheader, i, extension);
+
+	if((n < 0) || ((size_t)n >= size)){
+		printf("Error: the name of file %i of %s is too long.\n", i, fileheader);
+		return 0;
+	}
+	return 1;
+}
+
+/* One line per incomplete spectrum, its gaps as ranges of PFB bins */
+void print_incomplete(FILE *out, const errorcheck *c, uint64_t spectrum, const uint64_t *bitmap, int present)
+{
+	int slot = spectrum & 1;
+	int first, last = -1, ranges = 0;
+
+	fprintf(out, "Spectrum %llu (%i.%06i to %i.%06i) missing %i PFB bins:", (unsigned long long)spectrum,
+		c->firstSec[slot], c->firstUSec[slot], c->lastSec[slot], c->lastUSec[slot], SEQ_NUM_BINS - present);
+	while(seq_next_gap(bitmap, last+1, &first, &last)){
+		if((ranges > 0) && (ranges % 16 == 0)){
+			fprintf(out, ",\n    ");
+		}
+		else if(ranges > 0){
+			fprintf(out, ",");
+		}
+		if(first == last){
+			fprintf(out, " %i", first);
+		}
+		else{
+			fprintf(out, " %i-%i", first, last);
+		}
+		ranges++;
+	}
+	fprintf(out, "\n");
+}
+
+void report_incomplete(void *arg, uint64_t spectrum, const uint64_t *bitmap, int present)
+{
+	print_incomplete(stdout, (errorcheck *)arg, spectrum, bitmap, present);
+}
+
+/* The same in a worker, which notes where the number went so the main thread can correct it */
+void report_incomplete_part(void *arg, uint64_t spectrum, const uint64_t *bitmap, int present)
+{
+	fileresult *res = (fileresult *)arg;
+	checkpatch *grown;
+
+	if(res->joined){
+		if(res->npatches == res->patchCapacity){
+			res->patchCapacity = res->patchCapacity ? 2*res->patchCapacity : 16;
+			grown = (checkpatch *)realloc(res->patches, res->patchCapacity * sizeof(checkpatch));
+			if(grown == NULL){
+				printf("Out of memory.\n");
+				quit();
+			}
+			res->patches = grown;
+		}
+		res->patches[res->npatches].offset = ftell(res->checkOut) + strlen("Spectrum ");
+		res->patches[res->npatches].digits = snprintf(NULL, 0, "%llu", (unsigned long long)spectrum);
+		res->patches[res->npatches].spectrum = spectrum;
+		res->npatches++;
+	}
+	print_incomplete(res->checkOut, res->check, spectrum, bitmap, present);
+}
+
+/* Points the tracker of c at its loss table, which a copy read back from a checkpoint needs too */
+void check_attach(errorcheck *c)
+{
+	c->loss.incomplete = report_incomplete;
+	c->loss.arg = c;
+	c->sequence.loss = &c->loss;
+}
+
+void check_start(errorcheck *c)
+{
+	memset(c, 0, sizeof(errorcheck));
+	seq_init(&c->sequence);
+	check_attach(c);
+}
+
+/* Follows the PFB bin sequence; spectra are reported as they are finalized, a little behind */
+void check_sequence(FILE *out, errorcheck *c, uint32_t PFBbinNumber, uint32_t errorCode, int32_t sec, int32_t usec)
+{
+	int starting = !c->sequence.started;
+	int slot;
+
+	if(PFBbinNumber > 4095){
+		fprintf(out, "PFBbinNumber %i out of range (0 to 4095) at time %i.%06i\n", PFBbinNumber, sec, usec);
+	}
+	if(seq_track(&c->sequence, PFBbinNumber, errorCode) || (starting && c->sequence.started)){
+		slot = c->sequence.spectrum & 1;
+		c->firstSec[slot] = sec;
+		c->firstUSec[slot] = usec;
+		c->lastSec[slot] = sec;
+		c->lastUSec[slot] = usec;
+	}
+	else if((int)PFBbinNumber == c->sequence.lastbin){
+		slot = c->sequence.spectrum & 1;
+		c->lastSec[slot] = sec;
+		c->lastUSec[slot] = usec;
+	}
+}
+
+/* Finalizes the last spectra and prints the totals and the loss table */
+void check_report(errorcheck *c, int numberOfErrorCodesReported)
+{
+	const seqstats *st = &c->sequence.stats;
+	int bin, first;
+
+	seq_finish(&c->sequence);
+	printf("\nFinal report:\n");
+	printf("Missing %llu PFB bins in %llu gaps\n", (unsigned long long)st->binsMissing, (unsigned long long)c->loss.ranges);
+	printf("%i error codes reported\n", numberOfErrorCodesReported);
+	printf("Spectra: %llu, %llu complete, %llu incomplete\n", (unsigned long long)st->spectra,
+		(unsigned long long)st->spectraComplete, (unsigned long long)(st->spectra - st->spectraComplete));
+	printf("Packets: %llu, %llu duplicate, %llu out of order, %llu late, %llu out of range\n",
+		(unsigned long long)st->packets, (unsigned long long)st->duplicates, (unsigned long long)st->outOfOrder,
+		(unsigned long long)st->late, (unsigned long long)st->outOfRange);
+	if(st->binsMissing == 0){
+		return;
+	}
+	/* runs of PFB bins lost from the same number of spectra share a line */
+	printf("Spectra missing each PFB bin:\n");
+	for(bin=0; bin<SEQ_NUM_BINS; bin=first){
+		first = bin + 1;
+		while((first < SEQ_NUM_BINS) && (c->loss.missingByBin[first] == c->loss.missingByBin[bin])){
+			first++;
+		}
+		if(c->loss.missingByBin[bin] == 0){
+			continue;
+		}
+		if(first - 1 == bin){
+			printf("     PFB bin %i: %llu\n", bin, (unsigned long long)c->loss.missingByBin[bin]);
+		}
+		else{
+			printf("     PFB bins %i-%i: %llu\n", bin, first - 1, (unsigned long long)c->loss.missingByBin[bin]);
+		}
+	}
+}
+
+/* Reports each error the Bee2 flagged in the record; returns how many */
+int check_error_code(FILE *out, uint32_t PFBbinNumber, uint32_t errorCode)
+{
+	int reported = 0;
+
+	if((errorCode & FFT_OVERFLOW_MASK) > 0){
+		fprintf(out, "FFT overflow reported in PFBbinNumber %i\n", PFBbinNumber);
+		reported++;
+	}
+	if((errorCode & PFB_OVERFLOW_MASK) > 0){
+		fprintf(out, "PFB overflow reported in PFBbinNumber %i\n", PFBbinNumber);
+		reported++;
+	}
+	if((errorCode & CT_ERROR_MASK) > 0){
+		fprintf(out, "Corner Turner error reported in PFBbinNumber %i\n", PFBbinNumber);
+		reported++;
+	}
+	if((errorCode & FIFO_OVERRUN_MASK) > 0){
+		fprintf(out, "FIFO overrun reported in PFBbinNumber %i\n", PFBbinNumber);
+		reported++;
+	}
+	return reported;
+}
+
+/* A worker's error checking of one record; see fileresult */
+void check_part(fileresult *res, const datrecord *record)
+{
+	errorcheck *c = res->check;
+	checkrecord *grown;
+
+	if(res->joined){
+		check_sequence(res->checkOut, c, record->pfbBin, record->errorCode, record->sec, record->usec);
+		res->errorCodes += check_error_code(res->checkOut, record->pfbBin, record->errorCode);
+		return;
+	}
+	if(res->headOverflow){
+		return;
+	}
+	if(res->nhead == CHECK_HEAD_LIMIT){
+		res->headOverflow = 1;
+		free(res->head);
+		res->head = NULL;
+		res->nhead = 0;
+		return;
+	}
+	if(res->nhead == res->headCapacity){
+		res->headCapacity = res->headCapacity ? 2*res->headCapacity : 1024;
+		grown = (checkrecord *)realloc(res->head, res->headCapacity * sizeof(checkrecord));
+		if(grown == NULL){
+			printf("Out of memory.\n");
+			quit();
+		}
+		res->head = grown;
+	}
+	res->head[res->nhead].pfbBin = record->pfbBin;
+	res->head[res->nhead].errorCode = record->errorCode;
+	res->head[res->nhead].sec = record->sec;
+	res->head[res->nhead].usec = record->usec;
+	res->nhead++;
+
+	check_sequence(res->checkOut, c, record->pfbBin, record->errorCode, record->sec, record->usec);
+	/* a spectrum has started and the one before it is closed: nothing from before this file matters now */
+	if((c->sequence.spectrum > 0) && !c->sequence.previousOpen){
+		res->joined = 1;
+		res->joinLastbin = c->sequence.lastbin;
+		res->joinSpectrum = c->sequence.spectrum;
+		memcpy(res->joinCurrent, c->sequence.current, sizeof(res->joinCurrent));
+		memset(&c->sequence.stats, 0, sizeof(seqstats));
+		c->loss.ranges = 0;
+		memset(c->loss.missingByBin, 0, sizeof(c->loss.missingByBin));
+		res->joinOffset = ftell(res->checkOut);
+	}
+}
+
+/* Does for file i what the serial loop does, into res instead of onto the screen */
+void analyze_file(const char *fileheader, int i, fileresult *res, runstats *stats)
+{
+	char filename[100];
+	char filenameToWrite[100];
+	FILE *out;
+	txtexport textFile;
+	int textOpen = 0;
+	datfile datFile;
+	datrecord record;
+
+	out = open_memstream(&res->report, &res->reportBytes);
+	if(out == NULL){
+		printf("Out of memory.\n");
+		quit();
+	}
+	if(errorChecking){
+		res->check = (errorcheck *)malloc(sizeof(errorcheck));
+		if(res->check != NULL){
+			res->checkOut = open_memstream(&res->checkReport, &res->checkReportBytes);
+		}
+		if(res->checkOut == NULL){
+			printf("Out of memory.\n");
+			quit();
+		}
+		check_start(res->check);
+		res->check->loss.incomplete = report_incomplete_part;
+		res->check->loss.arg = res;
+	}
+
+	if(!series_name(filename, sizeof(filename), fileheader, i, "dat")){
+		quit();
+	}
+	if(writingToTextFile){
+		if(!series_name(filenameToWrite, sizeof(filenameToWrite), fileheader, i, txt_extension(textLayout))){
+			quit();
+		}
+		textOpen = txt_open(&textFile, filenameToWrite, textLayout);
+		if(!textOpen){
+			res->textFailed = 1;
+		}
+	}
+
+	if(dat_open(&datFile, filename, BYTE_SWAPPING)){
+		while(dat_next(&datFile, &record)){
+			if(textOpen){
+				txt_record(&textFile, &record);
+			}
+			if(stats != NULL){
+				rs_record(stats, &record);
+			}
+			if(errorChecking){
+				check_part(res, &record);
+			}
+		}
+		if(datFile.truncated || datFile.corrupt){
+			fprintf(out, "Warning: %s %s at byte %lu, the rest of it is skipped.\n", filename,
+				datFile.truncated ? "ends inside a record" : "has a damaged record", (unsigned long)datFile.offset);
+		}
+		dat_close(&datFile);
+	}
+	if(textOpen && !txt_close(&textFile)){
+		fprintf(out, "Error: could not write all of %s (%s).\n", filenameToWrite, strerror(textFile.error));
+	}
+	if(errorChecking){
+		fclose(res->checkOut);
+	}
+	fclose(out);
+}
+
+void *analyze_thread(void *arg)
+{
+	filepool *pool = (filepool *)arg;
+	runstats *stats = NULL;
+	int i;
+
+	pthread_mutex_lock(&pool->lock);
+	if(pool->stats != NULL){
+		stats = &pool->stats[pool->workers];
+	}
+	pool->workers++;
+	pthread_mutex_unlock(&pool->lock);
+
+	while(1){
+		pthread_mutex_lock(&pool->lock);
+		while((pool->next <= pool->numberOfFiles) && (pool->next > pool->reported + pool->window)){
+			pthread_cond_wait(&pool->cond, &pool->lock);
+		}
+		i = pool->next;
+		if(i > pool->numberOfFiles){
+			pthread_mutex_unlock(&pool->lock);
+			break;
+		}
+		pool->next++;
+		pthread_mutex_unlock(&pool->lock);
+
+		analyze_file(pool->fileheader, i, &pool->results[i], stats);
+
+		pthread_mutex_lock(&pool->lock);
+		pool->results[i].done = 1;
+		pthread_cond_broadcast(&pool->cond);
+		pthread_mutex_unlock(&pool->lock);
+	}
+	return NULL;
+}
+
+/* Checks file i from record skip on, for when a worker's check cannot be joined to the run's */
+int check_file(const char *fileheader, int i, size_t skip)
+{
+	char filename[100];
+	datfile datFile;
+	datrecord record;
+	size_t n = 0;
+	int reported = 0;
+
+	if(!series_name(filename, sizeof(filename), fileheader, i, "dat")){
+		quit();
+	}
+	if(dat_open(&datFile, filename, BYTE_SWAPPING)){
+		while(dat_next(&datFile, &record)){
+			if(n++ < skip){
+				continue;
+			}
+			check_sequence(stdout, &checker, record.pfbBin, record.errorCode, record.sec, record.usec);
+			reported += check_error_code(stdout, record.pfbBin, record.errorCode);
+		}
+		dat_close(&datFile);
+	}
+	return reported;
+}
+
+/* Takes over a worker's check from its join on, if c has come to the same state there */
+int check_join(errorcheck *c, const fileresult *r)
+{
+	const errorcheck *w = r->check;
+	uint64_t offset;
+	long at;
+	size_t p;
+	int slot, bin;
+
+	if(!c->sequence.started || c->sequence.previousOpen || (c->sequence.lastbin != r->joinLastbin)
+		|| (memcmp(c->sequence.current, r->joinCurrent, sizeof(r->joinCurrent)) != 0)){
+		return 0;
+	}
+	offset = c->sequence.spectrum - r->joinSpectrum;
+
+	at = r->joinOffset;
+	for(p=0; p<r->npatches; p++){
+		fwrite(r->checkReport + at, 1, r->patches[p].offset - at, stdout);
+		printf("%llu", (unsigned long long)(r->patches[p].spectrum + offset));
+		at = r->patches[p].offset + r->patches[p].digits;
+	}
+	fwrite(r->checkReport + at, 1, r->checkReportBytes - at, stdout);
+
+	seq_add(&c->sequence.stats, &w->sequence.stats);
+	c->loss.ranges += w->loss.ranges;
+	for(bin=0; bin<SEQ_NUM_BINS; bin++){
+		c->loss.missingByBin[bin] += w->loss.missingByBin[bin];
+	}
+	c->sequence.lastbin = w->sequence.lastbin;
+	c->sequence.spectrum = w->sequence.spectrum + offset;
+	c->sequence.previousOpen = w->sequence.previousOpen;
+	memcpy(c->sequence.current, w->sequence.current, sizeof(c->sequence.current));
+	memcpy(c->sequence.previous, w->sequence.previous, sizeof(c->sequence.previous));
+	for(slot=0; slot<2; slot++){
+		c->firstSec[(slot + offset) & 1] = w->firstSec[slot];
+		c->firstUSec[(slot + offset) & 1] = w->firstUSec[slot];
+		c->lastSec[(slot + offset) & 1] = w->lastSec[slot];
+		c->lastUSec[(slot + offset) & 1] = w->lastUSec[slot];
+	}
+	return 1;
+}
+
+/* Brings the run's check through file i: its first records, then what its worker found after them */
+int check_stitch(const char *fileheader, int i, const fileresult *r)
+{
+	size_t j;
+	int reported = 0;
+
+	if(r->headOverflow){
+		return check_file(fileheader, i, 0);
+	}
+	for(j=0; j<r->nhead; j++){
+		check_sequence(stdout, &checker, r->head[j].pfbBin, r->head[j].errorCode, r->head[j].sec, r->head[j].usec);
+		reported += check_error_code(stdout, r->head[j].pfbBin, r->head[j].errorCode);
+	}
+	if(r->joined){
+		if(check_join(&checker, r)){
+			reported += r->errorCodes;
+		}
+		else{
+			reported += check_file(fileheader, i, r->nhead);
+		}
+	}
+	return reported;
+}
+
+/* Analyzes the files with a pool of threads and prints the reports in file order */
+void analyze_parallel(const char *fileheader, int numberOfFiles, int threads, int *numberOfErrorCodesReported)
+{
+	filepool pool;
+	fileresult *r;
+	pthread_t *workers;
+	sigset_t all, previous;
+	int i, started = 0;
+
+	if(threads <= 0){
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if(threads > numberOfFiles){
+		threads = numberOfFiles;
+	}
+	if(threads < 1){
+		threads = 1;
+	}
+
+	memset(&pool, 0, sizeof(pool));
+	pool.fileheader = fileheader;
+	pool.numberOfFiles = numberOfFiles;
+	pool.next = 1;
+	pool.window = 4*threads;
+	pool.results = (fileresult *)calloc(numberOfFiles+1, sizeof(fileresult));
+	workers = (pthread_t *)calloc(threads, sizeof(pthread_t));
+	if(gatheringStats){
+		pool.stats = (runstats *)malloc(threads * sizeof(runstats));
+		for(i=0; (pool.stats != NULL) && (i<threads); i++){
+			rs_init(&pool.stats[i]);
+		}
+	}
+	if((pool.results == NULL) || (workers == NULL) || (gatheringStats && (pool.stats == NULL))){
+		printf("Out of memory.\n");
+		quit();
+	}
+	pthread_mutex_init(&pool.lock, NULL);
+	pthread_cond_init(&pool.cond, NULL);
+
+	/* the signals are for the main thread */
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &previous);
+	for(i=0; i<threads; i++){
+		if(pthread_create(&workers[i], NULL, analyze_thread, &pool) != 0){
+			break;
+		}
+		started++;
+	}
+	pthread_sigmask(SIG_SETMASK, &previous, NULL);
+	if(started == 0){
+		printf("Could not start any worker threads.\n");
+		quit();
+	}
+	printf("Analyzing with %i threads.\n", started);
+
+	for(i=1; i<=numberOfFiles; i++){
+		pthread_mutex_lock(&pool.lock);
+		while(!pool.results[i].done){
+			pthread_cond_wait(&pool.cond, &pool.lock);
+		}
+		pthread_mutex_unlock(&pool.lock);
+		r = &pool.results[i];
+
+		printf("\nParsing file %i------------------------------------\n", i);
+		if(r->textFailed){
+			printf("Error: could not open %s%i.%s to write to.\n", fileheader, i, txt_extension(textLayout));
+		}
+		/* the sequence runs on across files, so it is joined up here in order */
+		if(errorChecking){
+			*numberOfErrorCodesReported += check_stitch(fileheader, i, r);
+			free(r->head);
+			free(r->check);
+			free(r->checkReport);
+			free(r->patches);
+			r->head = NULL;
+			r->check = NULL;
+			r->checkReport = NULL;
+			r->patches = NULL;
+		}
+		fwrite(r->report, 1, r->reportBytes, stdout);
+		free(r->report);
+		r->report = NULL;
+
+		pthread_mutex_lock(&pool.lock);
+		pool.reported = i;
+		pthread_cond_broadcast(&pool.cond);
+		pthread_mutex_unlock(&pool.lock);
+	}
+
+	for(i=0; i<started; i++){
+		pthread_join(workers[i], NULL);
+	}
+	if(pool.stats != NULL){
+		for(i=0; i<started; i++){
+			rs_merge(&channelStats, &pool.stats[i]);
+		}
+		free(pool.stats);
+	}
+	pthread_mutex_destroy(&pool.lock);
+	pthread_cond_destroy(&pool.cond);
+	free(workers);
+	free(pool.results);
+}
+
+/* What a checkpoint holds, in order; npy is NULL without -npy */
+int checkpoint_sections(ckptsection *sections, ckptposition *position, npyexport *npy)
+{
+	sections[0].data = position;
+	sections[0].size = sizeof(ckptposition);
+	sections[1].data = &checker;
+	sections[1].size = errorChecking ? sizeof(errorcheck) : 0;
+	sections[2].data = &channelStats;
+	sections[2].size = gatheringStats ? sizeof(runstats) : 0;
+	sections[3].data = npy;
+	sections[3].size = (npy != NULL) ? sizeof(npyexport) : 0;
+	return 4;
+}
+
+/* text is the open text output of position->file, if any; what has been written goes to disk first */
+void save_checkpoint(ckptposition *position, txtexport *text)
+{
+	ckptsection sections[CKPT_MAX_SECTIONS];
+	int n;
+
+	if(text != NULL){
+		txt_sync(text);
+		position->textBytes = text->bytes;
+	}
+	if(exportingNpy){
+		npy_sync(&npyExport);
+	}
+	n = checkpoint_sections(sections, position, exportingNpy ? &npyExport : NULL);
+	if(!ckpt_save(checkpointPath, checkpointKey, sections, n)){
+		printf("Warning: could not write the checkpoint %s (%s).\n", checkpointPath, strerror(errno));
+	}
+}
 
 
 int main (int argc, const char * argv[]) {
 
-	int errorChecking=0;
-	int writingToTextFile=0;
 	int plotting=0;
+	int parallel=0;
+	const char *npyPrefix = NULL;
+	const char *statsPrefix = NULL;
+	char statsPath[4096];
+	ckptposition position;
+	ckptsection sections[CKPT_MAX_SECTIONS];
+	npyexport *savedNpy = NULL;
+	const char **keyArguments;
+	int keyCount, loaded;
+	int resuming = 0, interrupted = 0, recordsSinceCheck = 0;
+	time_t nextCheckpoint = 0;
+	const char *failedPath;
+	int failure;
+	int threads=0;
 	
-	FILE *fp;
-	FILE *fpToWrite;
+	txtexport textFile;
+	int textOpen=0;
 	int numberOfFiles;
 	char filename[100];
 	char filenameToWrite[100];
 	char fileheader[100];
-	int counter;
-	int numberOfMissingPFBbins;
 	int numberOfErrorCodesReported;
 	
 	
 	
-	int i, j;
+	int i;
 	char *datebuf;
 	
 
-	int firstPFBbinNumberFlag=1;
-	unsigned int bytesOfData, sec, usec, lastSec, lastUSec, PFBbinNumber, lastPFBbinNumber, meanPower, errorCode;
-	char dummy[1036];
+	datfile datFile;
+	datrecord record;
 
 	char pauseCommand[100];
 	char zoomOutCommand[100];
@@ -176,35 +897,17 @@ int main (int argc, const char * argv[]) {
 	char toggleHitsCommand[100];
 	char toggleLogPlotCommand[100];
 	char toggleKeyCommandsCommand[100];	
-
-	double binsLeft[2049];
-	double avgpowerLeft[2049];
-	double binsRight[2049];
-	double avgpowerRight[2049];
-	double binsConnection[2];
-	double avgpowerConnection[2];
-	
-	//Reduced to meet dave's basic needs
-	double hitbins[MAXHITS];
-	double hitpowers[MAXHITS];
-
-	int frequencyCenter = 2275;
+	char zoomInCommand[100];
+	char zoomOutStepCommand[100];
+	char panLeftCommand[100];
+	char panRightCommand[100];
 
 	int processID=0;
 
-	int totalHits = 0;
-	int totalBins = 0;
 	int lastbin = -1;
-	int pktcountLeft = 0;
-	int pktcountRight = 0;	
         
         time_t atime;
-	unsigned int curavgpower, currentbin, currentPFBbin, tempbin, temppower;
-
-	/* Worthless malloc code
-	hitbins = (double *)malloc(MAXHITS * 8);
-	hitpowers = (double *)malloc(MAXHITS *8);
-	*/
+	unsigned int currentbin;
 
 
 
@@ -214,6 +917,12 @@ int main (int argc, const char * argv[]) {
 		printf(" -g <plotting>\n");
 		printf(" -e <error checking>\n");
 		printf(" -w <write to file>  Write packets to text file.\n");
+		printf(" -csv, -tsv  Write hits to a CSV or TSV file, one per row.\n");
+		printf(" -npy <prefix>  Write hits and coarse spectra as .npy arrays.\n");
+		printf(" -j [threads]  Analyze files in parallel.\n");
+		printf(" -F <follow>  Follow the files as they are written.\n");
+		printf(" -stats <prefix>  Write statistics of each coarse channel to <prefix>.rst and <prefix>_stats.txt.\n");
+		printf(" -ckpt [seconds]  Save the state every so often and carry on from it when run again.\n");
 		quit();
 	}
 	else{
@@ -225,10 +934,45 @@ int main (int argc, const char * argv[]) {
 			}
 			else if(strcmp(argv[i], "-w") == 0){
 				writingToTextFile = 1;
+				textLayout = TXT_LEGACY;
+			}
+			else if(strcmp(argv[i], "-csv") == 0){
+				writingToTextFile = 1;
+				textLayout = TXT_CSV;
+			}
+			else if(strcmp(argv[i], "-tsv") == 0){
+				writingToTextFile = 1;
+				textLayout = TXT_TSV;
 			}
 			else if(strcmp(argv[i], "-g") == 0){
 				plotting = 1;
 			}
+			else if((strcmp(argv[i], "-stats") == 0) && (i+1 < argc)){
+				statsPrefix = argv[i+1];
+				gatheringStats = 1;
+				i++;
+			}
+			else if((strcmp(argv[i], "-npy") == 0) && (i+1 < argc)){
+				npyPrefix = argv[i+1];
+				i++;
+			}
+			else if(strcmp(argv[i], "-F") == 0){
+				following = 1;
+			}
+			else if(strcmp(argv[i], "-ckpt") == 0){
+				checkpointing = 1;
+				if((i+2 <= argc) && (strncmp(argv[i+1], "-", 1) != 0) && (atoi(argv[i+1]) > 0)){
+					checkpointInterval = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if(strcmp(argv[i], "-j") == 0){
+				parallel = 1;
+				if((i+2 <= argc) && (strncmp(argv[i+1], "-", 1) != 0) && (atoi(argv[i+1]) > 0)){
+					threads = atoi(argv[i+1]);
+					i++;
+				}
+			}
 			else if(strcmp(argv[i], "-d1") == 0){
 				domainBin = 1;
 				domainAdjustedFrequency = 0;
@@ -244,6 +988,10 @@ int main (int argc, const char * argv[]) {
 					frequencyCenter = 0;
 				}
 			}
+			else if(strlen(argv[i]) > sizeof(fileheader) - NAME_ROOM){
+				printf("The filename %s is too long.\n", argv[i]);
+				quit();
+			}
 			else strcpy(fileheader, argv[i]);
 		}
 	}
@@ -255,40 +1003,74 @@ int main (int argc, const char * argv[]) {
 
 	strcat(fileheader, "_");
 
+	if(parallel && plotting){
+		printf("Plotting (-g) shows the spectra in order and cannot be combined with -j.\n");
+		quit();
+	}
+	if(parallel && following){
+		printf("-F follows the files in order as they are written and cannot be combined with -j.\n");
+		quit();
+	}
+	if(parallel && (npyPrefix != NULL)){
+		printf("-npy writes one set of arrays for the whole series in order and cannot be combined with -j.\n");
+		quit();
+	}
+	if(parallel && checkpointing){
+		printf("-ckpt saves the place of one reader in the series and cannot be combined with -j.\n");
+		quit();
+	}
+	if(checkpointing){
+		snprintf(checkpointPath, sizeof(checkpointPath), "%sanalyze.ckpt", fileheader);
+		/* the same options make the same job, however often it checkpoints */
+		keyArguments = (const char **)malloc(argc * sizeof(const char *));
+		if(keyArguments == NULL){
+			printf("Out of memory.\n");
+			quit();
+		}
+		keyCount = 0;
+		for(i=0; i<argc; i++){
+			if(strcmp(argv[i], "-ckpt") == 0){
+				if((i+2 <= argc) && (strncmp(argv[i+1], "-", 1) != 0) && (atoi(argv[i+1]) > 0)){
+					i++;
+				}
+				continue;
+			}
+			keyArguments[keyCount++] = argv[i];
+		}
+		checkpointKey = ckpt_key(keyCount, keyArguments);
+		free(keyArguments);
+	}
+
 	if(errorChecking){
 		printf("Error checking enabled.\n");
 	}
 	if(writingToTextFile){
-		printf("Writing to text file enabled.\n");
+		printf("Writing to %s file enabled.\n", (textLayout == TXT_LEGACY) ? "text" : (textLayout == TXT_CSV) ? "CSV" : "TSV");
 	}
 	if(plotting){
 		printf("Plotting enabled.\n");
 	}
+	if(npyPrefix != NULL){
+		printf("Writing to %s_*.npy enabled.\n", npyPrefix);
+	}
+	if(gatheringStats){
+		printf("Channel statistics enabled.\n");
+		rs_init(&channelStats);
+	}
 
 	/* find the number of files */
-	counter=1;
-	
-	sprintf(filename, "%s%i.dat", fileheader, counter);
-	fp = fopen(filename, "rb");
-	
-	if(fp != NULL){
-	        fread(&bytesOfData, sizeof(int), 1, fp);
-	        fread(&sec, sizeof(int), 1, fp);
-		fread(&usec, sizeof(int), 1, fp);
-		atime = (time_t) sec;
-		
-		datebuf = ctime(&atime);
-
+	if(!series_name(filename, sizeof(filename), fileheader, 1, "dat")){
+		quit();
 	}
-
-
-	while(fp != NULL){		
-		fclose(fp);
-		counter++;
-		sprintf(filename, "%s%i.dat", fileheader, counter);
-		fp = fopen(filename, "rb");
+	datebuf = "an unknown date (no complete record in the first file)\n";
+	if(dat_open(&datFile, filename, BYTE_SWAPPING)){
+		if(dat_next(&datFile, &record)){
+			atime = (time_t) record.sec;
+			datebuf = ctime(&atime);
+		}
+		dat_close(&datFile);
 	}
-	numberOfFiles = counter-1;
+	numberOfFiles = dat_series_count(fileheader);
 	if(numberOfFiles == 1){
 		printf("Found 1 file.\n");
 	}
@@ -296,7 +1078,7 @@ int main (int argc, const char * argv[]) {
 		printf("Found %i files.\n", numberOfFiles);	
 	}
 	
-	if((numberOfFiles == 0) || (!errorChecking && !writingToTextFile && !plotting)){
+	if(((numberOfFiles == 0) && !following) || (!errorChecking && !writingToTextFile && !plotting && (npyPrefix == NULL) && !gatheringStats)){
 		quit();
 	}
 
@@ -307,23 +1089,100 @@ int main (int argc, const char * argv[]) {
 
 
 
-//	if(errorChecking){
-		numberOfMissingPFBbins=0;
-		numberOfErrorCodesReported=0;
-		lastSec = 0;
-		lastUSec = 0;
-		lastPFBbinNumber = 0;
-//	}
+	numberOfErrorCodesReported=0;
+	check_start(&checker);
+	memset(&position, 0, sizeof(position));
+	position.file = 1;
+
+	if(checkpointing){
+		if(npyPrefix != NULL){
+			savedNpy = (npyexport *)malloc(sizeof(npyexport));
+			if(savedNpy == NULL){
+				printf("Out of memory.\n");
+				quit();
+			}
+		}
+		loaded = ckpt_load(checkpointPath, checkpointKey, sections, checkpoint_sections(sections, &position, savedNpy));
+		if(loaded == CKPT_LOADED){
+			check_attach(&checker);
+			numberOfErrorCodesReported = position.errorCodes;
+			resuming = 1;
+			printf("Carrying on from %s at file %i, byte %llu.\n", checkpointPath, position.file, (unsigned long long)position.offset);
+		}
+		else{
+			if(loaded == CKPT_MISMATCH){
+				printf("Warning: %s is not from a run with these options, or is damaged; starting over.\n", checkpointPath);
+			}
+			/* a checkpoint that did not load may have left part of itself behind */
+			check_start(&checker);
+			if(gatheringStats){
+				rs_init(&channelStats);
+			}
+			memset(&position, 0, sizeof(position));
+			position.file = 1;
+		}
+		nextCheckpoint = time(NULL) + checkpointInterval;
+	}
+
+	if((npyPrefix != NULL) && resuming){
+		if(!npy_resume(&npyExport, npyPrefix, savedNpy)){
+			failedPath = npy_failure(&npyExport, &failure);
+			printf("Error: could not carry on with %s (%s); remove %s to start over.\n", failedPath, strerror(failure), checkpointPath);
+			quit();
+		}
+		exportingNpy = 1;
+	}
+	else if(npyPrefix != NULL){
+		if(!npy_open(&npyExport, npyPrefix)){
+			failedPath = npy_failure(&npyExport, &failure);
+			printf("Error: could not create %s (%s).\n", failedPath, strerror(failure));
+			quit();
+		}
+		exportingNpy = 1;
+	}
 
 	signal(SIGHUP, quit);
 	signal(SIGINT, quit);
 	signal(SIGQUIT, quit);
+	if(following){
+		if(!follow_start(&fileFollower, fileheader)){
+			printf("File name %s is too long to follow.\n", fileheader);
+			quit();
+		}
+		/* stop waiting and finish the report instead */
+		signal(SIGHUP, stopFollowing);
+		signal(SIGINT, stopFollowing);
+		signal(SIGQUIT, stopFollowing);
+	}
+	if(checkpointing){
+		/* stop after the record at hand and save the place */
+		signal(SIGHUP, stopAnalysis);
+		signal(SIGINT, stopAnalysis);
+		signal(SIGQUIT, stopAnalysis);
+		signal(SIGTERM, stopAnalysis);
+	}
+	else if(exportingNpy && !following){
+		/* the main loop closes the exporter, a handler in the middle of npy_record() must not */
+		signal(SIGHUP, stopAnalysis);
+		signal(SIGINT, stopAnalysis);
+		signal(SIGQUIT, stopAnalysis);
+		signal(SIGTERM, stopAnalysis);
+	}
 	signal(SIGALRM, togglePaused);
 	signal(60, zoomOut);
-	signal(63, quit);
+	if(checkpointing || exportingNpy){
+		signal(63, stopAnalysis);
+	}
+	else{
+		signal(63, quit);
+	}
 	signal(62, toggleHits);
 	signal(61, toggleKeyCommands);
 	signal(59, toggleLogPlot);
+	signal(58, zoomIn);
+	signal(57, zoomOutStep);
+	signal(56, panLeft);
+	signal(55, panRight);
 
 	if(plotting){                           /* Initialize gnuplot window handle and set-up graph   */
         	h1 = gnuplot_init();
@@ -335,6 +1194,10 @@ int main (int argc, const char * argv[]) {
 		sprintf(toggleHitsCommand, "bind c \"!kill -62 %i\"", processID);
 		sprintf(toggleKeyCommandsCommand, "bind k \"!kill -61 %i\"", processID);
 		sprintf(toggleLogPlotCommand, "bind l \"!kill -59 %i\"", processID);
+		sprintf(zoomInCommand, "bind \"+\" \"!kill -58 %i\"", processID);
+		sprintf(zoomOutStepCommand, "bind \"-\" \"!kill -57 %i\"", processID);
+		sprintf(panLeftCommand, "bind Left \"!kill -56 %i\"", processID);
+		sprintf(panRightCommand, "bind Right \"!kill -55 %i\"", processID);
 
 		gnuplot_cmd(h1, "set mouse");
 		gnuplot_cmd(h1, pauseCommand);
@@ -343,6 +1206,10 @@ int main (int argc, const char * argv[]) {
 		gnuplot_cmd(h1, toggleHitsCommand);
 		gnuplot_cmd(h1, toggleLogPlotCommand);
 		gnuplot_cmd(h1, toggleKeyCommandsCommand);
+		gnuplot_cmd(h1, zoomInCommand);
+		gnuplot_cmd(h1, zoomOutStepCommand);
+		gnuplot_cmd(h1, panLeftCommand);
+		gnuplot_cmd(h1, panRightCommand);
 		gnuplot_cmd(h1, "unset key");
 		gnuplot_cmd(h1, "set grid");
 		gnuplot_cmd(h1, "set pointsize 2");
@@ -370,316 +1237,213 @@ int main (int argc, const char * argv[]) {
 			gnuplot_set_xlabel(h1, "Frequency (MHz)");
 		}
 
-		//initialize plotting arrays
-		memset(&binsLeft, 0, 2049);
-		memset(&avgpowerLeft, 0, 2049);
-		memset(&binsRight, 0, 2049);
-		memset(&avgpowerRight, 0, 2049);
-		memset(&hitbins, 0, MAXHITS);
-		memset(&hitpowers, 0, MAXHITS);
-
-		totalHits = 0;
-		pktcountLeft = 0;
-		pktcountRight = 0;		
+		/* one spectrum is built while the one before stays on screen */
+		building = &plotPyramids[0];
+		if(!pyr_init(&plotPyramids[0]) || !pyr_init(&plotPyramids[1])){
+			printf("Out of memory.\n");
+			quit();
+		}
 		lastbin = -1;
                 
 		gnuplot_resetplot(h1);
 		gnuplot_setstyle(h1, "steps ls 6");
-		gnuplot_plot_xy(h1, binsLeft, avgpowerLeft, 1, "Waiting for data...");
+		gnuplot_plot_xy(h1, plotX, plotY, 1, "Waiting for data...");
 		setTitle();
 	}
 
 
 	/* parse the files */
-	for(i=1; i<=numberOfFiles; i++){
-		printf("\nParsing file %i------------------------------------\n", i);
-		sprintf(filename, "%s%i.dat", fileheader, i);
-		fp = fopen(filename, "rb");
-		
-		if(writingToTextFile){
-			sprintf(filenameToWrite, "%s%i.txt", fileheader, i);
-			fpToWrite = fopen(filenameToWrite, "w");
-			if(fpToWrite == NULL){
-				printf("Error: could not open %s to write to.\n", filenameToWrite);
+	if(parallel){
+		analyze_parallel(fileheader, numberOfFiles, threads, &numberOfErrorCodesReported);
+	}
+	else{
+		for(i=position.file; following || (i<=numberOfFiles); i++){
+			if(following && !follow_wait_file(&fileFollower, i)){
+				break;
 			}
-		}
-		
-		if(fp != NULL){
-
-			/* obtain first packet information */
-			fread(&bytesOfData, sizeof(int), 1, fp);
-			fread(&sec, sizeof(int), 1, fp);
-			fread(&usec, sizeof(int), 1, fp);
-
-			while(!feof(fp)){
-			if(!paused){
-				if(writingToTextFile && (fpToWrite != NULL)){
-					fprintf(fpToWrite, "%i\n", bytesOfData);
-					fprintf(fpToWrite, "%i.%06i\n", sec, usec);
+			printf("\nParsing file %i------------------------------------\n", i);
+			if(!series_name(filename, sizeof(filename), fileheader, i, "dat")){
+				quit();
+			}
+			
+			if(writingToTextFile){
+				if(!series_name(filenameToWrite, sizeof(filenameToWrite), fileheader, i, txt_extension(textLayout))){
+					quit();
 				}
-				
-				/* read the PFBbinNumber */
-				if(errorChecking){
-					lastPFBbinNumber = PFBbinNumber;
+				/* a checkpoint at the start of a file has nothing of it to keep */
+				if(resuming && ((position.offset > 0) || (position.textBytes > 0))){
+					textOpen = txt_resume(&textFile, filenameToWrite, textLayout, position.textBytes);
+					if(!textOpen){
+						printf("Error: could not carry on with %s (%s); remove %s to start over.\n", filenameToWrite, strerror(errno), checkpointPath);
+						quit();
+					}
 				}
-				fread(&PFBbinNumber, sizeof(int), 1, fp);
-				if(BYTE_SWAPPING){
-					PFBbinNumber = endianSwap32(PFBbinNumber);
+				else{
+					textOpen = txt_open(&textFile, filenameToWrite, textLayout);
+					if(!textOpen){
+						printf("Error: could not open %s to write to.\n", filenameToWrite);
+					}
 				}
-				if(writingToTextFile && (fpToWrite !=NULL)){
-					fprintf(fpToWrite, "%i\n", PFBbinNumber);
+			}
+			
+			if(dat_open(&datFile, filename, BYTE_SWAPPING)){
+				if(resuming && !dat_resume(&datFile, position.offset)){
+					printf("Error: %s is shorter than when %s was saved; remove it to start over.\n", filename, checkpointPath);
+					quit();
 				}
-				if(errorChecking){
-					if(firstPFBbinNumberFlag){
-						lastPFBbinNumber = (PFBbinNumber-1)%4096;
-						lastSec = sec;
-						lastUSec = sec;
-						firstPFBbinNumberFlag = 0;
-					}
 
-					if((PFBbinNumber > 4095) || (PFBbinNumber < 0)){
-						printf("PFBbinNumber %i out of range (0 to 4095) at time %i.%i\n", PFBbinNumber, sec, usec);
+				/* every record is a view into the mapped file, nothing is copied */
+				while(1){
+					if(stopRequested){
+						break;
 					}
-					else if(PFBbinNumber <= lastPFBbinNumber){
-						if((lastPFBbinNumber <= 4095) && (lastPFBbinNumber >= 0)){
-						if((PFBbinNumber != 0) || (lastPFBbinNumber != 4095)){
-							printf("Missing PFB bins between time %i.%i and %i.%i:\n", lastSec, lastUSec, sec, usec);
-							for(j=lastPFBbinNumber+1; j<4096; j++){
-								printf("     missing PFBbinNumber %i\n", j);
-								numberOfMissingPFBbins++;
-							}
-							for(j=0; j<PFBbinNumber; j++){
-								printf("     missing PFBbinNumber %i\n", j);
-								numberOfMissingPFBbins++;
-							}
-						}
+					if(checkpointing && (++recordsSinceCheck >= CHECKPOINT_RECORDS)){
+						recordsSinceCheck = 0;
+						if(time(NULL) >= nextCheckpoint){
+							position.file = i;
+							position.offset = datFile.offset;
+							position.errorCodes = numberOfErrorCodesReported;
+							position.textBytes = 0;
+							save_checkpoint(&position, textOpen ? &textFile : NULL);
+							nextCheckpoint = time(NULL) + checkpointInterval;
 						}
 					}
-					else if((PFBbinNumber - lastPFBbinNumber) != 1){
-						printf("Missing PFB bins between time %i.%i and %i.%i:\n", lastSec, lastUSec, sec, usec);
-						for(j=lastPFBbinNumber+1; j<PFBbinNumber; j++){
-							printf("     missing PFBbinNumber %i\n", j);
-							numberOfMissingPFBbins++;
+					if(!dat_next(&datFile, &record)){
+						/* following, wait for the rest of a file that is still being written */
+						if(following && follow_wait(&fileFollower, &datFile, i)){
+							continue;
 						}
+						break;
 					}
-				}
-
-				if(plotting){
-					currentbin = PFBbinNumber;
-					currentPFBbin = currentbin;
-					currentPFBbin = (currentPFBbin + 2048) % 4096;
-
-					if((signed int) currentbin <= lastbin){
-						totalBins = pktcountLeft+pktcountRight-2;
-						gnuplot_resetplot(h1);
-						if(plotHits){
-							printf("Plot: lastbin: %i, currentbin: %i, totalBins: %i, totalHits: %i.\n", lastbin, currentbin, totalBins, totalHits);
-							gnuplot_setstyle(h1, "points ls 5");
-							gnuplot_plot_xy(h1, hitbins, hitpowers, totalHits, "Hits");
-
-						}
-						else{
-							printf("Plot: currentbin: %i, totalBins: %i, totalHits: %i. (Hits are off).\n", currentbin, totalBins, totalHits);
-						}
-						gnuplot_setstyle(h1, "steps ls 6");
-						binsConnection[0] = binsLeft[pktcountLeft-1];
-						binsConnection[1] = binsRight[0];						
-						avgpowerConnection[0] = avgpowerLeft[pktcountLeft-1];
-						avgpowerConnection[1] = avgpowerRight[0];
-
-						gnuplot_plot_xy(h1, binsLeft, avgpowerLeft, pktcountLeft, "");
-						gnuplot_plot_xy(h1, binsRight, avgpowerRight, pktcountRight, "");
-						gnuplot_plot_xy(h1, binsConnection, avgpowerConnection, 2, "");
-
-						usleep(500000);
-
-						lastbin = currentbin;
-						totalHits = 0;
-						pktcountLeft = 0;
-						pktcountRight = 0;					
-						memset(&avgpowerLeft, 0, 2049);
-						memset(&binsLeft, 0, 2049);
-						memset(&avgpowerRight, 0, 2049);
-						memset(&binsRight, 0, 2049);
-						memset(&hitbins, 0, MAXHITS);
-						memset(&hitpowers, 0, MAXHITS);
-					}					
-					
-				}
-
-
-
-				
-				/* read the mean power */
-				fread(&meanPower, sizeof(int), 1, fp);
-				if(BYTE_SWAPPING){
-					meanPower = endianSwap32(meanPower);
-				}
-				if(writingToTextFile && (fpToWrite !=NULL)){
-					fprintf(fpToWrite, "%i\n", meanPower);
-				}
-				if(plotting){
-					lastbin = currentbin;
-					curavgpower = meanPower;
-					// ADJUST FOR THRESHOLDER BINARY POINT, MOVING 32_22 TO 32_31
-					//curavgpower <<= 9;
-
-					if(currentPFBbin < 2048){
-						/*avgpowerLeft[pktcountLeft] = ((double) curavgpower) / 4194304.0;*/
-						avgpowerLeft[pktcountLeft] = ((double) curavgpower) / 2147483648.0;
-
-						if(domainBin){
-							binsLeft[pktcountLeft] = ((double) currentPFBbin)-0.5;
-						}
-						else if(domainAdjustedFrequency){
-							binsLeft[pktcountLeft] = (((double) currentPFBbin)-0.5) / 20.48 - 100.0 + (double)frequencyCenter;
-						}
-						else{
-							printf("Internal error: No domain preference.\n");
-							binsLeft[pktcountLeft] = (((double) currentPFBbin) - 0.5) * 32768.0;
-						}
-						pktcountLeft++;
-						if(currentPFBbin == 2047 && 0){
-							/*avgpowerLeft[pktcountLeft] = ((double) curavgpower) / 4194304.0;*/
-							avgpowerLeft[pktcountLeft] = ((double) curavgpower) / 2147483648.0;
-
-							if(domainBin){
-								binsLeft[pktcountLeft] = ((double) currentPFBbin)+0.5;
-							}
-							else if(domainAdjustedFrequency){
-								binsLeft[pktcountLeft] = (((double) currentPFBbin)+0.5) / 20.48 - 100.0 + (double)frequencyCenter;
-							}
-							else{
-								printf("Internal error: No domain preference.\n");
-								binsLeft[pktcountLeft] = (((double) currentPFBbin) + 0.5) * 32768.0;
-							}
-							pktcountLeft++;
+					while(paused && !stopRequested){
+						if(viewChanged && (shown != NULL)){
+							drawSpectrum(shown);
 						}
+						usleep(100000);
 					}
-					else{
-						/*avgpowerRight[pktcountRight] = ((double) curavgpower) / 4194304.0;*/
-						avgpowerRight[pktcountRight] = ((double) curavgpower) / 2147483648.0;
-
-						if(domainBin){
-							binsRight[pktcountRight] = ((double) currentPFBbin)-0.5;
-						}
-						else if(domainAdjustedFrequency){
-							binsRight[pktcountRight] = (((double) currentPFBbin)-0.5) / 20.48 - 100.0 + (double)frequencyCenter;
-						}
-						else{
-							printf("Internal error: No domain preference.\n");
-							binsRight[pktcountRight] = (((double) currentPFBbin) - 0.5) * 32768.0;
-						}
-						pktcountRight++;
-						if(currentPFBbin == 4095 && 0){
-							/*avgpowerRight[pktcountRight] = ((double) curavgpower) / 4194304.0;*/
-							avgpowerRight[pktcountRight] = ((double) curavgpower) / 2147483648.0;
-							if(domainBin){
-								binsRight[pktcountRight] = ((double) currentPFBbin)+0.5;
-							}
-							else if(domainAdjustedFrequency){
-								binsRight[pktcountRight] = (((double) currentPFBbin)+0.5) / 20.48 - 100.0 + (double)frequencyCenter;
-							}
-							else{
-								printf("Internal error: No domain preference.\n");
-								binsRight[pktcountRight] = (((double) currentPFBbin) + 0.5) * 32768.0;
-							}
-							pktcountRight++;
-						}
+					if(viewChanged && (shown != NULL)){
+						drawSpectrum(shown);
 					}
-				}
-
-
-
-
-				/* read the error code */
-				fread(&errorCode, sizeof(int), 1, fp);
-				if(BYTE_SWAPPING){
-					errorCode = endianSwap32(errorCode);
-				}
-				if(writingToTextFile && (fpToWrite !=NULL)){
-					fprintf(fpToWrite, "%i\n", errorCode);
-				}
-				if(errorChecking){
-					if((errorCode & FFT_OVERFLOW_MASK) > 0){
-						printf("FFT overflow reported in PFBbinNumber %i\n", PFBbinNumber);
-						numberOfErrorCodesReported++;
+					if(textOpen){
+						txt_record(&textFile, &record);
 					}
-					if((errorCode & PFB_OVERFLOW_MASK) > 0){
-						printf("PFB overflow reported in PFBbinNumber %i\n", PFBbinNumber);
-						numberOfErrorCodesReported++;
+					if(exportingNpy){
+						npy_record(&npyExport, &record);
 					}
-					if((errorCode & CT_ERROR_MASK) > 0){
-						printf("Corner Turner error reported in PFBbinNumber %i\n", PFBbinNumber);
-						numberOfErrorCodesReported++;
+					if(gatheringStats){
+						rs_record(&channelStats, &record);
 					}
-					if((errorCode & FIFO_OVERRUN_MASK) > 0){
-						printf("FIFO overrun reported in PFBbinNumber %i\n", PFBbinNumber);
-						numberOfErrorCodesReported++;
+					if(errorChecking){
+						check_sequence(stdout, &checker, record.pfbBin, record.errorCode, record.sec, record.usec);
 					}
-				}
-				
-				/* read the rest of the data */
-				if(writingToTextFile || plotting){
-					for(j=0; j<(bytesOfData-12)/8; j++){
-						fread(&tempbin, sizeof(int), 1, fp);
-						fread(&temppower, sizeof(int), 1, fp);						
-						if(BYTE_SWAPPING){
-							tempbin = endianSwap32(tempbin);
-							temppower = endianSwap32(temppower);							
-						}
-						if(writingToTextFile && (fpToWrite !=NULL)){
-							fprintf(fpToWrite, "%i\n", tempbin);
-							fprintf(fpToWrite, "%i\n", temppower);						
+
+					if(plotting){
+						currentbin = record.pfbBin;
+						if((signed int) currentbin <= lastbin){
+							drawSpectrum(building);
+							shown = building;
+							building = (building == &plotPyramids[0]) ? &plotPyramids[1] : &plotPyramids[0];
+							pyr_begin(building);
+							usleep(500000);
 						}
-						if(plotting){
-
-							if(domainBin){
-								hitbins[totalHits]  = ((double) ((((tempbin) + 16384) % 32768) + 32768*currentPFBbin)) / 32768.0 - 0.5;
-							}
-							else if(domainAdjustedFrequency){
-								hitbins[totalHits]  = ((double) ((((tempbin) + 16384) % 32768) + 32768*currentPFBbin)) / 671088.64 - 100.0 - 0.0244140625 + (double)frequencyCenter;
-							}
-							else{
-								printf("Internal error: No domain preference.\n");
-								hitbins[totalHits]  = (double) ((((tempbin) + 16384) % 32768) + 32768*currentPFBbin);
-							}
-							hitpowers[totalHits] = ((double) temppower) / 2147483648.0;
-							totalHits += 1;
+						lastbin = currentbin;
+						if(!pyr_packet(building, &record)){
+							printf("Out of memory for %llu hits.\n", building->totalHits + record.nhits);
+							quit();
 						}
 					}
-				}
-				else{
-					fread(dummy, sizeof(dummy[0]), bytesOfData-12, fp);
-				}
 
-				
-				/* Separate packets with a new line ??   ------------------------ DECISION TO BE MADE ----------------- */
-				if(writingToTextFile && (fpToWrite !=NULL)){
-					fprintf(fpToWrite, "\n");
+					if(errorChecking){
+						numberOfErrorCodesReported += check_error_code(stdout, record.pfbBin, record.errorCode);
+					}
 				}
-				/* obtain next packet information */
-				if(errorChecking){
-					lastSec = sec;
-					lastUSec = usec;
+				if(stopRequested){
+					/* the record at offset has not been looked at, maybe not even written yet */
+					position.file = i;
+					position.offset = datFile.offset;
+					interrupted = 1;
 				}
-				fread(&bytesOfData, sizeof(int), 1, fp);
-				fread(&sec, sizeof(int), 1, fp);
-				fread(&usec, sizeof(int), 1, fp);
+				else if((datFile.truncated && !fileFollower.stop) || datFile.corrupt){
+					printf("Warning: %s %s at byte %lu, the rest of it is skipped.\n", filename,
+						datFile.truncated ? "ends inside a record" : "has a damaged record", (unsigned long)datFile.offset);
+				}
+				dat_close(&datFile);
+			}
+			resuming = 0;
+			if(textOpen && !txt_close(&textFile)){
+				printf("Error: could not write all of %s (%s).\n", filenameToWrite, strerror(textFile.error));
+			}
+			if(stopRequested && !interrupted){
+				position.file = i+1;
+				position.offset = 0;
+				interrupted = 1;
 			}
+			if(interrupted){
+				position.textBytes = (textOpen && (position.file == i)) ? textFile.bytes : 0;
 			}
-			fclose(fp);
-			if(writingToTextFile && (fpToWrite !=NULL)){
-				fclose(fpToWrite);
+			textOpen = 0;
+			if(fileFollower.stop){
+				break;
+			}
+		}
+	}
+	if(following){
+		printf("\nStopped following %s at file %i.\n", fileheader, i);
+		follow_stop(&fileFollower);
+	}
+	if(checkpointing){
+		if(stopRequested && !interrupted){
+			/* stopped while waiting for file i to appear */
+			position.file = i;
+			position.offset = 0;
+			position.textBytes = 0;
+			interrupted = 1;
+		}
+		if(interrupted){
+			position.errorCodes = numberOfErrorCodesReported;
+			save_checkpoint(&position, NULL);
+			printf("\nInterrupted at file %i, byte %llu; run again with the same options to carry on (%s).\n",
+				position.file, (unsigned long long)position.offset, checkpointPath);
+		}
+		else{
+			unlink(checkpointPath);
+		}
+		free(savedNpy);
+	}
+	else if(stopRequested && !following){
+		printf("\nInterrupted at file %i.\n", i);
+	}
+
+	if(exportingNpy){
+		exportingNpy = 0;
+		if(npy_close(&npyExport)){
+			printf("\nWrote %llu hits and %llu spectra to %s_*.npy\n", npyExport.hits, npyExport.spectra, npyPrefix);
+		}
+		else{
+			failedPath = npy_failure(&npyExport, &failure);
+			printf("\nError: could not write all of %s (%s).\n", failedPath, strerror(failure));
+		}
+	}
+
+	if(gatheringStats){
+		snprintf(statsPath, sizeof(statsPath), "%s.rst", statsPrefix);
+		if(!rs_write(&channelStats, statsPath)){
+			printf("\nError: could not write %s (%s).\n", statsPath, strerror(errno));
+		}
+		else{
+			snprintf(statsPath, sizeof(statsPath), "%s_stats.txt", statsPrefix);
+			if(!rs_summary(&channelStats, statsPath)){
+				printf("\nError: could not write %s (%s).\n", statsPath, strerror(errno));
+			}
+			else{
+				printf("\nWrote statistics of %llu packets and %llu hits to %s.rst and %s\n",
+					(unsigned long long)channelStats.packets, (unsigned long long)channelStats.hits, statsPrefix, statsPath);
 			}
-//		}
 		}
 	}
 	
 	if(errorChecking){
-		printf("\nFinal report:\n");
-		printf("Missing %i PFB bins\n", numberOfMissingPFBbins);
-		printf("%i error codes reported\n", numberOfErrorCodesReported);
+		check_report(&checker, numberOfErrorCodesReported);
 	}
 		
     return 0;
@@ -699,12 +1463,32 @@ int endianSwap32(int x)
 }
 
 
+void stopFollowing()
+{
+	fileFollower.stop = 1;
+}
+
+
+void stopAnalysis()
+{
+	stopRequested = 1;
+	fileFollower.stop = 1;
+}
+
+
 void quit(){
         
-        /* for malloc, maybe
-        free(hitbins);
-        free(hitpowers);
-        */
+	if(exportingNpy){
+		/* what was exported so far gets its final headers and stays loadable */
+		exportingNpy = 0;
+		npy_close(&npyExport);
+	}
+	if(building != NULL){
+		building = NULL;
+		shown = NULL;
+		pyr_free(&plotPyramids[0]);
+		pyr_free(&plotPyramids[1]);
+	}
 
 	exit(0);	
 }
@@ -730,7 +1514,7 @@ void setTitle()
 		strcat(title, " - PAUSED, HITS OFF");
 	}
 	if(keyCommands){
-		strcat(title, "\\n(Press k to hide key commands)\\nZ: zoom out  A: auto-scale  P: previous zoom  N: next zoom\\nK: toggle key commands  X: toggle pause  C: toggle hits  L: toggle log plot  9: quit\"");
+		strcat(title, "\\n(Press k to hide key commands)\\nZ: whole band  +/-: zoom in/out  Left/Right: move along  A: auto-scale  P: previous zoom  N: next zoom\\nK: toggle key commands  X: toggle pause  C: toggle hits  L: toggle log plot  9: quit\"");
 	}
 	else{
 		strcat(title, "\\n(Press k to show key commands)\"");
@@ -823,5 +1607,123 @@ void zoomOut()
 		gnuplot_cmd(h1, "set xrange [0:4096]");
 	}
 	gnuplot_cmd(h1, "set yrange [0.0:0.001]");
+	viewLevel = 0;
+	viewCenter = PYR_FINE / 2;
+	viewChanged = 1;
 	gnuplot_cmd(h1, "replot");
 }
+
+/* The key handlers only move the view; the plot follows at the next record or spectrum */
+void zoomIn()
+{
+	if(viewLevel < VIEW_DEEPEST){
+		viewLevel++;
+		viewChanged = 1;
+	}
+}
+
+void zoomOutStep()
+{
+	if(viewLevel > 0){
+		viewLevel--;
+		centerView(viewCenter);
+		viewChanged = 1;
+	}
+}
+
+void panLeft()
+{
+	centerView(viewCenter - (PYR_FINE >> viewLevel) / 4);
+	viewChanged = 1;
+}
+
+void panRight()
+{
+	centerView(viewCenter + (PYR_FINE >> viewLevel) / 4);
+	viewChanged = 1;
+}
+
+/* Keeps the view inside the band */
+void centerView(int center)
+{
+	int half = (PYR_FINE >> viewLevel) / 2;
+
+	if(center < half){
+		center = half;
+	}
+	if(center > PYR_FINE - half){
+		center = PYR_FINE - half;
+	}
+	viewCenter = center;
+}
+
+/* Where fine bin f is on the x axis */
+double plotPosition(double fine)
+{
+	if(domainBin){
+		return fine / 32768.0 - 0.5;
+	}
+	else if(domainAdjustedFrequency){
+		return fine / 671088.64 - 100.0 - 0.0244140625 + (double)frequencyCenter;
+	}
+	return fine;
+}
+
+/* Plots what of spectrum p is in view: the mean power of each column as steps and the strongest hit in it */
+void drawSpectrum(const pyramid *p)
+{
+	char rangeCommand[100];
+	double from, to, width;
+	int n, i, level, powerColumns;
+
+	level = viewLevel;
+	from = (double)viewCenter - (double)(PYR_FINE >> level) / 2;
+	to = from + (double)(PYR_FINE >> level);
+	if(viewChanged){
+		viewChanged = 0;
+		if(level > 0){
+			sprintf(rangeCommand, "set xrange [%.10g:%.10g]", plotPosition(from), plotPosition(to));
+			gnuplot_cmd(h1, rangeCommand);
+		}
+		else if(domainAdjustedFrequency && !domainBin){
+			gnuplot_cmd(h1, frequencyAdjustmentCmd);
+		}
+		else{
+			gnuplot_cmd(h1, "set xrange [0:4096]");
+		}
+	}
+
+	gnuplot_resetplot(h1);
+	if(plotHits){
+		n = pyr_render(p, PYR_HITS, from, to, PYR_SCREEN, columnStart, columns);
+		width = (to - from) / PYR_SCREEN;
+		for(i=0; i<n; i++){
+			plotX[i] = plotPosition(columnStart[i] + width / 2);
+			plotY[i] = columns[i].max;
+		}
+		printf("Plot: %llu packets, %llu hits, %i columns with hits.\n", p->packets, p->totalHits, n);
+		if(n > 0){
+			gnuplot_setstyle(h1, "points ls 5");
+			gnuplot_plot_xy(h1, plotX, plotY, n, "Hits");
+		}
+	}
+	else{
+		printf("Plot: %llu packets, %llu hits. (Hits are off).\n", p->packets, p->totalHits);
+	}
+
+	/* a column a coarse bin, down to one when zoomed into a coarse bin */
+	powerColumns = (level < PYR_COARSE_LEVEL) ? (PYR_COARSE >> level) : 1;
+	n = pyr_render(p, PYR_POWER, from, to, powerColumns, columnStart, columns);
+	width = (to - from) / powerColumns;
+	for(i=0; i<n; i++){
+		plotX[i] = plotPosition(columnStart[i]);
+		plotY[i] = columns[i].sum / columns[i].count;
+	}
+	if(n > 0){
+		/* the last step needs somewhere to end */
+		plotX[n] = plotPosition(columnStart[n-1] + width);
+		plotY[n] = plotY[n-1];
+		gnuplot_setstyle(h1, "steps ls 6");
+		gnuplot_plot_xy(h1, plotX, plotY, n + 1, "");
+	}
+}
@@ -0,0 +1,253 @@
+/*
+Spectrum Assembly v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+See assemble.h.  Bins are placed by their distance from the newest bin seen,
+exactly as seqtrack.c classifies them.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "assemble.h"
+
+#define BIT_WORD(b) ((b) >> 6)
+#define BIT_MASK(b) (((uint64_t)1) << ((b) & 63))
+
+static uint32_t swap32(uint32_t x)
+{
+	return ((x & 0x000000ff) << 24) | ((x & 0x0000ff00) << 8) |
+	       ((x & 0x00ff0000) >> 8)  | ((x & 0xff000000) >> 24);
+}
+
+static void reset(asmspectrum *s)
+{
+	memset(s->present, 0, sizeof(s->present));
+	s->nbins = 0;
+	s->nhits = 0;
+	s->open = 0;
+}
+
+/* Hands the spectrum downstream and frees its slot */
+static void deliver(assembler *a, asmspectrum *s)
+{
+	if(!s->open){
+		return;
+	}
+	a->delivered++;
+	if(s->nbins < ASM_NUM_BINS){
+		a->incomplete++;
+	}
+	a->deliver(s, a->arg);
+	reset(s);
+}
+
+static void open_spectrum(assembler *a, asmspectrum *s)
+{
+	reset(s);
+	s->number = a->opened++;
+	s->open = 1;
+}
+
+/* Returns 0 if the spectrum cannot hold more hits */
+static int place(asmspectrum *s, unsigned int bin, const char *msg, int numBytes, int swap, int sec, int usec)
+{
+	uint32_t word, *grown;
+	int hits, index;
+
+	hits = (numBytes - 12) / 8;
+	if(s->nhits + hits > s->hitCapacity){
+		index = s->hitCapacity * 2;
+		while(index < s->nhits + hits){
+			index *= 2;
+		}
+		grown = realloc(s->hitBin, index * sizeof(uint32_t));
+		if(grown == NULL){
+			return 0;
+		}
+		s->hitBin = grown;
+		grown = realloc(s->hitPower, index * sizeof(uint32_t));
+		if(grown == NULL){
+			return 0;
+		}
+		s->hitPower = grown;
+		s->hitCapacity = index;
+	}
+
+	memcpy(&word, msg + 4, 4);
+	s->meanPower[bin] = swap ? swap32(word) : word;
+	memcpy(&word, msg + 8, 4);
+	s->errorCode[bin] = swap ? swap32(word) : word;
+	s->sec[bin] = sec;
+	s->usec[bin] = usec;
+	s->hitStart[bin] = s->nhits;
+	s->hitCount[bin] = hits;
+	for(index = 0; index < hits; index++){
+		memcpy(&word, msg + 12 + 8*index, 4);
+		s->hitBin[s->nhits] = swap ? swap32(word) : word;
+		memcpy(&word, msg + 16 + 8*index, 4);
+		s->hitPower[s->nhits] = swap ? swap32(word) : word;
+		s->nhits++;
+	}
+
+	if(s->nbins == 0){
+		s->firstPacket.tv_sec = sec;
+		s->firstPacket.tv_usec = usec;
+	}
+	s->present[BIT_WORD(bin)] |= BIT_MASK(bin);
+	s->nbins++;
+	s->lastPacket.tv_sec = sec;
+	s->lastPacket.tv_usec = usec;
+	return 1;
+}
+
+/* Returns 0 if the hit arrays cannot be allocated */
+int asm_init(assembler *a, int timeoutMs, asmdeliver deliver, void *arg)
+{
+	int i;
+
+	memset(a, 0, sizeof(assembler));
+	for(i=0; i<2; i++){
+		a->slots[i].hitBin = malloc(ASM_INITIAL_HITS * sizeof(uint32_t));
+		a->slots[i].hitPower = malloc(ASM_INITIAL_HITS * sizeof(uint32_t));
+		if((a->slots[i].hitBin == NULL) || (a->slots[i].hitPower == NULL)){
+			asm_destroy(a);
+			return 0;
+		}
+		a->slots[i].hitCapacity = ASM_INITIAL_HITS;
+	}
+	a->current = &a->slots[0];
+	a->previous = NULL;
+	a->lastbin = -1;
+	a->timeoutMs = (timeoutMs > 0) ? timeoutMs : ASM_DEFAULT_TIMEOUT;
+	a->deliver = deliver;
+	a->arg = arg;
+	return 1;
+}
+
+/*
+Places one packet, sec and usec being its arrival time.  Returns 1 if it was
+placed, 0 if it was dropped (duplicate, too late, too short or out of range)
+and -1 if memory ran out.
+*/
+int asm_packet(assembler *a, const char *msg, int numBytes, int swap, int sec, int usec)
+{
+	asmspectrum *target, *spare;
+	uint32_t word;
+	int bin, distance;
+
+	if(numBytes < 12){
+		a->dropped++;
+		return 0;
+	}
+	memcpy(&word, msg, 4);
+	if(swap){
+		word = swap32(word);
+	}
+	if(word >= ASM_NUM_BINS){
+		a->dropped++;
+		return 0;
+	}
+	bin = (word + 2048) % ASM_NUM_BINS;
+
+	if(!a->started){
+		open_spectrum(a, a->current);
+		a->lastbin = bin;
+		a->started = 1;
+		target = a->current;
+	}
+	else{
+		distance = (bin - a->lastbin + ASM_NUM_BINS) % ASM_NUM_BINS;
+
+		if(distance > ASM_NUM_BINS - ASM_REORDER_WINDOW){
+			/* behind the newest bin; across the wrap it belongs to the previous spectrum */
+			target = (bin > a->lastbin) ? a->previous : a->current;
+		}
+		else if(distance == 0){
+			target = NULL;
+		}
+		else{
+			if(bin <= a->lastbin){
+				/* the sequence wrapped, the spectrum before last is out of reach */
+				spare = &a->slots[0];
+				if(spare == a->current){
+					spare = &a->slots[1];
+				}
+				deliver(a, spare);
+				a->previous = a->current->open ? a->current : NULL;
+				a->current = spare;
+				open_spectrum(a, a->current);
+			}
+			a->lastbin = bin;
+			target = a->current;
+		}
+	}
+
+	if((target == NULL) || !target->open || (target->present[BIT_WORD(bin)] & BIT_MASK(bin))){
+		a->dropped++;
+		return 0;
+	}
+	if(!place(target, bin, msg, numBytes, swap, sec, usec)){
+		return -1;
+	}
+
+	if(target->nbins == ASM_NUM_BINS){
+		deliver(a, target);
+	}
+	/* nothing can reach the previous spectrum once we are past the window */
+	if((a->previous != NULL) && (a->lastbin >= ASM_REORDER_WINDOW)){
+		deliver(a, a->previous);
+	}
+	if((a->previous != NULL) && !a->previous->open){
+		a->previous = NULL;
+	}
+	return 1;
+}
+
+/* Delivers the spectra nothing has arrived for in the timeout */
+void asm_poll(assembler *a, const struct timeval *now)
+{
+	long long idle;
+
+	if((a->previous != NULL) && a->previous->open){
+		idle = (now->tv_sec - a->previous->lastPacket.tv_sec) * 1000LL + (now->tv_usec - a->previous->lastPacket.tv_usec) / 1000;
+		if(idle >= a->timeoutMs){
+			deliver(a, a->previous);
+			a->previous = NULL;
+		}
+	}
+	if(a->started && a->current->open){
+		idle = (now->tv_sec - a->current->lastPacket.tv_sec) * 1000LL + (now->tv_usec - a->current->lastPacket.tv_usec) / 1000;
+		if(idle >= a->timeoutMs){
+			/* the stream stopped, whatever comes next starts afresh */
+			deliver(a, a->current);
+			a->started = 0;
+		}
+	}
+}
+
+/* Delivers whatever is still open, oldest first */
+void asm_flush(assembler *a)
+{
+	if(a->previous != NULL){
+		deliver(a, a->previous);
+		a->previous = NULL;
+	}
+	if(a->started){
+		deliver(a, a->current);
+		a->started = 0;
+	}
+}
+
+void asm_destroy(assembler *a)
+{
+	int i;
+
+	for(i=0; i<2; i++){
+		free(a->slots[i].hitBin);
+		free(a->slots[i].hitPower);
+		a->slots[i].hitBin = NULL;
+		a->slots[i].hitPower = NULL;
+	}
+}
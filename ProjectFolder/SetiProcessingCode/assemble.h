@@ -0,0 +1,75 @@
+/*
+Spectrum Assembly v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+Collects the PFB bin packets of one spectrum into a slot indexed by bin number
+and hands the spectrum downstream as one unit.  Packets are placed the same way
+seqtrack.c counts them: a bin up to ASM_REORDER_WINDOW behind the newest one is
+filled into the spectrum it belongs to (the previous one if it is across the
+wrap), an exact repeat is dropped, and only a real wrap of the sequence opens a
+new spectrum, so one stray packet can no longer split or merge spectra.
+
+A spectrum is delivered as soon as all 4096 bins are in, once the sequence is
+ASM_REORDER_WINDOW bins into the next spectrum, or when nothing has arrived for
+it in the timeout (checked by asm_poll()).  Bins are in the rotated order
+receive uses (the +2048 rotation); hits are kept as the BEE2 sent them, in
+host byte order, bin by bin.
+*/
+
+#ifndef ASSEMBLE_H
+#define ASSEMBLE_H
+
+#include <stdint.h>
+#include <sys/time.h>
+
+#define ASM_NUM_BINS        4096
+#define ASM_BITMAP_WORDS    (ASM_NUM_BINS/64)
+#define ASM_REORDER_WINDOW  64
+#define ASM_INITIAL_HITS    65536
+#define ASM_DEFAULT_TIMEOUT 2000      /* milliseconds, three spectra */
+
+typedef struct asmspectrum_s {
+	uint64_t number;                  /* spectra opened since the start */
+	int open;
+	int nbins;                        /* bins present */
+	uint64_t present[ASM_BITMAP_WORDS];
+	uint32_t meanPower[ASM_NUM_BINS];
+	uint32_t errorCode[ASM_NUM_BINS];
+	int32_t sec[ASM_NUM_BINS];        /* arrival of each bin */
+	int32_t usec[ASM_NUM_BINS];
+	uint32_t hitStart[ASM_NUM_BINS];  /* first hit of each bin in hitBin/hitPower */
+	uint32_t hitCount[ASM_NUM_BINS];
+	uint32_t *hitBin;                 /* fine bin within the PFB bin, 0 .. 32767 */
+	uint32_t *hitPower;
+	int nhits;
+	int hitCapacity;
+	struct timeval firstPacket;
+	struct timeval lastPacket;
+} asmspectrum;
+
+typedef void (*asmdeliver)(const asmspectrum *spectrum, void *arg);
+
+typedef struct assembler_s {
+	asmspectrum slots[2];
+	asmspectrum *current;
+	asmspectrum *previous;            /* NULL or still open behind the wrap */
+	int started;
+	int lastbin;
+	int timeoutMs;
+	asmdeliver deliver;
+	void *arg;
+	uint64_t opened;
+	uint64_t delivered;
+	uint64_t incomplete;              /* delivered with bins missing */
+	uint64_t dropped;                 /* duplicates and packets too late for their spectrum */
+} assembler;
+
+int asm_init(assembler *a, int timeoutMs, asmdeliver deliver, void *arg);
+int asm_packet(assembler *a, const char *msg, int numBytes, int swap, int sec, int usec);
+void asm_poll(assembler *a, const struct timeval *now);
+void asm_flush(assembler *a);
+void asm_destroy(assembler *a);
+
+#endif
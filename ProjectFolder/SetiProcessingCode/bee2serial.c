@@ -0,0 +1,187 @@
+/*
+BEE2 Serial Control v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+See bee2serial.h.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <termios.h>
+#include "bee2serial.h"
+
+static long long now_ms()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/* Opens the port raw and non-blocking, the line speed is left as it is; returns 0 on failure */
+int b2_open(bee2serial *b, const char *port, int timeoutMs, char *buffer, int capacity)
+{
+	struct termios options;
+
+	memset(b, 0, sizeof(bee2serial));
+	b->fd = open(port, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if(b->fd < 0){
+		return 0;
+	}
+	if(tcgetattr(b->fd, &options) == 0){
+		cfmakeraw(&options);
+		options.c_cflag |= CLOCAL | CREAD;
+		options.c_cc[VMIN] = 0;
+		options.c_cc[VTIME] = 0;
+		tcsetattr(b->fd, TCSANOW, &options);
+	}
+	b->timeoutMs = (timeoutMs > 0) ? timeoutMs : B2_DEFAULT_TIMEOUT;
+	b->response = buffer;
+	b->capacity = capacity;
+	b->state = B2_IDLE;
+	return 1;
+}
+
+/* Queues <data> (may be empty, to just wait for a prompt) and starts the deadline */
+int b2_start(bee2serial *b, const char *data, int length)
+{
+	if((length < 0) || (length > B2_COMMAND_SIZE)){
+		return 0;
+	}
+	memcpy(b->command, data, length);
+	b->commandLength = length;
+	b->sent = 0;
+	b->length = 0;
+	if(b->capacity > 0){
+		b->response[0] = '\0';
+	}
+	b->deadline = now_ms() + b->timeoutMs;
+	b->state = (length > 0) ? B2_SENDING : B2_READING;
+	return 1;
+}
+
+/* Makes what progress is possible within waitMs (0 never blocks); returns the new state */
+int b2_step(bee2serial *b, int waitMs)
+{
+	struct pollfd waiting;
+	char chunk[256];
+	long long left;
+	int result, i;
+
+	while((b->state == B2_SENDING) || (b->state == B2_READING)){
+		left = b->deadline - now_ms();
+		if(left <= 0){
+			b->state = B2_TIMEOUT;
+			break;
+		}
+		if(left > waitMs){
+			left = waitMs;
+		}
+		waiting.fd = b->fd;
+		waiting.events = (b->state == B2_SENDING) ? POLLOUT : POLLIN;
+		result = poll(&waiting, 1, (int)left);
+		if(result < 0){
+			if(errno == EINTR){
+				continue;
+			}
+			b->state = B2_FAILED;
+			break;
+		}
+		if(result == 0){
+			/* waited as long as the caller allowed, or the deadline is here */
+			if(now_ms() >= b->deadline){
+				b->state = B2_TIMEOUT;
+			}
+			break;
+		}
+		if(waiting.revents & (POLLERR | POLLNVAL)){
+			b->state = B2_FAILED;
+			break;
+		}
+
+		if(b->state == B2_SENDING){
+			result = write(b->fd, b->command + b->sent, b->commandLength - b->sent);
+			if((result < 0) && (errno != EAGAIN) && (errno != EINTR)){
+				b->state = B2_FAILED;
+				break;
+			}
+			if(result > 0){
+				b->sent += result;
+			}
+			if(b->sent == b->commandLength){
+				b->state = B2_READING;
+			}
+			continue;
+		}
+
+		result = read(b->fd, chunk, sizeof(chunk));
+		if(result < 0){
+			if((errno == EAGAIN) || (errno == EINTR)){
+				continue;
+			}
+			b->state = B2_FAILED;
+			break;
+		}
+		if(result == 0){
+			/* hangup, nobody is on the other end */
+			b->state = B2_FAILED;
+			break;
+		}
+		for(i=0; i<result; i++){
+			if((chunk[i] == '\r') && !b->keepCR){
+				continue;
+			}
+			if(b->length < b->capacity - 1){
+				b->response[b->length++] = chunk[i];
+				b->response[b->length] = '\0';
+			}
+			if(chunk[i] == B2_PROMPT){
+				b->state = B2_DONE;
+				break;
+			}
+		}
+	}
+	return b->state;
+}
+
+/* Sends <data> and waits for the prompt; returns 1 if it came back in time */
+int b2_command(bee2serial *b, const char *data, int length)
+{
+	if(!b2_start(b, data, length)){
+		return 0;
+	}
+	return b2_step(b, b->timeoutMs) == B2_DONE;
+}
+
+/* Throws away whatever the board is still sending; returns once it has been quiet for the timeout */
+int b2_drain(bee2serial *b)
+{
+	struct pollfd waiting;
+	char chunk[256];
+	int drained = 0;
+
+	waiting.fd = b->fd;
+	waiting.events = POLLIN;
+	while(poll(&waiting, 1, b->timeoutMs) > 0){
+		if(read(b->fd, chunk, sizeof(chunk)) <= 0){
+			break;
+		}
+		drained = 1;
+	}
+	return drained;
+}
+
+void b2_close(bee2serial *b)
+{
+	if(b->fd >= 0){
+		close(b->fd);
+	}
+	b->fd = -1;
+}
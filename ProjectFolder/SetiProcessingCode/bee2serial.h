@@ -0,0 +1,52 @@
+/*
+BEE2 Serial Control v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+Talks to the BEE2 (or iBOB) shell over a serial port without ever spinning on
+read().  The port is put in raw mode and non-blocking; every wait is a poll()
+with a real deadline, so a missing board costs one timeout instead of a hang.
+
+A command is a small state machine: b2_start() queues the bytes, b2_step() moves
+them out and collects the reply until the '%' prompt comes back (or the deadline
+passes), so the caller may drive it from its own event loop.  b2_command() does
+both and waits.  The reply is kept in the caller's buffer, NUL terminated.
+*/
+
+#ifndef BEE2SERIAL_H
+#define BEE2SERIAL_H
+
+#define B2_PROMPT           '%'
+#define B2_DEFAULT_TIMEOUT  1000       /* milliseconds for one command */
+#define B2_COMMAND_SIZE     256
+
+#define B2_IDLE     0
+#define B2_SENDING  1
+#define B2_READING  2
+#define B2_DONE     3
+#define B2_TIMEOUT  4
+#define B2_FAILED   5
+
+typedef struct bee2serial_s {
+	int fd;
+	int timeoutMs;
+	int keepCR;                    /* keep carriage returns in the reply */
+	int state;
+	char command[B2_COMMAND_SIZE];
+	int commandLength;
+	int sent;
+	char *response;
+	int capacity;
+	int length;
+	long long deadline;            /* milliseconds, CLOCK_MONOTONIC */
+} bee2serial;
+
+int b2_open(bee2serial *b, const char *port, int timeoutMs, char *buffer, int capacity);
+int b2_start(bee2serial *b, const char *data, int length);
+int b2_step(bee2serial *b, int waitMs);
+int b2_command(bee2serial *b, const char *data, int length);
+int b2_drain(bee2serial *b);
+void b2_close(bee2serial *b);
+
+#endif
@@ -0,0 +1,199 @@
+/*
+BEE2 Serial Simulator v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+To compile: gcc -O -Wall -o bee2sim bee2sim.c
+
+Pretends to be the BEE2 shell on a pseudo terminal so the serial control code in
+receive (bee2serial.c) can be exercised without hardware:
+
+./bee2sim -link /tmp/bee2 &
+./receive -serial /tmp/bee2 -w -v ...
+
+Characters are echoed, a line is run when it ends, and every command is answered
+with a new '%' prompt.  ^C and the `c escape give a prompt at once.  Known
+commands are setscaler <n>, seteventlimit <n> and boardinfo; anything else gets
+an error line.
+
+Usage: bee2sim [options]
+-link <path>           Make <path> a symbolic link to the pty (removed on exit).
+-delay <ms>            Wait <ms> milliseconds before every reply.
+-mute                  Never answer, to check that callers time out.
+-v                     Print every command received.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+
+#define LINE_SIZE 256
+
+int master = -1;
+const char *linkPath = NULL;
+int delayMs = 0;
+int mute = 0;
+int verbose = 0;
+int scaler = 48;
+int eventLimit = 128;
+
+void quit();
+
+void reply(const char *text)
+{
+	if(mute){
+		return;
+	}
+	if(delayMs > 0){
+		usleep(delayMs * 1000);
+	}
+	write(master, text, strlen(text));
+}
+
+void run_line(const char *line)
+{
+	char text[1024];
+	int value;
+
+	if(verbose){
+		printf("bee2sim: '%s'\n", line);
+		fflush(stdout);
+	}
+	if(line[0] == '\0'){
+		reply("\r\n% ");
+	}
+	else if(sscanf(line, "setscaler %i", &value) == 1){
+		scaler = value;
+		reply("\r\n% ");
+	}
+	else if(sscanf(line, "seteventlimit %i", &value) == 1){
+		eventLimit = value;
+		reply("\r\n% ");
+	}
+	else if(strcmp(line, "boardinfo") == 0){
+		/* laid out like the board's reply, receive cuts 12 bytes in front and 6 behind */
+		snprintf(text, sizeof(text),
+			"\r\n\r\nboard: bee2sim\r\ndesign: seti_spec simulated\r\n"
+			"scaler: %i\r\nevent limit: %i\r\nclock: 200 MHz\r\n\r\n\r\n\r\n\r\n%% ", scaler, eventLimit);
+		reply(text);
+	}
+	else{
+		snprintf(text, sizeof(text), "\r\n%s: command not found\r\n%% ", line);
+		reply(text);
+	}
+}
+
+int main(int argc, const char *argv[])
+{
+	struct termios options;
+	struct pollfd waiting;
+	char line[LINE_SIZE], chunk[256], echo[2];
+	int length = 0, escape = 0, result, slave, i;
+	const char *slaveName;
+
+	for(i=1; i<argc; i++){
+		if((strcmp(argv[i], "-link") == 0) && (i < argc-1)){
+			linkPath = argv[++i];
+		}
+		else if((strcmp(argv[i], "-delay") == 0) && (i < argc-1)){
+			delayMs = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-mute") == 0){
+			mute = 1;
+		}
+		else if(strcmp(argv[i], "-v") == 0){
+			verbose = 1;
+		}
+		else{
+			printf("Usage: %s [-link <path>] [-delay <ms>] [-mute] [-v]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	master = posix_openpt(O_RDWR | O_NOCTTY);
+	if((master < 0) || (grantpt(master) != 0) || (unlockpt(master) != 0)){
+		printf("Could not create a pseudo terminal.\n");
+		return 1;
+	}
+	slaveName = ptsname(master);
+
+	/* hold the slave open and raw so nothing is echoed twice or lost between clients */
+	slave = open(slaveName, O_RDWR | O_NOCTTY);
+	if((slave >= 0) && (tcgetattr(slave, &options) == 0)){
+		cfmakeraw(&options);
+		tcsetattr(slave, TCSANOW, &options);
+	}
+
+	signal(SIGHUP, quit);
+	signal(SIGINT, quit);
+	signal(SIGQUIT, quit);
+	signal(SIGTERM, quit);
+	if(linkPath != NULL){
+		unlink(linkPath);
+		if(symlink(slaveName, linkPath) != 0){
+			printf("Could not link %s to %s.\n", linkPath, slaveName);
+			linkPath = NULL;
+		}
+	}
+	printf("BEE2 simulator on %s%s%s\n", slaveName, linkPath ? " linked from " : "", linkPath ? linkPath : "");
+	fflush(stdout);
+
+	waiting.fd = master;
+	waiting.events = POLLIN;
+	while(1){
+		if(poll(&waiting, 1, -1) <= 0){
+			continue;
+		}
+		result = read(master, chunk, sizeof(chunk));
+		if(result <= 0){
+			continue;
+		}
+		for(i=0; i<result; i++){
+			if(escape){
+				/* `<letter> is handled by the monitor, not the shell */
+				escape = 0;
+				reply("\r\n% ");
+			}
+			else if(chunk[i] == '`'){
+				escape = 1;
+			}
+			else if(chunk[i] == 3){
+				length = 0;
+				reply("^C\r\n% ");
+			}
+			else if((chunk[i] == '\n') || (chunk[i] == '\r')){
+				if(!mute){
+					write(master, "\r\n", 2);
+				}
+				line[length] = '\0';
+				length = 0;
+				run_line(line);
+			}
+			else{
+				if(length < LINE_SIZE-1){
+					line[length++] = chunk[i];
+				}
+				if(!mute){
+					echo[0] = chunk[i];
+					write(master, echo, 1);
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+void quit()
+{
+	if(linkPath != NULL){
+		unlink(linkPath);
+	}
+	exit(0);
+}
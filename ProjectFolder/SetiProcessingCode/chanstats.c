@@ -0,0 +1,107 @@
+/*
+Channel Statistics v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+See chanstats.h.
+*/
+
+#include <string.h>
+#include "chanstats.h"
+
+/* Truncates <path>; returns 0 if it cannot be opened */
+int chs_open(chanstats *cs, const char *path, int eventLimit)
+{
+	memset(cs, 0, sizeof(chanstats));
+	cs->out = fopen(path, "wb");
+	if(cs->out == NULL){
+		printf("Could not open file %s.\n", path);
+		return 0;
+	}
+	cs->eventLimit = eventLimit;
+	cs->saturation = (eventLimit < CHS_MAX_HITS) ? eventLimit : CHS_MAX_HITS;
+	gettimeofday(&cs->intervalStart, NULL);
+	return 1;
+}
+
+void chs_packet(chanstats *cs, unsigned int bin, int hits, double meanPower)
+{
+	chsbin *b;
+
+	if(bin >= CHS_NUM_BINS){
+		return;
+	}
+	b = &cs->bins[bin];
+	b->packets++;
+	b->hits += hits;
+	if(hits >= cs->saturation){
+		b->saturated++;
+	}
+	if(hits > (int)b->maxHits){
+		b->maxHits = hits;
+	}
+	cs->powerSum[bin] += meanPower;
+}
+
+/* Appends the interval to the file and starts the next one */
+void chs_dump(chanstats *cs)
+{
+	struct timeval now;
+	uint32_t header[6];
+	chsbin *b;
+	int i;
+
+	if(cs->out == NULL){
+		return;
+	}
+	gettimeofday(&now, NULL);
+	for(i=0; i<CHS_NUM_BINS; i++){
+		b = &cs->bins[i];
+		if(b->packets == 0){
+			b->meanPower = 0.0;
+			continue;
+		}
+		b->meanPower = cs->powerSum[i] / b->packets;
+		if(!cs->trendStarted[i]){
+			b->powerTrend = b->meanPower;
+			cs->trendStarted[i] = 1;
+		}
+		else{
+			b->powerTrend += CHS_TREND * (b->meanPower - b->powerTrend);
+		}
+	}
+
+	header[0] = CHS_MAGIC;
+	header[1] = CHS_NUM_BINS;
+	header[2] = cs->eventLimit;
+	header[3] = now.tv_sec;
+	header[4] = now.tv_usec;
+	header[5] = (now.tv_sec - cs->intervalStart.tv_sec) * 1000 + (now.tv_usec - cs->intervalStart.tv_usec) / 1000;
+	fwrite(header, sizeof(uint32_t), 6, cs->out);
+	fwrite(cs->bins, sizeof(chsbin), CHS_NUM_BINS, cs->out);
+	fflush(cs->out);
+	cs->dumps++;
+
+	/* the trend carries over, the rest starts again */
+	for(i=0; i<CHS_NUM_BINS; i++){
+		b = &cs->bins[i];
+		b->packets = 0;
+		b->hits = 0;
+		b->saturated = 0;
+		b->maxHits = 0;
+		cs->powerSum[i] = 0.0;
+	}
+	cs->intervalStart = now;
+}
+
+/* Dumps what has been counted since the last dump and closes the file */
+void chs_close(chanstats *cs)
+{
+	if(cs->out == NULL){
+		return;
+	}
+	chs_dump(cs);
+	fclose(cs->out);
+	cs->out = NULL;
+}
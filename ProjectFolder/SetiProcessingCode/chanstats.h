@@ -0,0 +1,66 @@
+/*
+Channel Statistics v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+Per PFB bin counters kept by receive as packets arrive: how many hits each bin
+reports, how often it reports as many hits as the event limit allows (so the
+board dropped the rest), and how its mean power moves.  Everything lives in
+fixed arrays; chs_dump() appends one record to the .chs file and starts a new
+interval.
+
+A .chs file is a series of records, all fields host byte order:
+
+uint32 magic ("CHS1"), uint32 number of bins (4096), uint32 event limit,
+uint32 seconds, uint32 microseconds (end of the interval),
+uint32 interval length in milliseconds,
+then for every bin, in PFB bin order:
+uint32 packets, uint32 hits, uint32 packets at the event limit, uint32 most hits
+in one packet, float mean power over the interval, float mean power trend
+(exponential average over intervals, 1/8 weight for the newest).
+
+Hits per spectrum is hits / packets, the saturated fraction is
+(packets at the event limit) / packets.  A datagram receive reads holds at most
+CHS_MAX_HITS hits, so with an event limit above that a packet counts as at the
+limit once it is full: the board had more and they are lost either way.
+*/
+
+#ifndef CHANSTATS_H
+#define CHANSTATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+#define CHS_MAGIC     0x31534843
+#define CHS_NUM_BINS  4096
+#define CHS_TREND     0.125
+#define CHS_MAX_HITS  131              /* (1060 - 12) / 8, a full datagram */
+
+typedef struct chsbin_s {
+	uint32_t packets;
+	uint32_t hits;
+	uint32_t saturated;
+	uint32_t maxHits;
+	float meanPower;
+	float powerTrend;
+} chsbin;
+
+typedef struct chanstats_s {
+	FILE *out;
+	uint32_t eventLimit;
+	int saturation;                    /* hits that count as at the limit */
+	struct timeval intervalStart;
+	double powerSum[CHS_NUM_BINS];
+	chsbin bins[CHS_NUM_BINS];
+	int trendStarted[CHS_NUM_BINS];
+	unsigned long long dumps;
+} chanstats;
+
+int chs_open(chanstats *cs, const char *path, int eventLimit);
+void chs_packet(chanstats *cs, unsigned int bin, int hits, double meanPower);
+void chs_dump(chanstats *cs);
+void chs_close(chanstats *cs);
+
+#endif
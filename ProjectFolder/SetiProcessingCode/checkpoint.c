@@ -0,0 +1,116 @@
+/*
+Checkpoint v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+See checkpoint.h.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "checkpoint.h"
+
+/* FNV-1a over the arguments, each with its terminator so "ab" "c" differs from "a" "bc" */
+uint64_t ckpt_key(int argc, const char *argv[])
+{
+	uint64_t hash = 14695981039346656037ULL;
+	const char *p;
+	int i;
+
+	for(i=1; i<argc; i++){
+		p = argv[i];
+		do{
+			hash ^= (unsigned char)*p;
+			hash *= 1099511628211ULL;
+		} while(*p++ != '\0');
+	}
+	return hash;
+}
+
+/* Returns 0 if the checkpoint could not be written; the old one, if any, is then still there */
+int ckpt_save(const char *path, uint64_t key, const ckptsection *sections, int n)
+{
+	char temporary[4096];
+	ckptheader h;
+	FILE *f;
+	int i, ok;
+
+	if(n > CKPT_MAX_SECTIONS){
+		return 0;
+	}
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, CKPT_MAGIC, sizeof(h.magic));
+	h.version = CKPT_VERSION;
+	h.sections = n;
+	h.key = key;
+	for(i=0; i<n; i++){
+		h.sizes[i] = sections[i].size;
+	}
+
+	snprintf(temporary, sizeof(temporary), "%s.%i.tmp", path, (int)getpid());
+	f = fopen(temporary, "wb");
+	if(f == NULL){
+		return 0;
+	}
+	ok = (fwrite(&h, sizeof(h), 1, f) == 1);
+	for(i=0; ok && (i<n); i++){
+		if(sections[i].size > 0){
+			ok = (fwrite(sections[i].data, sections[i].size, 1, f) == 1);
+		}
+	}
+	/* on disk before the rename, or a crash could leave a checkpoint with nothing in it */
+	if(ok && ((fflush(f) != 0) || (fsync(fileno(f)) != 0))){
+		ok = 0;
+	}
+	if(fclose(f) != 0){
+		ok = 0;
+	}
+	if(!ok || (rename(temporary, path) != 0)){
+		unlink(temporary);
+		return 0;
+	}
+	return 1;
+}
+
+/* Reads the sections back if the checkpoint at path is for this job; after CKPT_MISMATCH they may hold part of it */
+int ckpt_load(const char *path, uint64_t key, const ckptsection *sections, int n)
+{
+	ckptheader h;
+	struct stat info;
+	uint64_t total = sizeof(h);
+	FILE *f;
+	int i;
+
+	f = fopen(path, "rb");
+	if(f == NULL){
+		return CKPT_NONE;
+	}
+	if((fread(&h, sizeof(h), 1, f) != 1) || (memcmp(h.magic, CKPT_MAGIC, sizeof(h.magic)) != 0) ||
+	   (h.version != CKPT_VERSION) || (h.key != key) || (h.sections != (uint32_t)n)){
+		fclose(f);
+		return CKPT_MISMATCH;
+	}
+	for(i=0; i<n; i++){
+		if(h.sizes[i] != sections[i].size){
+			fclose(f);
+			return CKPT_MISMATCH;
+		}
+		total += h.sizes[i];
+	}
+	if((fstat(fileno(f), &info) != 0) || ((uint64_t)info.st_size != total)){
+		fclose(f);
+		return CKPT_MISMATCH;
+	}
+	for(i=0; i<n; i++){
+		if((sections[i].size > 0) && (fread(sections[i].data, sections[i].size, 1, f) != 1)){
+			fclose(f);
+			return CKPT_MISMATCH;
+		}
+	}
+	fclose(f);
+	return CKPT_LOADED;
+}
@@ -0,0 +1,55 @@
+/*
+Checkpoint v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+Saves the state of a long job so that it can carry on after a restart.  The
+state is a list of sections, each a block of plain data (no pointers that
+have to survive) of a fixed size; a section of size 0 is left out.  The file
+starts with
+
+char magic[8] ("SETICKP1", no terminator), uint32 version, uint32 number of
+sections, uint64 key, uint64 size of each of the CKPT_MAX_SECTIONS sections
+
+and the sections follow in order, host byte order throughout.  The key says
+what job the state belongs to (ckpt_key() of its arguments): a checkpoint is
+only loaded into a job with the same key and the same section sizes, so a
+different job, or a different build of the program, starts over instead.
+
+ckpt_save() writes a temporary file, syncs it and renames it over the old
+checkpoint, so after a crash at any point there is either the old checkpoint
+or the new one, whole.
+*/
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdint.h>
+
+#define CKPT_MAGIC         "SETICKP1"
+#define CKPT_VERSION       1
+#define CKPT_MAX_SECTIONS  8
+
+#define CKPT_NONE       0   /* no checkpoint at the path */
+#define CKPT_LOADED     1
+#define CKPT_MISMATCH  -1   /* there is one, for another job or unreadable */
+
+typedef struct ckptsection_s {
+	void *data;
+	uint64_t size;
+} ckptsection;
+
+typedef struct ckptheader_s {
+	char magic[8];
+	uint32_t version;
+	uint32_t sections;
+	uint64_t key;
+	uint64_t sizes[CKPT_MAX_SECTIONS];
+} ckptheader;
+
+uint64_t ckpt_key(int argc, const char *argv[]);
+int ckpt_save(const char *path, uint64_t key, const ckptsection *sections, int n);
+int ckpt_load(const char *path, uint64_t key, const ckptsection *sections, int n);
+
+#endif
@@ -18,13 +18,15 @@
 #include <fftw3.h>   /* Fast Fourier Transform functions */
 #include <math.h>    /* One plus one is two */
 #include <signal.h>  /*Signal functions*/
+#include "bee2serial.h" /* Serial commands with timeouts */
 
 
 /*   Globals    */
 #define BUFFER_SIZE 1048576
 #define COMMAND_LENGTH 10
+#define SAMPLE_TIMEOUT 5000  /* ms for one adcsample reply */
 
-int fd;              /* File descriptor for the port */
+bee2serial board;    /* The port */
 int fftFlag = 0;
 fftw_plan p;
       fftw_complex *in, *out;
@@ -60,6 +62,7 @@ int main(void)
       int skip;
       int processID;
       char fftCommand[30];
+      int tries;
 
       processID = getpid();
 
@@ -86,20 +89,22 @@ int main(void)
 
 	  p = fftw_plan_dft_1d(1, matrix, matrix, FFTW_FORWARD, FFTW_ESTIMATE);
       
-      fd = open("/dev/ttyS0", O_RDWR | O_NOCTTY | O_NDELAY | O_NONBLOCK);
-      if (fd == -1){
+      if (!b2_open(&board, "/dev/ttyS0", SAMPLE_TIMEOUT, buffer, BUFFER_SIZE)){
 	perror("open_port: Unable to open port.");
+	quit();
       }
       else{
-	//	fcntl(fd, F_SETFL, 0);
+	board.keepCR = 1;
 	printf("Serial port up...\n");
       }
 
-      write(fd, "\n", 1);
       printf("Searching for percent ... \n");
-      do{
-	result = read(fd, buffer, 1);
-      }while(buffer[0] != '%');
+      for(tries = 0; !b2_command(&board, "\n", 1); tries++){
+	if(tries == 4){
+	  printf("No prompt from the board, giving up.\n");
+	  quit();
+	}
+      }
       
 
 
@@ -113,19 +118,10 @@ int main(void)
       memset(&tmpbuf, 0, sizeof(int));
       memset(&tmpbuf2, 0, sizeof(int));
 
-      do{
-       
-	result = write(fd, COMMAND, COMMAND_LENGTH);
-      }while(result != COMMAND_LENGTH);
-
-      i=0;
-      do{
-	result = read(fd, buffer+i, 1);
-	if(result == 1){
-	  i++;
-	}
-	//printf("i=%i\n", i);
-      }while(buffer[i-1] != '%');
+      result = b2_command(&board, COMMAND, COMMAND_LENGTH);
+      if(!result){
+	printf("No reply to %s", COMMAND);
+      }
 
       sscanf(buffer+COMMAND_LENGTH+2, "%08X\t%08X\t", &rows, &columns);
       printf("rows: %i, cols: %i\n", rows, columns);      
@@ -135,10 +131,7 @@ int main(void)
 	printf("It appears the serial device isn't ready yet, attempting to clear serial buffer...\n");
       
         
-	do {
-	  
-          result = read(fd, tmpbuffer, 4);   
-	  }  while( strcmp(tmpbuffer, "IBOB") != 0);
+	b2_drain(&board);
 
         printf("Trying again...\n");
         skip = 1;
@@ -249,6 +242,7 @@ int main(void)
 void quit(){
 
   printf("Exiting....\n");
+  b2_close(&board);
   fftw_destroy_plan(p);
    fftw_free(in); fftw_free(out);
 
@@ -0,0 +1,257 @@
+/*
+Data File Index v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+See datindex.h.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "datparse.h"
+#include "datindex.h"
+
+static int64_t modified(const struct stat *info)
+{
+	return (int64_t)info->st_mtim.tv_sec * 1000000000 + info->st_mtim.tv_nsec;
+}
+
+/* name_1.dat -> name_1.idx; any other name gets .idx added */
+void idx_path(char *out, size_t size, const char *datPath)
+{
+	size_t length = strlen(datPath);
+
+	if((length > 4) && (strcmp(datPath + length - 4, ".dat") == 0)){
+		snprintf(out, size, "%.*s.idx", (int)(length - 4), datPath);
+	}
+	else{
+		snprintf(out, size, "%s.idx", datPath);
+	}
+}
+
+static void block_start(idxblock *b, size_t offset, uint32_t spectrum)
+{
+	memset(b, 0, sizeof(idxblock));
+	b->offset = offset;
+	b->spectrum = spectrum;
+	b->minTime = INT64_MAX;
+	b->maxTime = INT64_MIN;
+	b->minFine = UINT32_MAX;
+	b->maxFine = 0;
+}
+
+/* Reads the whole .dat; returns 0 if it cannot be opened or there is no memory */
+int idx_build(const char *datPath, int swap, idxheader *h, idxblock **blocks)
+{
+	datfile datFile;
+	datrecord record;
+	struct stat info;
+	idxblock *list = NULL;
+	idxblock *grown;
+	idxblock *b = NULL;
+	size_t capacity = 0;
+	int64_t time;
+	uint32_t coarse, fine, lastBin = 0;
+	uint32_t j;
+	uint64_t k;
+	int started = 0;
+
+	*blocks = NULL;
+	memset(h, 0, sizeof(idxheader));
+	memcpy(h->magic, IDX_MAGIC, sizeof(h->magic));
+	h->version = IDX_VERSION;
+	h->blockRecords = IDX_BLOCK_RECORDS;
+	h->minTime = INT64_MAX;
+	h->maxTime = INT64_MIN;
+	h->minFine = UINT32_MAX;
+
+	if(!dat_open(&datFile, datPath, swap)){
+		return 0;
+	}
+	if(fstat(datFile.fd, &info) == 0){
+		h->datSize = info.st_size;
+		h->datInode = info.st_ino;
+		h->datModified = modified(&info);
+	}
+
+	while(dat_next(&datFile, &record)){
+		/* a new spectrum whenever the bin as sent does not go up */
+		if(record.pfbBin < 4096){
+			if(started && (record.pfbBin <= lastBin)){
+				h->spectra++;
+			}
+			lastBin = record.pfbBin;
+		}
+		if(!started){
+			h->spectra = 1;
+			started = 1;
+		}
+
+		if((b == NULL) || (b->records == IDX_BLOCK_RECORDS)){
+			if(h->blocks == capacity){
+				capacity = capacity ? 2*capacity : 256;
+				grown = (idxblock *)realloc(list, capacity * sizeof(idxblock));
+				if(grown == NULL){
+					free(list);
+					dat_close(&datFile);
+					return 0;
+				}
+				list = grown;
+			}
+			b = &list[h->blocks++];
+			block_start(b, record.offset, h->spectra - 1);
+		}
+
+		time = (int64_t)record.sec * 1000000 + record.usec;
+		if(time < b->minTime){
+			b->minTime = time;
+		}
+		if(time > b->maxTime){
+			b->maxTime = time;
+		}
+		coarse = (record.pfbBin + 2048) % 4096;
+		for(j=0; j<record.nhits; j++){
+			fine = ((dat_hit_bin(&record, j) + 16384) % 32768) + 32768*coarse;
+			if(fine < b->minFine){
+				b->minFine = fine;
+			}
+			if(fine > b->maxFine){
+				b->maxFine = fine;
+			}
+		}
+		b->hits += record.nhits;
+		b->records++;
+		h->records++;
+	}
+	dat_close(&datFile);
+
+	h->timeOrdered = 1;
+	for(k=0; k<h->blocks; k++){
+		if(list[k].minTime < h->minTime){
+			h->minTime = list[k].minTime;
+		}
+		if(list[k].maxTime > h->maxTime){
+			h->maxTime = list[k].maxTime;
+		}
+		if(list[k].minFine < h->minFine){
+			h->minFine = list[k].minFine;
+		}
+		if(list[k].maxFine > h->maxFine){
+			h->maxFine = list[k].maxFine;
+		}
+		if((k > 0) && ((list[k].minTime < list[k-1].minTime) || (list[k].maxTime < list[k-1].maxTime))){
+			h->timeOrdered = 0;
+		}
+	}
+	*blocks = list;
+	return 1;
+}
+
+int idx_save(const char *idxPath, const idxheader *h, const idxblock *blocks)
+{
+	char temporary[4096];
+	FILE *f;
+	int ok;
+
+	snprintf(temporary, sizeof(temporary), "%s.%i.tmp", idxPath, (int)getpid());
+	f = fopen(temporary, "wb");
+	if(f == NULL){
+		return 0;
+	}
+	ok = (fwrite(h, sizeof(idxheader), 1, f) == 1);
+	if(ok && (h->blocks > 0)){
+		ok = (fwrite(blocks, sizeof(idxblock), h->blocks, f) == h->blocks);
+	}
+	if(fclose(f) != 0){
+		ok = 0;
+	}
+	if(!ok || (rename(temporary, idxPath) != 0)){
+		unlink(temporary);
+		return 0;
+	}
+	return 1;
+}
+
+/* Returns 0 if there is no usable index at idxPath */
+int idx_load(const char *idxPath, idxheader *h, idxblock **blocks)
+{
+	FILE *f;
+	struct stat info;
+
+	*blocks = NULL;
+	f = fopen(idxPath, "rb");
+	if(f == NULL){
+		return 0;
+	}
+	if((fread(h, sizeof(idxheader), 1, f) != 1) || (memcmp(h->magic, IDX_MAGIC, sizeof(h->magic)) != 0) ||
+	   (h->version != IDX_VERSION) || (fstat(fileno(f), &info) != 0) ||
+	   ((uint64_t)info.st_size != sizeof(idxheader) + h->blocks * sizeof(idxblock))){
+		fclose(f);
+		return 0;
+	}
+	if(h->blocks > 0){
+		*blocks = (idxblock *)malloc(h->blocks * sizeof(idxblock));
+		if((*blocks == NULL) || (fread(*blocks, sizeof(idxblock), h->blocks, f) != h->blocks)){
+			free(*blocks);
+			*blocks = NULL;
+			fclose(f);
+			return 0;
+		}
+	}
+	fclose(f);
+	return 1;
+}
+
+/* The index of datPath, loaded if it is current and otherwise built and saved; returns 0 if the .dat cannot be read */
+int idx_get(const char *datPath, int swap, idxheader *h, idxblock **blocks, int *built)
+{
+	char idxPath[4096];
+	struct stat info;
+
+	*built = 0;
+	if(stat(datPath, &info) != 0){
+		return 0;
+	}
+	idx_path(idxPath, sizeof(idxPath), datPath);
+	if(idx_load(idxPath, h, blocks)){
+		if((h->datSize == (uint64_t)info.st_size) && (h->datInode == (uint64_t)info.st_ino) &&
+		   (h->datModified == modified(&info))){
+			return 1;
+		}
+		free(*blocks);
+		*blocks = NULL;
+	}
+	if(!idx_build(datPath, swap, h, blocks)){
+		return 0;
+	}
+	*built = 1;
+	/* a directory we cannot write to only means building it again next time */
+	idx_save(idxPath, h, *blocks);
+	return 1;
+}
+
+/* The first block that can hold a record at fromTime or later; without time order, block 0 */
+uint64_t idx_first_block(const idxheader *h, const idxblock *blocks, int64_t fromTime)
+{
+	uint64_t low = 0, high = h->blocks, middle;
+
+	if(!h->timeOrdered){
+		return 0;
+	}
+	/* maxTime does not go down, so the blocks ending before fromTime all come first */
+	while(low < high){
+		middle = low + (high - low) / 2;
+		if(blocks[middle].maxTime < fromTime){
+			low = middle + 1;
+		}
+		else{
+			high = middle;
+		}
+	}
+	return low;
+}
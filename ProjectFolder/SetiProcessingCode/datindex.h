@@ -0,0 +1,81 @@
+/*
+Data File Index v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+A sparse index kept beside each receive .dat file (name_1.dat gets
+name_1.idx) so a query for a time and frequency range can go straight to
+the records that might hold hits in it instead of reading the whole file.
+
+The records of the .dat are cut into blocks of IDX_BLOCK_RECORDS packets.
+For each block the index has the byte offset of its first record, the
+spectrum that record belongs to, and the smallest and largest time stamp and
+absolute fine bin ((bin+16384)%32768)+32768*coarse bin, coarse bin being the
+PFB bin after the +2048 rotation) in it.  A block without hits has
+minFine > maxFine.  The header repeats these over the whole file and keeps
+the size, modification time and inode of the .dat when it was indexed: a
+.dat that has grown since (it was still being written), been rewritten or
+been replaced by another file of the same name gets a fresh index.
+
+receive stamps the records as they arrive, so the blocks normally come in
+time order.  The header says whether they do (each block's minTime and
+maxTime no earlier than those of the block before); if so idx_first_block()
+finds the first block a time range can reach by bisection, and the blocks
+after one that starts past the range can be left alone.
+
+Both structures are written as they are, in the byte order of the host that
+built the index.  The index is written to a temporary file and renamed into
+place, so a reader never sees a partial one.
+*/
+
+#ifndef DATINDEX_H
+#define DATINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define IDX_MAGIC          "SETIIDX1"
+#define IDX_VERSION        2
+#define IDX_BLOCK_RECORDS  256
+
+typedef struct idxheader_s {
+	char magic[8];              /* IDX_MAGIC, no terminator */
+	uint32_t version;
+	uint32_t blockRecords;
+	uint64_t datSize;           /* of the .dat when it was indexed */
+	uint64_t datInode;
+	int64_t datModified;        /* nanoseconds since 1970 */
+	uint64_t records;
+	uint64_t blocks;
+	uint64_t spectra;           /* started in the file */
+	int64_t minTime, maxTime;   /* microseconds since 1970 */
+	uint32_t minFine, maxFine;
+	uint32_t timeOrdered;       /* the blocks are in time order, see above */
+	uint32_t reserved;
+} idxheader;
+
+typedef struct idxblock_s {
+	uint64_t offset;            /* of its first record in the .dat */
+	int64_t minTime, maxTime;
+	uint32_t records;
+	uint32_t spectrum;          /* of its first record, counted from 0 in the file */
+	uint32_t minFine, maxFine;
+	uint32_t hits;
+	uint32_t reserved;
+} idxblock;
+
+void idx_path(char *out, size_t size, const char *datPath);
+int idx_build(const char *datPath, int swap, idxheader *h, idxblock **blocks);
+int idx_save(const char *idxPath, const idxheader *h, const idxblock *blocks);
+int idx_load(const char *idxPath, idxheader *h, idxblock **blocks);
+int idx_get(const char *datPath, int swap, idxheader *h, idxblock **blocks, int *built);
+uint64_t idx_first_block(const idxheader *h, const idxblock *blocks, int64_t fromTime);
+
+static inline int idx_overlaps(int64_t minTime, int64_t maxTime, uint32_t minFine, uint32_t maxFine,
+	int64_t fromTime, int64_t toTime, uint32_t lowFine, uint32_t highFine)
+{
+	return (minTime <= toTime) && (maxTime >= fromTime) && (minFine <= highFine) && (maxFine >= lowFine);
+}
+
+#endif
@@ -0,0 +1,238 @@
+/*
+Data File Parser v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+See datparse.h.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "datparse.h"
+
+/* Maps path for reading; returns 0 if it cannot be opened.  An empty file has no records. */
+int dat_open(datfile *f, const char *path, int swap)
+{
+	struct stat info;
+	void *data;
+
+	memset(f, 0, sizeof(datfile));
+	f->swap = swap;
+	f->fd = open(path, O_RDONLY);
+	if(f->fd < 0){
+		return 0;
+	}
+	if(fstat(f->fd, &info) != 0){
+		close(f->fd);
+		f->fd = -1;
+		return 0;
+	}
+	f->size = info.st_size;
+	if(f->size > 0){
+		data = mmap(NULL, f->size, PROT_READ, MAP_PRIVATE, f->fd, 0);
+		if(data == MAP_FAILED){
+			close(f->fd);
+			f->fd = -1;
+			return 0;
+		}
+		/* read once front to back, let the kernel read ahead and drop what is behind */
+		madvise(data, f->size, MADV_SEQUENTIAL);
+		f->data = (const unsigned char *)data;
+	}
+	return 1;
+}
+
+/* Fills r with a view of the next record; returns 1, or 0 at the end of the file or at a bad record */
+int dat_next(datfile *f, datrecord *r)
+{
+	uint32_t header[6];
+	size_t left;
+
+	left = f->size - f->offset;
+	if(left == 0){
+		return 0;
+	}
+	if(left < DAT_HEADER_BYTES + DAT_MIN_LENGTH){
+		f->truncated = 1;
+		return 0;
+	}
+	memcpy(header, f->data + f->offset, sizeof(header));
+	if(f->swap){
+		header[0] = dat_swap32(header[0]);
+	}
+	if((header[0] < DAT_MIN_LENGTH) || (header[0] > DAT_MAX_LENGTH) || (header[0] % 4 != 0)){
+		f->corrupt = 1;
+		return 0;
+	}
+	if(header[0] > left - DAT_HEADER_BYTES){
+		f->truncated = 1;
+		return 0;
+	}
+
+	r->length = header[0];
+	r->sec = f->swap ? dat_swap32(header[1]) : header[1];
+	r->usec = f->swap ? dat_swap32(header[2]) : header[2];
+	r->pfbBin = f->swap ? dat_swap32(header[3]) : header[3];
+	r->meanPower = f->swap ? dat_swap32(header[4]) : header[4];
+	r->errorCode = f->swap ? dat_swap32(header[5]) : header[5];
+	r->nhits = (r->length - 12) / 8;
+	/* records are whole words and the mapping is page aligned, so this is aligned too */
+	r->hits = (const uint32_t *)(f->data + f->offset + DAT_HEADER_BYTES + 12);
+	r->swap = f->swap;
+	r->offset = f->offset;
+
+	f->offset += DAT_HEADER_BYTES + r->length;
+	f->records++;
+	return 1;
+}
+
+/* For a file that is still being written: maps what has been added since; returns 1 if it grew.
+   Records handed out before are views of the old mapping and are gone after this. */
+int dat_refresh(datfile *f)
+{
+	struct stat info;
+	void *data;
+
+	if((fstat(f->fd, &info) != 0) || ((size_t)info.st_size <= f->size)){
+		return 0;
+	}
+	data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, f->fd, 0);
+	if(data == MAP_FAILED){
+		return 0;
+	}
+	madvise(data, info.st_size, f->seeking ? MADV_RANDOM : MADV_SEQUENTIAL);
+	if(f->data != NULL){
+		munmap((void *)f->data, f->size);
+	}
+	f->data = (const unsigned char *)data;
+	f->size = info.st_size;
+	/* a record cut off at the old end may be whole now */
+	f->truncated = 0;
+	return 1;
+}
+
+/* Continues at offset, which has to be the start of a record (an index gives those); returns 0 if it is past the end */
+int dat_seek(datfile *f, size_t offset)
+{
+	if(offset > f->size){
+		return 0;
+	}
+	if(!f->seeking && (f->size > 0)){
+		/* jumping around, read-ahead would only fetch what is skipped */
+		madvise((void *)f->data, f->size, MADV_RANDOM);
+		f->seeking = 1;
+	}
+	return dat_resume(f, offset);
+}
+
+/* As dat_seek(), for a reader that goes on in order from there (after a restart), so read-ahead stays on */
+int dat_resume(datfile *f, size_t offset)
+{
+	if(offset > f->size){
+		return 0;
+	}
+	f->offset = offset;
+	f->truncated = 0;
+	f->corrupt = 0;
+	return 1;
+}
+
+void dat_close(datfile *f)
+{
+	if(f->data != NULL){
+		munmap((void *)f->data, f->size);
+	}
+	if(f->fd >= 0){
+		close(f->fd);
+	}
+	f->data = NULL;
+	f->fd = -1;
+}
+
+/* Splits a series prefix into the directory it is in and the start of the file names there; returns the latter, NULL if too long */
+const char *dat_series_directory(const char *prefix, char *directory, size_t size)
+{
+	const char *base;
+
+	base = strrchr(prefix, '/');
+	if(base == NULL){
+		snprintf(directory, size, ".");
+		return prefix;
+	}
+	if((size_t)(base - prefix) >= size){
+		return NULL;
+	}
+	if(base == prefix){
+		snprintf(directory, size, "/");
+	}
+	else{
+		memcpy(directory, prefix, base - prefix);
+		directory[base - prefix] = '\0';
+	}
+	return base + 1;
+}
+
+/* How many of <prefix>1.dat, <prefix>2.dat, ... exist with no gap, from one pass over the directory */
+int dat_series_count(const char *prefix)
+{
+	char directory[PATH_MAX];
+	const char *base;
+	char *end;
+	DIR *dir;
+	struct dirent *entry;
+	unsigned char *found = NULL;
+	unsigned char *grown;
+	long n, foundSize = 0;
+	size_t baseLength;
+	int count;
+
+	base = dat_series_directory(prefix, directory, sizeof(directory));
+	if(base == NULL){
+		return 0;
+	}
+	baseLength = strlen(base);
+
+	dir = opendir(directory);
+	if(dir == NULL){
+		return 0;
+	}
+	while((entry = readdir(dir)) != NULL){
+		if(strncmp(entry->d_name, base, baseLength) != 0){
+			continue;
+		}
+		/* the numbers are written with %i, so no sign and no leading zeros */
+		if((entry->d_name[baseLength] < '1') || (entry->d_name[baseLength] > '9')){
+			continue;
+		}
+		n = strtol(entry->d_name + baseLength, &end, 10);
+		if((strcmp(end, ".dat") != 0) || (n > 100000000)){
+			continue;
+		}
+		if(n >= foundSize){
+			grown = (unsigned char *)realloc(found, 2*n + 64);
+			if(grown == NULL){
+				break;
+			}
+			memset(grown + foundSize, 0, 2*n + 64 - foundSize);
+			found = grown;
+			foundSize = 2*n + 64;
+		}
+		found[n] = 1;
+	}
+	closedir(dir);
+
+	count = 0;
+	while((count+1 < foundSize) && found[count+1]){
+		count++;
+	}
+	free(found);
+	return count;
+}
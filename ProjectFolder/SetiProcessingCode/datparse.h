@@ -0,0 +1,86 @@
+/*
+Data File Parser v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+Reads the .dat files written by receive without copying them: the file is
+mapped and dat_next() hands out one record at a time as a view into the
+mapping.  A record in the file is
+
+uint32 length of data (12 + 8 * hits), int32 seconds, int32 microseconds,
+uint32 PFB bin number, uint32 mean power, uint32 error code,
+then <hits> pairs of uint32 bin number and uint32 power
+
+all in the byte order of the host that recorded it (swap says whether that
+differs from ours).  Every record is checked against the end of the file
+before it is handed out, so a file cut short while receive was writing it,
+or one with a damaged length field, ends the iteration instead of sending
+the reader past the mapping.  For a file that receive is still writing,
+dat_refresh() maps what has been appended and the reader carries on from
+the record that was cut off.
+
+A series is the files <prefix>1.dat, <prefix>2.dat, ... that receive wrote
+in one run; dat_series_count() finds how many there are.
+*/
+
+#ifndef DATPARSE_H
+#define DATPARSE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DAT_HEADER_BYTES  12
+#define DAT_MIN_LENGTH    12
+#define DAT_MAX_LENGTH    (1 << 20)
+
+typedef struct datrecord_s {
+	uint32_t length;            /* bytes of data after the 12 byte header */
+	int32_t sec;
+	int32_t usec;
+	uint32_t pfbBin;            /* as sent, before the +2048 rotation */
+	uint32_t meanPower;
+	uint32_t errorCode;
+	uint32_t nhits;
+	const uint32_t *hits;       /* nhits (bin, power) pairs, read with dat_hit_bin/dat_hit_power */
+	int swap;
+	size_t offset;              /* of the record in the file */
+} datrecord;
+
+typedef struct datfile_s {
+	int fd;
+	const unsigned char *data;
+	size_t size;
+	size_t offset;              /* of the next record */
+	int swap;
+	unsigned long long records;
+	int truncated;              /* the file ends inside a record */
+	int corrupt;                /* a record length makes no sense */
+	int seeking;                /* dat_seek() has been used, the mapping is read at random */
+} datfile;
+
+int dat_open(datfile *f, const char *path, int swap);
+int dat_next(datfile *f, datrecord *r);
+int dat_seek(datfile *f, size_t offset);
+int dat_resume(datfile *f, size_t offset);
+int dat_refresh(datfile *f);
+void dat_close(datfile *f);
+int dat_series_count(const char *prefix);
+const char *dat_series_directory(const char *prefix, char *directory, size_t size);
+
+static inline uint32_t dat_swap32(uint32_t x)
+{
+	return __builtin_bswap32(x);
+}
+
+static inline uint32_t dat_hit_bin(const datrecord *r, int i)
+{
+	return r->swap ? dat_swap32(r->hits[2*i]) : r->hits[2*i];
+}
+
+static inline uint32_t dat_hit_power(const datrecord *r, int i)
+{
+	return r->swap ? dat_swap32(r->hits[2*i+1]) : r->hits[2*i+1];
+}
+
+#endif
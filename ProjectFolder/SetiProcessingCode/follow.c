@@ -0,0 +1,176 @@
+/*
+File Series Follower v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+See follow.h.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include "follow.h"
+
+static long long now_ms()
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (long long)t.tv_sec * 1000 + t.tv_nsec / 1000000;
+}
+
+static void file_path(const follower *w, int index, char *path, size_t size)
+{
+	snprintf(path, size, "%s%i.dat", w->prefix, index);
+}
+
+static int has_data(const follower *w, int index)
+{
+	char path[PATH_MAX + 16];
+	struct stat info;
+
+	file_path(w, index, path, sizeof(path));
+	return (stat(path, &info) == 0) && (info.st_size > 0);
+}
+
+static int is_closed(const follower *w, int index)
+{
+	return (index < w->closedSize) && w->closed[index];
+}
+
+/* Notes which files of the series their writer has closed */
+static void read_events(follower *w)
+{
+	char events[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *event;
+	unsigned char *grown;
+	size_t baseLength = strlen(w->base);
+	ssize_t length;
+	char *p, *end;
+	long n;
+
+	while((length = read(w->fd, events, sizeof(events))) > 0){
+		for(p = events; p < events + length; p += sizeof(struct inotify_event) + event->len){
+			event = (const struct inotify_event *)p;
+			if(!(event->mask & IN_CLOSE_WRITE) || (event->len == 0) || (strncmp(event->name, w->base, baseLength) != 0)){
+				continue;
+			}
+			n = strtol(event->name + baseLength, &end, 10);
+			if((n < 1) || (n > 100000000) || (strcmp(end, ".dat") != 0)){
+				continue;
+			}
+			if(n >= w->closedSize){
+				grown = (unsigned char *)realloc(w->closed, 2*n + 64);
+				if(grown == NULL){
+					continue;
+				}
+				memset(grown + w->closedSize, 0, 2*n + 64 - w->closedSize);
+				w->closed = grown;
+				w->closedSize = 2*n + 64;
+			}
+			w->closed[n] = 1;
+		}
+	}
+}
+
+/* Until something happens in the directory, or FOLLOW_POLL_MS */
+static void follow_sleep(follower *w)
+{
+	struct pollfd p;
+
+	if(w->fd < 0){
+		usleep(FOLLOW_POLL_MS * 1000);
+		return;
+	}
+	p.fd = w->fd;
+	p.events = POLLIN;
+	if(poll(&p, 1, FOLLOW_POLL_MS) > 0){
+		read_events(w);
+	}
+}
+
+/* prefix is the series name with the "_"; returns 0 only if it is too long */
+int follow_start(follower *w, const char *prefix)
+{
+	char directory[PATH_MAX];
+
+	memset(w, 0, sizeof(follower));
+	if(strlen(prefix) >= sizeof(w->prefix)){
+		return 0;
+	}
+	strcpy(w->prefix, prefix);
+	w->base = dat_series_directory(w->prefix, directory, sizeof(directory));
+	if(w->base == NULL){
+		return 0;
+	}
+	w->lastGrowth = now_ms();
+
+	w->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if(w->fd >= 0){
+		if(inotify_add_watch(w->fd, directory, IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO) < 0){
+			close(w->fd);
+			w->fd = -1;
+		}
+	}
+	if(w->fd < 0){
+		printf("Warning: cannot watch %s, looking for new data every %i ms instead.\n", directory, FOLLOW_POLL_MS);
+	}
+	return 1;
+}
+
+/* Waits for file index of the series to appear; returns 0 if told to stop first */
+int follow_wait_file(follower *w, int index)
+{
+	char path[PATH_MAX + 16];
+
+	file_path(w, index, path, sizeof(path));
+	while(!w->stop){
+		if(access(path, F_OK) == 0){
+			w->lastGrowth = now_ms();
+			return 1;
+		}
+		follow_sleep(w);
+	}
+	return 0;
+}
+
+/* Called when f, file index, has no complete record left: returns 1 once it has grown, 0 when it is finished or we are told to stop */
+int follow_wait(follower *w, datfile *f, int index)
+{
+	while(!w->stop){
+		if(f->corrupt){
+			/* more data will not make this record readable */
+			return 0;
+		}
+		if(dat_refresh(f)){
+			w->lastGrowth = now_ms();
+			return 1;
+		}
+		/* the refresh above came after the close was seen, so nothing written is left behind */
+		if(is_closed(w, index) || has_data(w, index+2)){
+			return 0;
+		}
+		if(has_data(w, index+1) && (now_ms() - w->lastGrowth >= FOLLOW_SETTLE_MS)){
+			return 0;
+		}
+		follow_sleep(w);
+	}
+	return 0;
+}
+
+void follow_stop(follower *w)
+{
+	if(w->fd >= 0){
+		close(w->fd);
+		w->fd = -1;
+	}
+	free(w->closed);
+	w->closed = NULL;
+	w->closedSize = 0;
+}
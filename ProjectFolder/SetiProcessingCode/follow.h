@@ -0,0 +1,45 @@
+/*
+File Series Follower v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+Lets a reader keep up with a series of .dat files that receive is still
+writing.  An inotify watch on the directory wakes the reader when a file of
+the series is created, written or closed; without inotify (or if an event
+is missed) it looks again every FOLLOW_POLL_MS.
+
+receive opens and preallocates <prefix>N+1.dat before it needs it, and its
+writes reach the file a buffer at a time, so neither the next file existing
+nor a record cut off at the end of this one means anything by itself.  A
+file is finished when receive closes it.  If that was before we started
+watching, it is finished once the file after the next has data, or the next
+has data and this one has not grown for FOLLOW_SETTLE_MS.
+*/
+
+#ifndef FOLLOW_H
+#define FOLLOW_H
+
+#include <signal.h>
+#include <limits.h>
+#include "datparse.h"
+
+#define FOLLOW_POLL_MS    250
+#define FOLLOW_SETTLE_MS  2000
+
+typedef struct follower_s {
+	int fd;                     /* inotify, -1 if we are polling */
+	char prefix[PATH_MAX];
+	const char *base;           /* file names start with this, within prefix */
+	unsigned char *closed;      /* by file number, closed by its writer */
+	long closedSize;
+	long long lastGrowth;       /* ms, when the file being read last grew */
+	volatile sig_atomic_t stop; /* set from a signal handler to give up waiting */
+} follower;
+
+int follow_start(follower *w, const char *prefix);
+int follow_wait_file(follower *w, int index);
+int follow_wait(follower *w, datfile *f, int index);
+void follow_stop(follower *w);
+
+#endif
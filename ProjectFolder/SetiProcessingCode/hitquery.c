@@ -0,0 +1,223 @@
+/*
+Hit Query v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+To compile: gcc -O -Wall -o hitquery datparse.c datindex.c hitquery.c -lm
+
+Prints the hits of a series of receive .dat files that fall in a time range
+and a frequency (or fine bin) range, one per line:
+
+time,coarse_bin,fine_bin,power,MHz
+
+(the columns of analyze -csv with the frequency added).  Each file's index
+(see datindex.h) is used to skip the files and the blocks of records that
+cannot hold such a hit, going straight to the blocks of the time range when
+they are in time order; an index that is missing or out of date is built
+first and saved beside the file for the next query.
+
+Usage: hitquery [filename] [options]
+ -t <from> <to>      Time range, seconds since 1970 ("1117039029.25") or local
+                     time ("2005-05-25 09:17:09").
+ -f <low> <high>     Frequency range in MHz.
+ -b <low> <high>     Absolute fine bin range (0 to 134217727) instead.
+ -c <MHz>            Center frequency, as analyze -d2 (default 2275).
+ -build              Only bring the indexes up to date.
+ -v                  Report files and blocks read and skipped.
+
+  [filename] is the name of the files minus the "_<integer>.dat", as for analyze.
+Without -t or -f/-b the range is unbounded in that dimension.
+*/
+
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <sys/time.h>
+#include "datparse.h"
+#include "datindex.h"
+
+#define BYTE_SWAPPING 0
+#define FINE_BINS 134217728
+
+/* Seconds since 1970 with a fraction, or a local date and time; returns microseconds, -1 if it is neither */
+int64_t parseTime(const char *text)
+{
+	struct tm when;
+	const char *end;
+	char *number;
+	double seconds;
+
+	if(strchr(text, ':') == NULL){
+		seconds = strtod(text, &number);
+		if((number == text) || (*number != '\0')){
+			return -1;
+		}
+		return (int64_t)llround(seconds * 1000000.0);
+	}
+	memset(&when, 0, sizeof(when));
+	end = strptime(text, "%Y-%m-%d %H:%M:%S", &when);
+	if(end == NULL){
+		end = strptime(text, "%Y-%m-%dT%H:%M:%S", &when);
+	}
+	if((end == NULL) || (*end != '\0')){
+		return -1;
+	}
+	when.tm_isdst = -1;
+	return (int64_t)mktime(&when) * 1000000;
+}
+
+/* The absolute fine bin the analyze plots put at frequency MHz */
+double fineBinAt(double MHz, double center)
+{
+	return (MHz - center + 100.0 + 0.0244140625) * 671088.64;
+}
+
+double frequencyOf(uint32_t fine, double center)
+{
+	return ((double) fine) / 671088.64 - 100.0 - 0.0244140625 + center;
+}
+
+int main(int argc, const char *argv[])
+{
+	char fileheader[4000];
+	char filename[4096];
+	int64_t fromTime = INT64_MIN, toTime = INT64_MAX, time;
+	double lowMHz = 0, highMHz = 0, center = 2275.0, low, high;
+	uint32_t lowFine = 0, highFine = FINE_BINS - 1, coarse, fine;
+	int frequencyGiven = 0, onlyBuild = 0, verbose = 0;
+	int numberOfFiles, i, built;
+	uint32_t j;
+	uint64_t b, r;
+	unsigned long long filesSkipped = 0, filesBuilt = 0, blocksTotal = 0, blocksRead = 0, recordsRead = 0, hitsFound = 0;
+	struct timeval started, finished;
+	idxheader header;
+	idxblock *blocks;
+	datfile datFile;
+	datrecord record;
+
+	fileheader[0] = '\0';
+	for(i=1; i<argc; i++){
+		if((strcmp(argv[i], "-t") == 0) && (i+2 < argc)){
+			fromTime = parseTime(argv[i+1]);
+			toTime = parseTime(argv[i+2]);
+			if((fromTime < 0) || (toTime < 0)){
+				printf("Cannot read the time range %s to %s.\n", argv[i+1], argv[i+2]);
+				return 1;
+			}
+			i += 2;
+		}
+		else if((strcmp(argv[i], "-f") == 0) && (i+2 < argc)){
+			lowMHz = atof(argv[i+1]);
+			highMHz = atof(argv[i+2]);
+			frequencyGiven = 1;
+			i += 2;
+		}
+		else if((strcmp(argv[i], "-b") == 0) && (i+2 < argc)){
+			lowFine = strtoul(argv[i+1], NULL, 10);
+			highFine = strtoul(argv[i+2], NULL, 10);
+			i += 2;
+		}
+		else if((strcmp(argv[i], "-c") == 0) && (i+1 < argc)){
+			center = atof(argv[i+1]);
+			i++;
+		}
+		else if(strcmp(argv[i], "-build") == 0){
+			onlyBuild = 1;
+		}
+		else if(strcmp(argv[i], "-v") == 0){
+			verbose = 1;
+		}
+		else if(argv[i][0] != '-'){
+			snprintf(fileheader, sizeof(fileheader) - 1, "%s", argv[i]);
+		}
+		else{
+			printf("Unknown option %s.\n", argv[i]);
+			return 1;
+		}
+	}
+	if(fileheader[0] == '\0'){
+		printf("Usage: %s [filename] [-t <from> <to>] [-f <lowMHz> <highMHz> | -b <lowBin> <highBin>] [-c <MHz>] [-build] [-v]\n", argv[0]);
+		return 1;
+	}
+	strcat(fileheader, "_");
+
+	if(frequencyGiven){
+		/* generous at the edges, each hit is checked against the bins anyway */
+		low = floor(fineBinAt(lowMHz, center));
+		high = ceil(fineBinAt(highMHz, center));
+		if((high < 0) || (low > FINE_BINS - 1) || (low > high)){
+			printf("%.6f to %.6f MHz is outside the band around %.3f MHz.\n", lowMHz, highMHz, center);
+			return 1;
+		}
+		lowFine = (low < 0) ? 0 : (uint32_t)low;
+		highFine = (high > FINE_BINS - 1) ? FINE_BINS - 1 : (uint32_t)high;
+	}
+
+	numberOfFiles = dat_series_count(fileheader);
+	if(numberOfFiles == 0){
+		printf("No files %s<n>.dat found.\n", fileheader);
+		return 1;
+	}
+
+	gettimeofday(&started, NULL);
+	for(i=1; i<=numberOfFiles; i++){
+		snprintf(filename, sizeof(filename), "%s%i.dat", fileheader, i);
+		if(!idx_get(filename, BYTE_SWAPPING, &header, &blocks, &built)){
+			printf("Warning: could not read %s, skipped.\n", filename);
+			continue;
+		}
+		filesBuilt += built;
+		blocksTotal += header.blocks;
+		if(onlyBuild || !idx_overlaps(header.minTime, header.maxTime, header.minFine, header.maxFine, fromTime, toTime, lowFine, highFine)){
+			filesSkipped++;
+			free(blocks);
+			continue;
+		}
+		if(!dat_open(&datFile, filename, BYTE_SWAPPING)){
+			printf("Warning: could not read %s, skipped.\n", filename);
+			free(blocks);
+			continue;
+		}
+
+		for(b=idx_first_block(&header, blocks, fromTime); b<header.blocks; b++){
+			if(header.timeOrdered && (blocks[b].minTime > toTime)){
+				break;
+			}
+			if(!idx_overlaps(blocks[b].minTime, blocks[b].maxTime, blocks[b].minFine, blocks[b].maxFine, fromTime, toTime, lowFine, highFine)){
+				continue;
+			}
+			blocksRead++;
+			dat_seek(&datFile, blocks[b].offset);
+			for(r=0; (r < blocks[b].records) && dat_next(&datFile, &record); r++){
+				recordsRead++;
+				time = (int64_t)record.sec * 1000000 + record.usec;
+				if((time < fromTime) || (time > toTime)){
+					continue;
+				}
+				coarse = (record.pfbBin + 2048) % 4096;
+				for(j=0; j<record.nhits; j++){
+					fine = ((dat_hit_bin(&record, j) + 16384) % 32768) + 32768*coarse;
+					if((fine >= lowFine) && (fine <= highFine)){
+						printf("%i.%06i,%u,%u,%u,%.6f\n", record.sec, record.usec, coarse, fine,
+							dat_hit_power(&record, j), frequencyOf(fine, center));
+						hitsFound++;
+					}
+				}
+			}
+		}
+		dat_close(&datFile);
+		free(blocks);
+	}
+	gettimeofday(&finished, NULL);
+
+	if(verbose || onlyBuild){
+		fprintf(stderr, "%i files (%llu indexed now, %llu skipped whole), %llu of %llu blocks read, %llu records, %llu hits, %.3f s.\n",
+			numberOfFiles, filesBuilt, filesSkipped, blocksRead, blocksTotal, recordsRead, hitsFound,
+			(finished.tv_sec - started.tv_sec) + (finished.tv_usec - started.tv_usec) / 1000000.0);
+	}
+	return 0;
+}
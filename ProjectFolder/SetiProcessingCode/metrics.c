@@ -0,0 +1,377 @@
+/*
+Receive Metrics v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+See metrics.h.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/sock_diag.h>
+#include "metrics.h"
+
+#ifndef SO_RXQ_OVFL
+#define SO_RXQ_OVFL 40
+#endif
+
+#ifndef SO_MEMINFO
+#define SO_MEMINFO 55
+#endif
+
+#define MX_RESPONSE_SIZE 16384
+
+/* upper edges of the write latency buckets in microseconds */
+static const int latencyEdges[MX_LATENCY_BUCKETS] = {
+	1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 100000
+};
+
+static mxcounters *threads = NULL;
+static pthread_mutex_t registerLock = PTHREAD_MUTEX_INITIALIZER;
+static const seqstats *sequences[MX_MAX_SEQUENCES];
+static int numSequences = 0;
+static int sockets[MX_MAX_SOCKETS];
+static int numSockets = 0;
+static int listener = -1;
+static char socketPath[108] = "";
+static volatile int stopping = 0;
+static pthread_t serverThread;
+static int serving = 0;
+
+mxcounters *mx_register(const char *thread)
+{
+	mxcounters *c;
+
+	c = (mxcounters *)calloc(1, sizeof(mxcounters));
+	if(c == NULL){
+		return NULL;
+	}
+	strncpy(c->thread, thread, sizeof(c->thread)-1);
+	pthread_mutex_lock(&registerLock);
+	c->next = threads;
+	threads = c;
+	pthread_mutex_unlock(&registerLock);
+	return c;
+}
+
+/* The sequence counters are read, not copied, and added up at every scrape */
+void mx_seq(const seqstats *stats)
+{
+	pthread_mutex_lock(&registerLock);
+	if(numSequences < MX_MAX_SEQUENCES){
+		sequences[numSequences++] = stats;
+	}
+	pthread_mutex_unlock(&registerLock);
+}
+
+/* Reports the socket's drops with mx_recv() and its queue depth at every scrape */
+void mx_watch_socket(int sd)
+{
+	int one = 1;
+
+	if(setsockopt(sd, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one)) < 0){
+		printf("Warning: SO_RXQ_OVFL not supported, socket drops will not be reported.\n");
+	}
+	pthread_mutex_lock(&registerLock);
+	if(numSockets < MX_MAX_SOCKETS){
+		sockets[numSockets++] = sd;
+	}
+	pthread_mutex_unlock(&registerLock);
+}
+
+/* Bytes waiting in the watched sockets' receive buffers and the buffers' size; 0 if the kernel won't say */
+static int queue_depth(double *queued, double *limit)
+{
+	uint32_t meminfo[SK_MEMINFO_VARS];
+	socklen_t length;
+	int i, known = 0;
+
+	*queued = 0.0;
+	*limit = 0.0;
+	for(i=0; i<numSockets; i++){
+		length = sizeof(meminfo);
+		if(getsockopt(sockets[i], SOL_SOCKET, SO_MEMINFO, meminfo, &length) < 0){
+			continue;
+		}
+		*queued += meminfo[SK_MEMINFO_RMEM_ALLOC];
+		*limit += meminfo[SK_MEMINFO_RCVBUF];
+		known = 1;
+	}
+	return known;
+}
+
+/* recv() that also picks up the kernel's drop counter for this socket, and the sender if from isn't NULL */
+int mx_recv(int sd, char *msg, int maxBytes, mxcounters *c, struct sockaddr_in *from)
+{
+	struct msghdr header;
+	struct iovec data;
+	struct cmsghdr *cmsg;
+	char control[CMSG_SPACE(sizeof(uint32_t))];
+	uint32_t drops;
+	int numBytes;
+
+	data.iov_base = msg;
+	data.iov_len = maxBytes;
+	memset(&header, 0, sizeof(header));
+	header.msg_iov = &data;
+	if(from != NULL){
+		header.msg_name = from;
+		header.msg_namelen = sizeof(struct sockaddr_in);
+	}
+	header.msg_iovlen = 1;
+	header.msg_control = control;
+	header.msg_controllen = sizeof(control);
+	numBytes = recvmsg(sd, &header, 0);
+	if(numBytes < 0){
+		return numBytes;
+	}
+	for(cmsg = CMSG_FIRSTHDR(&header); cmsg != NULL; cmsg = CMSG_NXTHDR(&header, cmsg)){
+		if((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SO_RXQ_OVFL)){
+			memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+			c->socketDrops = drops;
+		}
+	}
+	c->packets++;
+	c->bytes += numBytes;
+	return numBytes;
+}
+
+void mx_write_done(mxcounters *c, const struct timespec *start)
+{
+	struct timespec now;
+	double seconds;
+	int i, usec;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	seconds = (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+	usec = (int)(seconds * 1e6);
+	for(i=0; (i < MX_LATENCY_BUCKETS) && (usec >= latencyEdges[i]); i++);
+	c->writeBuckets[i]++;
+	c->writeCount++;
+	c->writeSeconds += seconds;
+}
+
+void mx_spectrum(mxcounters *c)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if(c->spectra > 0){
+		c->spectrumPeriod = (now.tv_sec - c->lastSpectrum.tv_sec) + (now.tv_nsec - c->lastSpectrum.tv_nsec) / 1e9;
+	}
+	c->lastSpectrum = now;
+	c->spectra++;
+}
+
+static int metric(char *out, int used, const char *name, const char *type, const char *help, double value)
+{
+	return used + snprintf(out + used, MX_RESPONSE_SIZE - used, "# HELP %s %s\n# TYPE %s %s\n%s %.17g\n",
+		name, help, name, type, name, value);
+}
+
+/* Adds every thread's block up; returns the length of the text */
+static int render(char *out)
+{
+	mxcounters total, *c;
+	seqstats sequence;
+	uint64_t cumulative;
+	double period = 0.0, queued, limit;
+	int used = 0, i, depthKnown;
+
+	memset(&total, 0, sizeof(total));
+	memset(&sequence, 0, sizeof(sequence));
+	pthread_mutex_lock(&registerLock);
+	for(i=0; i<numSequences; i++){
+		seq_add(&sequence, sequences[i]);
+	}
+	for(c = threads; c != NULL; c = c->next){
+		total.packets += c->packets;
+		total.bytes += c->bytes;
+		total.hitsKept += c->hitsKept;
+		total.hitsMasked += c->hitsMasked;
+		total.socketDrops += c->socketDrops;
+		total.rotations += c->rotations;
+		total.spectra += c->spectra;
+		for(i=0; i<=MX_LATENCY_BUCKETS; i++){
+			total.writeBuckets[i] += c->writeBuckets[i];
+		}
+		total.writeCount += c->writeCount;
+		total.writeSeconds += c->writeSeconds;
+		if(c->spectrumPeriod > period){
+			period = c->spectrumPeriod;
+		}
+	}
+	depthKnown = queue_depth(&queued, &limit);
+	pthread_mutex_unlock(&registerLock);
+
+	used = metric(out, used, "seti_receive_packets_total", "counter", "UDP packets received.", total.packets);
+	used = metric(out, used, "seti_receive_bytes_total", "counter", "UDP payload bytes received.", total.bytes);
+	used = metric(out, used, "seti_receive_hits_kept_total", "counter", "Hits written to file.", total.hitsKept);
+	used = metric(out, used, "seti_receive_hits_masked_total", "counter", "Hits dropped by the PFB mask.", total.hitsMasked);
+	used = metric(out, used, "seti_receive_socket_drops_total", "counter", "Packets dropped by the kernel for want of socket buffer (SO_RXQ_OVFL).", total.socketDrops);
+	used = metric(out, used, "seti_receive_file_rotations_total", "counter", "Output files started after the first.", total.rotations);
+	used = metric(out, used, "seti_receive_spectra_total", "counter", "Spectrum boundaries seen.", total.spectra);
+	used = metric(out, used, "seti_receive_spectrum_period_seconds", "gauge", "Time between the last two spectrum boundaries.", period);
+	used = metric(out, used, "seti_receive_spectrum_period_nominal_seconds", "gauge", "Nominal time per spectrum.", MX_NOMINAL_PERIOD);
+	if(depthKnown){
+		used = metric(out, used, "seti_receive_queue_bytes", "gauge", "Bytes waiting in the socket receive buffers, datagram overhead included.", queued);
+		used = metric(out, used, "seti_receive_queue_limit_bytes", "gauge", "Size of the socket receive buffers.", limit);
+	}
+	if(numSequences > 0){
+		used = metric(out, used, "seti_receive_sequence_gaps_total", "counter", "Forward jumps in the PFB bin sequence.", sequence.gaps);
+		used = metric(out, used, "seti_receive_bins_missing_total", "counter", "PFB bins missing from finalized spectra.", sequence.binsMissing);
+		used = metric(out, used, "seti_receive_bins_late_total", "counter", "PFB bins that arrived after their spectrum was finalized.", sequence.late);
+		used = metric(out, used, "seti_receive_fifo_overruns_total", "counter", "Packets with BEE2 FIFO overrun bits set.", sequence.fifoOverrun);
+	}
+
+	used += snprintf(out + used, MX_RESPONSE_SIZE - used,
+		"# HELP seti_receive_write_seconds Time to hand one packet record to the file writer.\n"
+		"# TYPE seti_receive_write_seconds histogram\n");
+	cumulative = 0;
+	for(i=0; i<MX_LATENCY_BUCKETS; i++){
+		cumulative += total.writeBuckets[i];
+		used += snprintf(out + used, MX_RESPONSE_SIZE - used, "seti_receive_write_seconds_bucket{le=\"%g\"} %llu\n",
+			latencyEdges[i] / 1e6, (unsigned long long)cumulative);
+	}
+	cumulative += total.writeBuckets[MX_LATENCY_BUCKETS];
+	used += snprintf(out + used, MX_RESPONSE_SIZE - used,
+		"seti_receive_write_seconds_bucket{le=\"+Inf\"} %llu\n"
+		"seti_receive_write_seconds_sum %.9f\n"
+		"seti_receive_write_seconds_count %llu\n",
+		(unsigned long long)cumulative, total.writeSeconds, (unsigned long long)total.writeCount);
+	return used;
+}
+
+static void serve(int client)
+{
+	char request[1024];
+	char *body, header[128];
+	struct timeval timeout;
+	int length, headerLength;
+
+	/* the request itself does not matter, every path gets the metrics */
+	timeout.tv_sec = 1;
+	timeout.tv_usec = 0;
+	setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	recv(client, request, sizeof(request), 0);
+
+	body = (char *)malloc(MX_RESPONSE_SIZE);
+	if(body == NULL){
+		return;
+	}
+	length = render(body);
+	if(length >= MX_RESPONSE_SIZE){
+		length = MX_RESPONSE_SIZE - 1;
+	}
+	headerLength = snprintf(header, sizeof(header),
+		"HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %i\r\n\r\n", length);
+	send(client, header, headerLength, MSG_NOSIGNAL);
+	send(client, body, length, MSG_NOSIGNAL);
+	free(body);
+}
+
+static void *server_thread(void *arg)
+{
+	struct pollfd waiting;
+	int client;
+	sigset_t all;
+
+	/* signal handlers run on the receive thread */
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, NULL);
+
+	waiting.fd = listener;
+	waiting.events = POLLIN;
+	while(!stopping){
+		if(poll(&waiting, 1, 200) <= 0){
+			continue;
+		}
+		client = accept(listener, NULL, NULL);
+		if(client >= 0){
+			serve(client);
+			close(client);
+		}
+	}
+	return NULL;
+}
+
+/* <where> is a TCP port number on 127.0.0.1 or the path of a Unix socket; returns 0 on failure */
+int mx_start(const char *where)
+{
+	struct sockaddr_in inetAddr;
+	struct sockaddr_un unixAddr;
+	int port, one = 1;
+
+	port = atoi(where);
+	if(port > 0){
+		listener = socket(AF_INET, SOCK_STREAM, 0);
+		if(listener < 0){
+			printf("Metrics: cannot open socket\n");
+			return 0;
+		}
+		setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		memset(&inetAddr, 0, sizeof(inetAddr));
+		inetAddr.sin_family = AF_INET;
+		inetAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		inetAddr.sin_port = htons(port);
+		if(bind(listener, (struct sockaddr *) &inetAddr, sizeof(inetAddr)) < 0){
+			printf("Metrics: cannot bind port number %d\n", port);
+			close(listener);
+			listener = -1;
+			return 0;
+		}
+	}
+	else{
+		listener = socket(AF_UNIX, SOCK_STREAM, 0);
+		if(listener < 0){
+			printf("Metrics: cannot open socket\n");
+			return 0;
+		}
+		memset(&unixAddr, 0, sizeof(unixAddr));
+		unixAddr.sun_family = AF_UNIX;
+		strncpy(unixAddr.sun_path, where, sizeof(unixAddr.sun_path)-1);
+		unlink(unixAddr.sun_path);
+		if(bind(listener, (struct sockaddr *) &unixAddr, sizeof(unixAddr)) < 0){
+			printf("Metrics: cannot bind %s\n", where);
+			close(listener);
+			listener = -1;
+			return 0;
+		}
+		strcpy(socketPath, unixAddr.sun_path);
+	}
+	listen(listener, 8);
+	if(pthread_create(&serverThread, NULL, server_thread, NULL) != 0){
+		printf("Metrics: could not start server thread.\n");
+		close(listener);
+		listener = -1;
+		return 0;
+	}
+	serving = 1;
+	return 1;
+}
+
+void mx_stop()
+{
+	if(!serving){
+		return;
+	}
+	stopping = 1;
+	pthread_join(serverThread, NULL);
+	serving = 0;
+	close(listener);
+	listener = -1;
+	if(socketPath[0] != '\0'){
+		unlink(socketPath);
+	}
+}
@@ -0,0 +1,63 @@
+/*
+Receive Metrics v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+Serves the receiver's counters in the Prometheus text format over HTTP, either
+on a local TCP port (127.0.0.1) or on a Unix socket:
+
+curl http://127.0.0.1:9101/metrics
+curl --unix-socket /tmp/receive.sock http://localhost/metrics
+
+Every receiving thread registers its own mxcounters and is the only one to write
+it, with plain increments.  Nothing is shared or locked on the hot path; the
+server thread adds the blocks of all threads up when it is scraped, so the
+numbers may be a packet or so behind.  The same goes for the sequence
+counters: each thread that tracks its own sequence hands them to mx_seq().
+
+The receive queue depth is a gauge read from the kernel at scrape time: the
+bytes waiting in the buffers of every socket given to mx_watch_socket()
+(SO_MEMINFO, datagram overhead included) and what those buffers may hold.
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <time.h>
+#include <netinet/in.h>
+#include "seqtrack.h"
+
+#define MX_LATENCY_BUCKETS 14
+#define MX_NOMINAL_PERIOD  0.67        /* seconds per spectrum at 200 MHz */
+#define MX_MAX_SEQUENCES   64
+#define MX_MAX_SOCKETS     64
+
+typedef struct mxcounters_s {
+	char thread[32];
+	uint64_t packets;
+	uint64_t bytes;
+	uint64_t hitsKept;
+	uint64_t hitsMasked;
+	uint64_t socketDrops;              /* SO_RXQ_OVFL, as last reported by the kernel */
+	uint64_t rotations;
+	uint64_t spectra;
+	uint64_t writeBuckets[MX_LATENCY_BUCKETS + 1];   /* last one is +Inf */
+	uint64_t writeCount;
+	double writeSeconds;
+	double spectrumPeriod;             /* seconds between the last two spectrum boundaries */
+	struct timespec lastSpectrum;
+	struct mxcounters_s *next;
+} mxcounters;
+
+int mx_start(const char *where);
+mxcounters *mx_register(const char *thread);
+void mx_seq(const seqstats *stats);
+void mx_watch_socket(int sd);
+int mx_recv(int sd, char *msg, int maxBytes, mxcounters *c, struct sockaddr_in *from);
+void mx_write_done(mxcounters *c, const struct timespec *start);
+void mx_spectrum(mxcounters *c);
+void mx_stop();
+
+#endif
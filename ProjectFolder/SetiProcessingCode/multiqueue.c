@@ -0,0 +1,374 @@
+/*
+Multi-Queue Receive v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+See multiqueue.h.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/timex.h>
+#include <time.h>
+#include <netinet/in.h>
+#include <linux/filter.h>
+#include "multiqueue.h"
+#include "rotate.h"
+#include "pktwrite.h"
+#include "metrics.h"
+
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif
+
+typedef struct mqworker_s {
+	int index;
+	int sd;
+	int cpu;
+	pthread_t thread;
+	rotator files;
+	int filesOpen;
+	unsigned long long packets;
+	unsigned long long bytes;
+	struct sockaddr_in board;      /* the sender this queue serves */
+	int hasBoard;
+	unsigned long long foreign;    /* packets from other senders, not written */
+	seqtrack tracker;              /* the board's sequence, only this queue's thread writes it */
+} mqworker;
+
+static mqconfig config;
+static mqworker workers[MQ_MAX_QUEUES];
+static int numWorkers = 0;
+static volatile int stopping = 0;
+static volatile int running = 0;
+static volatile int finished = 0;
+
+static unsigned int swap32(unsigned int x)
+{
+	return ((x & 0x000000FF) << 24) | ((x & 0x0000FF00) << 8) |
+	       ((x & 0x00FF0000) >> 8)  | ((x & 0xFF000000) >> 24);
+}
+
+static int open_socket(int index)
+{
+	struct sockaddr_in servAddr;
+	struct timeval timeout;
+	int sd, one = 1;
+
+	sd = socket(AF_INET, SOCK_DGRAM, 0);
+	if(sd < 0){
+		printf("Queue %i: cannot open socket\n", index);
+		return -1;
+	}
+	if(setsockopt(sd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0){
+		printf("Queue %i: SO_REUSEPORT not supported\n", index);
+		close(sd);
+		return -1;
+	}
+	/* wake up now and then to notice mq_stop() */
+	timeout.tv_sec = 0;
+	timeout.tv_usec = 100000;
+	setsockopt(sd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	memset(&servAddr, 0, sizeof(servAddr));
+	servAddr.sin_family = AF_INET;
+	if(strcmp(config.serverIP, "ANY") == 0){
+		servAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+	}
+	else{
+		servAddr.sin_addr.s_addr = inet_addr(config.serverIP);
+	}
+	servAddr.sin_port = htons(config.port);
+	if(bind(sd, (struct sockaddr *) &servAddr, sizeof(servAddr)) < 0){
+		printf("Queue %i: cannot bind port number %d on network device %s\n", index, config.port, config.serverIP);
+		close(sd);
+		return -1;
+	}
+	return sd;
+}
+
+/* Returns 1 if the packet is from the queue's board, which is the first sender it hears */
+static int from_board(mqworker *w, const struct sockaddr_in *from)
+{
+	if(!w->hasBoard){
+		w->board = *from;
+		w->hasBoard = 1;
+		if(config.verbose){
+			printf("Queue %i: serving %s:%i\n", w->index, inet_ntoa(from->sin_addr), ntohs(from->sin_port));
+		}
+		return 1;
+	}
+	if((from->sin_addr.s_addr == w->board.sin_addr.s_addr) && (from->sin_port == w->board.sin_port)){
+		return 1;
+	}
+	if(w->foreign++ == 0){
+		printf("Warning: queue %i serves %s:%i, ", w->index, inet_ntoa(w->board.sin_addr), ntohs(w->board.sin_port));
+		printf("packets from %s:%i on it are not written.  Use more queues or -c for several boards.\n",
+			inet_ntoa(from->sin_addr), ntohs(from->sin_port));
+	}
+	return 0;
+}
+
+/* Socket (receiving CPU % queues) takes the packet; sockets are numbered in bind order */
+static int attach_steering(int sd, int queues)
+{
+	struct sock_filter code[] = {
+		{ BPF_LD  | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_CPU },
+		{ BPF_ALU | BPF_MOD | BPF_K, 0, 0, queues },
+		{ BPF_RET | BPF_A, 0, 0, 0 },
+	};
+	struct sock_fprog program;
+
+	program.len = sizeof(code) / sizeof(code[0]);
+	program.filter = code;
+	return setsockopt(sd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program)) == 0;
+}
+
+static void *mq_thread(void *arg)
+{
+	mqworker *w = (mqworker *)arg;
+	cpu_set_t cpus;
+	char msg[PKT_MAX_MSG];
+	char prefix[ROT_NAME_SIZE];
+	struct ntptimeval times;
+	struct sockaddr_in from;
+	socklen_t fromLength;
+	unsigned int currentbin, errorCode;
+	int numBytes, recordBytes, lastPFBbin = -1;
+	int numberOfSpectra = 0, filesWritten = 0;
+	FILE *fp;
+	mxcounters *counters = NULL;
+	struct timespec writeStart;
+
+	CPU_ZERO(&cpus);
+	CPU_SET(w->cpu, &cpus);
+	if(pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0){
+		printf("Queue %i: could not pin to CPU %i\n", w->index, w->cpu);
+	}
+
+	snprintf(prefix, ROT_NAME_SIZE, "%sq%i", config.prefix, w->index);
+	fp = rot_start(&w->files, prefix, 1, config.filesToWrite, (long long)config.spectraPerFile * 4096 * 24 / config.queues);
+	if(fp == NULL){
+		__sync_fetch_and_sub(&running, 1);
+		return NULL;
+	}
+	w->filesOpen = 1;
+	if(config.metrics){
+		snprintf(prefix, ROT_NAME_SIZE, "queue%i", w->index);
+		counters = mx_register(prefix);
+		mx_watch_socket(w->sd);
+		mx_seq(&w->tracker.stats);
+	}
+
+	while(!stopping){
+		if(counters != NULL){
+			numBytes = mx_recv(w->sd, msg, PKT_MAX_MSG, counters, &from);
+		}
+		else{
+			fromLength = sizeof(from);
+			numBytes = recvfrom(w->sd, msg, PKT_MAX_MSG, 0, (struct sockaddr *) &from, &fromLength);
+		}
+		if(numBytes < 0){
+			if((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)){
+				continue;
+			}
+			printf("Queue %i: receive failed\n", w->index);
+			break;
+		}
+		ntp_gettime(&times);
+		w->packets++;
+		if(!from_board(w, &from)){
+			continue;
+		}
+
+		if(numBytes >= 12){
+			memcpy(&currentbin, msg, 4);
+			memcpy(&errorCode, msg + 8, 4);
+			if(config.swap){
+				currentbin = swap32(currentbin);
+				errorCode = swap32(errorCode);
+			}
+			if(currentbin < 4096){
+				currentbin = (currentbin + 2048) % 4096;
+			}
+			if(seq_track(&w->tracker, currentbin, errorCode) && (counters != NULL)){
+				mx_spectrum(counters);
+			}
+
+			/* the queue's files rotate on its board's spectrum boundaries */
+			if((signed int)currentbin <= lastPFBbin){
+				numberOfSpectra++;
+				if(numberOfSpectra >= config.spectraPerFile){
+					numberOfSpectra = 0;
+					filesWritten++;
+					if(filesWritten >= config.filesToWrite){
+						break;
+					}
+					if(config.verbose){
+						printf("Queue %i: %i files written\n", w->index, filesWritten);
+					}
+					fp = rot_swap(&w->files);
+					if(fp == NULL){
+						break;
+					}
+					if(counters != NULL){
+						counters->rotations++;
+					}
+				}
+			}
+			lastPFBbin = currentbin;
+		}
+		else{
+			/* recorded like receive records it, with what is missing of the header zeroed */
+			memset(msg + numBytes, 0, 12 - numBytes);
+		}
+
+		if(counters != NULL){
+			clock_gettime(CLOCK_MONOTONIC, &writeStart);
+		}
+		recordBytes = pkt_write(fp, msg, numBytes, times.time.tv_sec, times.time.tv_usec,
+			config.mask, config.maskSize, config.swap);
+		w->bytes += recordBytes;
+		if((counters != NULL) && (numBytes >= 12)){
+			mx_write_done(counters, &writeStart);
+			counters->hitsKept += (recordBytes - 24) / 8;
+			counters->hitsMasked += (numBytes - 12) / 8 - (recordBytes - 24) / 8;
+		}
+	}
+	__sync_fetch_and_sub(&running, 1);
+	return NULL;
+}
+
+/* All the queues' sequence counters, a little stale while they run */
+static void sum_stats(seqstats *total)
+{
+	int i;
+
+	memset(total, 0, sizeof(seqstats));
+	for(i=0; i<numWorkers; i++){
+		seq_add(total, &workers[i].tracker.stats);
+	}
+}
+
+/* Waits for the receive threads to leave, then closes their files and sockets (once) */
+static void finish()
+{
+	seqstats total;
+	time_t nextStatus = time(NULL) + config.statusInterval;
+	int i;
+
+	while(running > 0){
+		if((config.stop != NULL) && *config.stop){
+			stopping = 1;
+		}
+		if(config.statusInterval && (time(NULL) >= nextStatus)){
+			sum_stats(&total);
+			seq_print(stderr, &total);
+			nextStatus = time(NULL) + config.statusInterval;
+		}
+		usleep(10000);
+	}
+	if(__sync_lock_test_and_set(&finished, 1)){
+		return;
+	}
+	for(i=0; i<numWorkers; i++){
+		if(workers[i].filesOpen){
+			rot_stop(&workers[i].files);
+			workers[i].filesOpen = 0;
+		}
+		close(workers[i].sd);
+		seq_finish(&workers[i].tracker);
+		if(config.tracker != NULL){
+			seq_add(&config.tracker->stats, &workers[i].tracker.stats);
+		}
+		if(config.verbose){
+			printf("Queue %i: %llu packets, %llu bytes written\n", i, workers[i].packets, workers[i].bytes);
+		}
+		if(workers[i].foreign > 0){
+			printf("Queue %i: %llu packets from other boards not written\n", i, workers[i].foreign);
+		}
+	}
+}
+
+/* Runs until every shard has written its files, *stop is set or mq_stop() is called.  Returns 0 if setup failed. */
+int mq_run(const mqconfig *c)
+{
+	int i, ncpus;
+	pthread_attr_t attributes;
+	sigset_t all, previous;
+
+	config = *c;
+	if((config.queues < 1) || (config.queues > MQ_MAX_QUEUES)){
+		printf("Number of queues must be between 1 and %i.\n", MQ_MAX_QUEUES);
+		return 0;
+	}
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if(ncpus < 1){
+		ncpus = 1;
+	}
+
+	/* bind every socket before any thread starts so the group is complete */
+	for(i=0; i<config.queues; i++){
+		memset(&workers[i], 0, sizeof(mqworker));
+		workers[i].index = i;
+		workers[i].cpu = i % ncpus;
+		workers[i].sd = open_socket(i);
+		seq_init(&workers[i].tracker);
+		if(workers[i].sd < 0){
+			while(--i >= 0){
+				close(workers[i].sd);
+			}
+			return 0;
+		}
+	}
+	numWorkers = config.queues;
+	if(config.steer){
+		if(attach_steering(workers[0].sd, config.queues)){
+			if(config.verbose){
+				printf("Steering packets to socket (CPU %% %i).\n", config.queues);
+			}
+		}
+		else{
+			printf("Warning: could not attach the CPU steering program, using the kernel's hash.\n");
+		}
+	}
+
+	/* signals stay with the main thread, the workers inherit a blocked mask */
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &previous);
+	pthread_attr_init(&attributes);
+	pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+	for(i=0; i<numWorkers; i++){
+		__sync_fetch_and_add(&running, 1);
+		if(pthread_create(&workers[i].thread, &attributes, mq_thread, &workers[i]) != 0){
+			__sync_fetch_and_sub(&running, 1);
+			printf("Queue %i: could not start thread\n", i);
+		}
+	}
+	pthread_attr_destroy(&attributes);
+	pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+	finish();
+	return 1;
+}
+
+/* Stops the receive threads and closes their files; for quit(), not for a signal handler */
+void mq_stop()
+{
+	if(numWorkers == 0){
+		return;
+	}
+	stopping = 1;
+	finish();
+}
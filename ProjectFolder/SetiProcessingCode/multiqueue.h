@@ -0,0 +1,61 @@
+/*
+Multi-Queue Receive v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+Receives on several UDP sockets bound to the same address and port with
+SO_REUSEPORT, one thread per socket, each pinned to its own CPU.  The kernel
+spreads flows across the sockets by hash or, with steering on, a small classic
+BPF program picks socket (receiving CPU % queues) so a packet is handled on the
+CPU whose receive queue took it.
+
+Every thread writes its own shard of files, <prefix>q<k>_<N>.dat, in the usual
+.dat format with its own background rotation, so each shard can be read by
+analyze on its own (analyze <prefix>q<k>).
+
+A queue serves one board.  A board's packets are one flow, so they all reach
+one queue, and the queue's files, spectrum count and sequence tracker follow
+that board's PFB bins alone; -q spreads boards across CPUs, not one board's
+stream.  The first sender a queue hears is its board.  Should the hash or the
+steering put a second board on the same queue, its packets are counted and
+left out rather than interleaved with the first board's bins, and a warning
+says so once; give such boards more queues, or their own ports with -c.
+
+Every thread tracks its board's PFB bin sequence on its own, with no lock.
+The counters of all the queues are added up for the status lines, for metrics
+and, once the queues stop, into the caller's tracker.  Datagrams too short
+for a header are written as a record, as receive does, but are not tracked
+and do not count towards a spectrum boundary.
+*/
+
+#ifndef MULTIQUEUE_H
+#define MULTIQUEUE_H
+
+#include <signal.h>
+#include "seqtrack.h"
+
+#define MQ_MAX_QUEUES 64
+
+typedef struct mqconfig_s {
+	const char *serverIP;          /* "ANY" for every interface */
+	int port;
+	int queues;
+	int steer;                     /* attach the CPU steering BPF program */
+	const char *prefix;
+	int spectraPerFile;
+	int filesToWrite;
+	const int *mask;
+	int maskSize;
+	int swap;
+	int verbose;
+	int statusInterval;            /* seconds between status lines, 0 for none */
+	seqtrack *tracker;             /* gets the sum of the queues' counters at the end; may be NULL */
+	int metrics;                   /* each thread registers its counters with metrics.c */
+	volatile sig_atomic_t *stop;   /* set by a signal handler to stop the queues; may be NULL */
+} mqconfig;
+
+int mq_run(const mqconfig *config);
+void mq_stop();
+
+#endif
@@ -0,0 +1,611 @@
+/*
+Multi-Stream Receive v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+See multistream.h.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/time.h>
+#include <sys/timex.h>
+#include <netinet/in.h>
+#include "multistream.h"
+#include "rotate.h"
+#include "pktwrite.h"
+#include "specpool.h"
+
+#define MS_TIMER_ID        MS_MAX_STREAMS
+#define MS_BURST           64          /* packets taken from one socket per wakeup */
+#define MS_RECORD_HEADER   12          /* numBytes, sec, usec in front of each packet */
+#define MS_SLOT(numBytes)  (MS_RECORD_HEADER + ((((numBytes) < 12 ? 12 : (numBytes)) + 3) & ~3))
+
+typedef struct msblock_s {
+	struct msblock_s *next;
+	int stream;
+	int used;
+	char data[MS_BLOCK_SIZE];
+} msblock;
+
+typedef struct msstream_s {
+	char serverIP[64];
+	int port;
+	char prefix[MS_NAME_SIZE];
+	int *mask;
+	int sd;
+	msblock *filling;              /* owned by the event loop */
+	seqtrack tracker;              /* owned by the event loop */
+	unsigned long long packets;
+	unsigned long long dropped;    /* no free block */
+	/* owned by the stream's writer */
+	rotator files;
+	int filesOpen;
+	FILE *fp;
+	int lastPFBbin;
+	int numberOfSpectra;
+	int filesWritten;
+	unsigned long long bytes;
+	volatile int done;
+	int active;
+} msstream;
+
+typedef struct mswriter_s {
+	pthread_t thread;
+	int started;
+	msblock *head;
+	msblock *tail;
+	int stop;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+} mswriter;
+
+static msconfig config;
+static msstream streams[MS_MAX_STREAMS];
+static int numStreams = 0;
+static mswriter writers[MS_MAX_WRITERS];
+static int numWriters = 2;
+static int *allBins = NULL;        /* mask for streams without a mask file */
+
+static msblock *pool = NULL;
+static size_t poolBytes = 0;
+static int poolHuge = 0;
+static msblock *freeBlocks = NULL;
+static pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;
+
+static int epfd = -1;
+static int tfd = -1;
+static volatile int stopping = 0;
+static volatile int finished = 0;
+
+static unsigned int swap32(unsigned int x)
+{
+	return ((x & 0x000000FF) << 24) | ((x & 0x0000FF00) << 8) |
+	       ((x & 0x00FF0000) >> 8)  | ((x & 0xFF000000) >> 24);
+}
+
+static msblock *get_block()
+{
+	msblock *b;
+
+	pthread_mutex_lock(&poolLock);
+	b = freeBlocks;
+	if(b != NULL){
+		freeBlocks = b->next;
+	}
+	pthread_mutex_unlock(&poolLock);
+	return b;
+}
+
+static void put_block(msblock *b)
+{
+	pthread_mutex_lock(&poolLock);
+	b->next = freeBlocks;
+	freeBlocks = b;
+	pthread_mutex_unlock(&poolLock);
+}
+
+/* Queues a block on the writer that owns its stream */
+static void submit(msblock *b)
+{
+	mswriter *w = &writers[b->stream % numWriters];
+
+	b->next = NULL;
+	pthread_mutex_lock(&w->lock);
+	if(w->tail != NULL){
+		w->tail->next = b;
+	}
+	else{
+		w->head = b;
+	}
+	w->tail = b;
+	pthread_cond_signal(&w->cond);
+	pthread_mutex_unlock(&w->lock);
+}
+
+static int *load_mask(const char *path, int maskSize)
+{
+	FILE *maskFile;
+	int *mask;
+	int i, j;
+
+	maskFile = fopen(path, "rt");
+	if(maskFile == NULL){
+		printf("Could not find PFB mask file %s.\n", path);
+		return NULL;
+	}
+	mask = (int *)malloc(maskSize * sizeof(int));
+	if(mask == NULL){
+		fclose(maskFile);
+		return NULL;
+	}
+	for(i=0; i<maskSize; i++){
+		if(fscanf(maskFile, "%i", &j) != 1){
+			j = 1;
+		}
+		mask[i] = j;
+	}
+	fclose(maskFile);
+	return mask;
+}
+
+/* Reads the stream list; returns the number of streams, 0 on error */
+int ms_load(const char *path, int maskSize)
+{
+	FILE *in;
+	char line[1024];
+	char ip[64], prefix[MS_NAME_SIZE], maskPath[MS_NAME_SIZE];
+	int port, fields, lineNumber = 0, i;
+	msstream *s;
+
+	in = fopen(path, "rt");
+	if(in == NULL){
+		printf("Could not open stream configuration %s.\n", path);
+		return 0;
+	}
+	allBins = (int *)malloc(maskSize * sizeof(int));
+	if(allBins == NULL){
+		fclose(in);
+		return 0;
+	}
+	for(i=0; i<maskSize; i++){
+		allBins[i] = 1;
+	}
+
+	numStreams = 0;
+	while(fgets(line, sizeof(line), in) != NULL){
+		lineNumber++;
+		if((sscanf(line, " %63s", ip) != 1) || (ip[0] == '#')){
+			continue;
+		}
+		if(strcmp(ip, "writers") == 0){
+			if((sscanf(line, " writers %i", &numWriters) != 1) || (numWriters < 1) || (numWriters > MS_MAX_WRITERS)){
+				printf("%s:%i: writers must be between 1 and %i.\n", path, lineNumber, MS_MAX_WRITERS);
+				fclose(in);
+				return 0;
+			}
+			continue;
+		}
+		fields = sscanf(line, " %63s %i %255s %255s", ip, &port, prefix, maskPath);
+		if(fields < 3){
+			printf("%s:%i: expected <ip address> <port> <file prefix> [PFB mask file].\n", path, lineNumber);
+			fclose(in);
+			return 0;
+		}
+		if(numStreams >= MS_MAX_STREAMS){
+			printf("%s:%i: at most %i streams are supported.\n", path, lineNumber, MS_MAX_STREAMS);
+			fclose(in);
+			return 0;
+		}
+		s = &streams[numStreams];
+		memset(s, 0, sizeof(msstream));
+		strcpy(s->serverIP, ip);
+		s->port = port;
+		strcpy(s->prefix, prefix);
+		s->sd = -1;
+		s->mask = allBins;
+		if(fields == 4){
+			s->mask = load_mask(maskPath, maskSize);
+			if(s->mask == NULL){
+				s->mask = allBins;
+			}
+		}
+		numStreams++;
+	}
+	fclose(in);
+	if(numStreams == 0){
+		printf("No streams in %s.\n", path);
+	}
+	return numStreams;
+}
+
+static int open_socket(msstream *s)
+{
+	struct sockaddr_in servAddr;
+	int sd, size = 8 * 1024 * 1024;
+
+	sd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+	if(sd < 0){
+		printf("%s: cannot open socket\n", s->prefix);
+		return -1;
+	}
+	/* one loop serves every stream, give each some slack in the kernel */
+	setsockopt(sd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+	memset(&servAddr, 0, sizeof(servAddr));
+	servAddr.sin_family = AF_INET;
+	if(strcmp(s->serverIP, "ANY") == 0){
+		servAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+	}
+	else{
+		servAddr.sin_addr.s_addr = inet_addr(s->serverIP);
+	}
+	servAddr.sin_port = htons(s->port);
+	if(bind(sd, (struct sockaddr *) &servAddr, sizeof(servAddr)) < 0){
+		printf("%s: cannot bind port number %d on network device %s\n", s->prefix, s->port, s->serverIP);
+		close(sd);
+		return -1;
+	}
+	return sd;
+}
+
+/* Turns the packets of one block into .dat records of its stream */
+static void write_block(msblock *b)
+{
+	msstream *s = &streams[b->stream];
+	int offset = 0, header[3];
+	unsigned int currentbin;
+	const char *msg;
+
+	while((offset < b->used) && !s->done){
+		memcpy(header, b->data + offset, MS_RECORD_HEADER);
+		msg = b->data + offset + MS_RECORD_HEADER;
+		offset += MS_SLOT(header[0]);
+
+		if(header[0] < 12){
+			/* too short for a header: written, but no spectrum boundary */
+			s->bytes += pkt_write(s->fp, msg, header[0], header[1], header[2],
+				s->mask, config.maskSize, config.swap);
+			continue;
+		}
+		memcpy(&currentbin, msg, 4);
+		if(config.swap){
+			currentbin = swap32(currentbin);
+		}
+		if(currentbin < 4096){
+			currentbin = (currentbin + 2048) % 4096;
+		}
+		if((signed int)currentbin <= s->lastPFBbin){
+			s->numberOfSpectra++;
+			if(s->numberOfSpectra >= config.spectraPerFile){
+				s->numberOfSpectra = 0;
+				s->filesWritten++;
+				if(s->filesWritten >= config.filesToWrite){
+					s->done = 1;
+					break;
+				}
+				if(config.verbose){
+					printf("%s: %i files written\n", s->prefix, s->filesWritten);
+				}
+				s->fp = rot_swap(&s->files);
+				if(s->fp == NULL){
+					s->done = 1;
+					break;
+				}
+			}
+		}
+		s->lastPFBbin = currentbin;
+		s->bytes += pkt_write(s->fp, msg, header[0], header[1], header[2],
+			s->mask, config.maskSize, config.swap);
+	}
+}
+
+static void *writer_thread(void *arg)
+{
+	mswriter *w = (mswriter *)arg;
+	msblock *b;
+
+	pthread_mutex_lock(&w->lock);
+	while(1){
+		if(w->head != NULL){
+			b = w->head;
+			w->head = b->next;
+			if(w->head == NULL){
+				w->tail = NULL;
+			}
+			pthread_mutex_unlock(&w->lock);
+			write_block(b);
+			put_block(b);
+			pthread_mutex_lock(&w->lock);
+		}
+		else if(w->stop){
+			break;
+		}
+		else{
+			pthread_cond_wait(&w->cond, &w->lock);
+		}
+	}
+	pthread_mutex_unlock(&w->lock);
+	return NULL;
+}
+
+/* Drains one socket; a packet with no block to go into is dropped */
+static void receive_stream(int index)
+{
+	msstream *s = &streams[index];
+	struct ntptimeval times;
+	char discard[PKT_MAX_MSG];
+	unsigned int seqbin, seqerror;
+	int numBytes, burst, header[3];
+	char *slot;
+
+	for(burst=0; burst<MS_BURST; burst++){
+		if((s->filling != NULL) && (s->filling->used + MS_RECORD_HEADER + PKT_MAX_MSG > MS_BLOCK_SIZE)){
+			submit(s->filling);
+			s->filling = NULL;
+		}
+		if((s->filling == NULL) && !s->done){
+			s->filling = get_block();
+			if(s->filling != NULL){
+				s->filling->stream = index;
+				s->filling->used = 0;
+			}
+		}
+		if(s->filling != NULL){
+			slot = s->filling->data + s->filling->used;
+			numBytes = recv(s->sd, slot + MS_RECORD_HEADER, PKT_MAX_MSG, 0);
+		}
+		else{
+			slot = NULL;
+			numBytes = recv(s->sd, discard, PKT_MAX_MSG, 0);
+		}
+		if(numBytes < 0){
+			if((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)){
+				printf("%s: receive failed\n", s->prefix);
+			}
+			return;
+		}
+		s->packets++;
+		if(s->done){
+			continue;
+		}
+		if(slot == NULL){
+			s->dropped++;
+			continue;
+		}
+
+		ntp_gettime(&times);
+		header[0] = numBytes;
+		header[1] = times.time.tv_sec;
+		header[2] = times.time.tv_usec;
+		memcpy(slot, header, MS_RECORD_HEADER);
+		s->filling->used += MS_SLOT(numBytes);
+		if(numBytes < 12){
+			/* recorded like receive records it, with what is missing of the header zeroed */
+			memset(slot + MS_RECORD_HEADER + numBytes, 0, 12 - numBytes);
+			continue;
+		}
+
+		memcpy(&seqbin, slot + MS_RECORD_HEADER, 4);
+		memcpy(&seqerror, slot + MS_RECORD_HEADER + 8, 4);
+		if(config.swap){
+			seqbin = swap32(seqbin);
+			seqerror = swap32(seqerror);
+		}
+		if(seqbin < 4096){
+			seqbin = (seqbin + 2048) % 4096;
+		}
+		seq_track(&s->tracker, seqbin, seqerror);
+	}
+}
+
+static void print_status(FILE *out)
+{
+	int i;
+
+	for(i=0; i<numStreams; i++){
+		fprintf(out, "%s (%s:%i): %llu packets, %llu dropped for want of buffers, %llu bytes written; ",
+			streams[i].prefix, streams[i].serverIP, streams[i].port,
+			streams[i].packets, streams[i].dropped, streams[i].bytes);
+		seq_print(out, &streams[i].tracker.stats);
+	}
+}
+
+/* Writes out what is buffered, stops the writers and closes every file (once) */
+static void finish()
+{
+	int i;
+
+	if(__sync_lock_test_and_set(&finished, 1)){
+		return;
+	}
+	for(i=0; i<numStreams; i++){
+		if(streams[i].filling != NULL){
+			if(streams[i].filling->used > 0){
+				submit(streams[i].filling);
+			}
+			else{
+				put_block(streams[i].filling);
+			}
+			streams[i].filling = NULL;
+		}
+	}
+	for(i=0; i<numWriters; i++){
+		if(writers[i].started){
+			pthread_mutex_lock(&writers[i].lock);
+			writers[i].stop = 1;
+			pthread_cond_signal(&writers[i].cond);
+			pthread_mutex_unlock(&writers[i].lock);
+			pthread_join(writers[i].thread, NULL);
+			writers[i].started = 0;
+		}
+	}
+	for(i=0; i<numStreams; i++){
+		if(streams[i].filesOpen){
+			rot_stop(&streams[i].files);
+			streams[i].filesOpen = 0;
+		}
+		if(streams[i].sd >= 0){
+			close(streams[i].sd);
+			streams[i].sd = -1;
+		}
+		seq_finish(&streams[i].tracker);
+	}
+	if(tfd >= 0){
+		close(tfd);
+	}
+	if(epfd >= 0){
+		close(epfd);
+	}
+	fprintf(stderr, "Final counts:\n");
+	print_status(stderr);
+}
+
+/* Serves every stream until each has written its files, *stop is set or ms_stop() is called.  Returns 0 if setup failed. */
+int ms_run(const msconfig *c)
+{
+	struct epoll_event event, events[MS_MAX_STREAMS + 1];
+	struct itimerspec tick;
+	unsigned long long expirations;
+	sigset_t all, previous;
+	time_t nextStatus;
+	int i, j, n, active;
+
+	config = *c;
+	if(numWriters > numStreams){
+		numWriters = numStreams;
+	}
+
+	/* packet blocks on huge pages when there are any, 64 MB would otherwise take 16384 TLB entries */
+	poolBytes = (size_t)MS_POOL_BLOCKS * sizeof(msblock);
+	pool = (msblock *)spec_alloc(&poolBytes, &poolHuge);
+	if(pool == NULL){
+		printf("Out of memory.\n");
+		return 0;
+	}
+	for(i=0; i<MS_POOL_BLOCKS; i++){
+		put_block(&pool[i]);
+	}
+
+	epfd = epoll_create1(0);
+	tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+	if((epfd < 0) || (tfd < 0)){
+		printf("Could not create the event loop.\n");
+		return 0;
+	}
+	tick.it_interval.tv_sec = 1;
+	tick.it_interval.tv_nsec = 0;
+	tick.it_value = tick.it_interval;
+	timerfd_settime(tfd, 0, &tick, NULL);
+	event.events = EPOLLIN;
+	event.data.u32 = MS_TIMER_ID;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, tfd, &event);
+
+	for(i=0; i<numStreams; i++){
+		streams[i].sd = open_socket(&streams[i]);
+		if(streams[i].sd < 0){
+			return 0;
+		}
+		seq_init(&streams[i].tracker);
+		streams[i].lastPFBbin = -1;
+		streams[i].fp = rot_start(&streams[i].files, streams[i].prefix, 1, config.filesToWrite,
+			(long long)config.spectraPerFile * 4096 * 24);
+		if(streams[i].fp == NULL){
+			return 0;
+		}
+		streams[i].filesOpen = 1;
+		streams[i].active = 1;
+		event.events = EPOLLIN;
+		event.data.u32 = i;
+		epoll_ctl(epfd, EPOLL_CTL_ADD, streams[i].sd, &event);
+		if(config.verbose){
+			printf("%s: waiting for data on network device %s -- port UDP %u\n", streams[i].prefix, streams[i].serverIP, streams[i].port);
+		}
+	}
+
+	/* signals stay with the event loop, the writers inherit a blocked mask */
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &previous);
+	for(i=0; i<numWriters; i++){
+		pthread_mutex_init(&writers[i].lock, NULL);
+		pthread_cond_init(&writers[i].cond, NULL);
+		if(pthread_create(&writers[i].thread, NULL, writer_thread, &writers[i]) != 0){
+			pthread_sigmask(SIG_SETMASK, &previous, NULL);
+			printf("Could not start writer thread %i.\n", i);
+			return 0;
+		}
+		writers[i].started = 1;
+	}
+	pthread_sigmask(SIG_SETMASK, &previous, NULL);
+	if(config.verbose){
+		printf("Serving %i streams with %i writer threads, packet blocks %s huge pages.\n", numStreams, numWriters, poolHuge ? "on" : "not on");
+	}
+
+	active = numStreams;
+	nextStatus = time(NULL) + config.statusInterval;
+	while(!stopping && (active > 0)){
+		if((config.stop != NULL) && *config.stop){
+			break;
+		}
+		n = epoll_wait(epfd, events, MS_MAX_STREAMS + 1, -1);
+		if(n < 0){
+			if(errno == EINTR){
+				continue;
+			}
+			printf("epoll_wait failed.\n");
+			break;
+		}
+		for(i=0; i<n; i++){
+			if(events[i].data.u32 != MS_TIMER_ID){
+				receive_stream(events[i].data.u32);
+			}
+		}
+		for(i=0; i<n; i++){
+			if(events[i].data.u32 != MS_TIMER_ID){
+				continue;
+			}
+			read(tfd, &expirations, sizeof(expirations));
+			for(j=0; j<numStreams; j++){
+				/* a quiet stream still reaches the disk within a second */
+				if((streams[j].filling != NULL) && (streams[j].filling->used > 0)){
+					submit(streams[j].filling);
+					streams[j].filling = NULL;
+				}
+				if(streams[j].done && streams[j].active){
+					streams[j].active = 0;
+					active--;
+					epoll_ctl(epfd, EPOLL_CTL_DEL, streams[j].sd, NULL);
+				}
+			}
+			if(config.statusInterval && (time(NULL) >= nextStatus)){
+				print_status(stderr);
+				nextStatus = time(NULL) + config.statusInterval;
+			}
+			break;
+		}
+	}
+	finish();
+	return 1;
+}
+
+/* Stops serving and closes every file; for quit(), not for a signal handler */
+void ms_stop()
+{
+	if(numStreams == 0){
+		return;
+	}
+	stopping = 1;
+	finish();
+}
@@ -0,0 +1,55 @@
+/*
+Multi-Stream Receive v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+Serves several boards and ports from one process.  A single event loop waits on
+every stream's UDP socket with epoll, plus a timerfd that hands partly filled
+blocks to the writers and prints the status counters.  Packets are copied with
+their time stamps into large blocks taken from one shared pool; a small set of
+writer threads turns the blocks into .dat records (stream k is always written by
+writer k % writers, so records stay in arrival order) and rotates each stream's
+files in the background.  If the pool runs dry the packet is dropped and counted
+rather than stalling the sockets.
+
+The configuration file has one stream per line, blank lines and lines starting
+with # are ignored:
+
+writers <n>                                   (optional, default 2)
+<ip address | ANY> <port> <file prefix> [PFB mask file]
+
+Each stream writes <file prefix>_<N>.dat exactly as a single receive -w would,
+down to datagrams too short for a header: they are counted and written with the
+missing header zeroed, but are not tracked and start no spectrum.
+Without a mask file every hit is kept.
+*/
+
+#ifndef MULTISTREAM_H
+#define MULTISTREAM_H
+
+#include <stdint.h>
+#include <signal.h>
+#include "seqtrack.h"
+
+#define MS_MAX_STREAMS  32
+#define MS_MAX_WRITERS  8
+#define MS_BLOCK_SIZE   (256 * 1024)
+#define MS_POOL_BLOCKS  256
+#define MS_NAME_SIZE    256
+
+typedef struct msconfig_s {
+	int spectraPerFile;
+	int filesToWrite;
+	int maskSize;
+	int swap;
+	int verbose;
+	int statusInterval;            /* seconds between status lines, 0 for none */
+	volatile sig_atomic_t *stop;   /* set by a signal handler to stop serving; may be NULL */
+} msconfig;
+
+int ms_load(const char *path, int maskSize);
+int ms_run(const msconfig *config);
+void ms_stop();
+
+#endif
@@ -0,0 +1,312 @@
+/*
+NPY Export v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+See npyexport.h.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "npyexport.h"
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define NPY_ENDIAN ">"
+#else
+#define NPY_ENDIAN "<"
+#endif
+
+/* Format version 1.0: magic, version, header length, then the dictionary padded with spaces to a newline */
+static void npy_header(char *out, const npycolumn *c)
+{
+	char dict[NPY_HEADER_BYTES];
+	int n, headerLength = NPY_HEADER_BYTES - 10;
+
+	if(c->columns > 0){
+		n = snprintf(dict, sizeof(dict), "{'descr': '%s', 'fortran_order': False, 'shape': (%llu, %i), }",
+			c->descr, c->count / c->columns, c->columns);
+	}
+	else{
+		n = snprintf(dict, sizeof(dict), "{'descr': '%s', 'fortran_order': False, 'shape': (%llu,), }",
+			c->descr, c->count);
+	}
+	memcpy(out, "\x93NUMPY\x01\x00", 8);
+	out[8] = headerLength & 0xFF;
+	out[9] = headerLength >> 8;
+	memset(out + 10, ' ', headerLength);
+	memcpy(out + 10, dict, n);
+	out[NPY_HEADER_BYTES-1] = '\n';
+}
+
+static void col_write(npycolumn *c, const char *data, size_t bytes, off_t offset)
+{
+	ssize_t n;
+
+	while(bytes > 0){
+		n = (offset < 0) ? write(c->fd, data, bytes) : pwrite(c->fd, data, bytes, offset);
+		if(n < 0){
+			if(errno == EINTR){
+				continue;
+			}
+			if(c->error == 0){
+				c->error = errno;
+			}
+			return;
+		}
+		data += n;
+		bytes -= n;
+		if(offset >= 0){
+			offset += n;
+		}
+	}
+}
+
+static void col_flush(npycolumn *c)
+{
+	col_write(c, c->buffer, c->used, -1);
+	c->used = 0;
+}
+
+/* A new file, or with saved (a restart) the file as it was then, to go on after its last item */
+static int col_open(npycolumn *c, const char *prefix, const char *name, const char *descr, int itemSize, int columns, const npycolumn *saved)
+{
+	char header[NPY_HEADER_BYTES];
+	struct stat info;
+	off_t length;
+
+	snprintf(c->path, sizeof(c->path), "%s_%s.npy", prefix, name);
+	c->descr = descr;
+	c->itemSize = itemSize;
+	c->columns = columns;
+	c->buffer = (char *)malloc(NPY_BUFFER_SIZE);
+	if(c->buffer == NULL){
+		c->error = ENOMEM;
+		return 0;
+	}
+	if(saved != NULL){
+		c->fd = open(c->path, O_WRONLY);
+		if(c->fd < 0){
+			c->error = errno;
+			return 0;
+		}
+		length = NPY_HEADER_BYTES + (off_t)saved->count * itemSize;
+		if(fstat(c->fd, &info) != 0){
+			c->error = errno;
+		}
+		else if(info.st_size < length){
+			c->error = EINVAL;
+		}
+		else if((ftruncate(c->fd, length) != 0) || (lseek(c->fd, length, SEEK_SET) < 0)){
+			c->error = errno;
+		}
+		c->count = saved->count;
+		return c->error == 0;
+	}
+
+	c->fd = open(c->path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if(c->fd < 0){
+		c->error = errno;
+		return 0;
+	}
+	/* a placeholder with an empty shape, so even an unfinished file can be loaded */
+	npy_header(header, c);
+	col_write(c, header, sizeof(header), -1);
+	return c->error == 0;
+}
+
+static inline void col_put(npycolumn *c, const void *item)
+{
+	if(c->used + c->itemSize > NPY_BUFFER_SIZE){
+		col_flush(c);
+	}
+	memcpy(c->buffer + c->used, item, c->itemSize);
+	c->used += c->itemSize;
+	c->count++;
+}
+
+static int col_close(npycolumn *c)
+{
+	char header[NPY_HEADER_BYTES];
+
+	if(c->fd >= 0){
+		col_flush(c);
+		npy_header(header, c);
+		col_write(c, header, sizeof(header), 0);
+		if((close(c->fd) != 0) && (c->error == 0)){
+			c->error = errno;
+		}
+		c->fd = -1;
+	}
+	free(c->buffer);
+	c->buffer = NULL;
+	return c->error == 0;
+}
+
+static void end_row(npyexport *x)
+{
+	int bin;
+
+	for(bin=0; bin<NPY_COARSE_BINS; bin++){
+		col_put(&x->coarse, &x->row[bin]);
+	}
+	col_put(&x->spectrumTime, &x->rowTime);
+	x->spectra++;
+	x->rowOpen = 0;
+}
+
+static int npy_start(npyexport *x, const char *prefix, const npyexport *saved)
+{
+	npycolumn *columns[6];
+	int i;
+
+	memset(x, 0, sizeof(npyexport));
+	columns[0] = &x->time;
+	columns[1] = &x->fineBin;
+	columns[2] = &x->power;
+	columns[3] = &x->error;
+	columns[4] = &x->coarse;
+	columns[5] = &x->spectrumTime;
+	for(i=0; i<6; i++){
+		columns[i]->fd = -1;
+	}
+
+	if(col_open(&x->time, prefix, "time", NPY_ENDIAN "i8", 8, 0, saved ? &saved->time : NULL) &&
+	   col_open(&x->fineBin, prefix, "fine_bin", NPY_ENDIAN "u4", 4, 0, saved ? &saved->fineBin : NULL) &&
+	   col_open(&x->power, prefix, "power", NPY_ENDIAN "u4", 4, 0, saved ? &saved->power : NULL) &&
+	   col_open(&x->error, prefix, "error", NPY_ENDIAN "u4", 4, 0, saved ? &saved->error : NULL) &&
+	   col_open(&x->coarse, prefix, "coarse", NPY_ENDIAN "u4", 4, NPY_COARSE_BINS, saved ? &saved->coarse : NULL) &&
+	   col_open(&x->spectrumTime, prefix, "spectrum_time", NPY_ENDIAN "i8", 8, 0, saved ? &saved->spectrumTime : NULL)){
+		if(saved != NULL){
+			memcpy(x->row, saved->row, sizeof(x->row));
+			x->rowTime = saved->rowTime;
+			x->rowOpen = saved->rowOpen;
+			x->lastBin = saved->lastBin;
+			x->hits = saved->hits;
+			x->spectra = saved->spectra;
+		}
+		return 1;
+	}
+	for(i=0; i<6; i++){
+		if(columns[i]->fd >= 0){
+			close(columns[i]->fd);
+			columns[i]->fd = -1;
+		}
+		free(columns[i]->buffer);
+		columns[i]->buffer = NULL;
+	}
+	return 0;
+}
+
+/* Creates the six files; returns 0 if any of them cannot be, see npy_failure() */
+int npy_open(npyexport *x, const char *prefix)
+{
+	return npy_start(x, prefix, NULL);
+}
+
+/* Goes on with the files as they were when saved was copied from an npyexport just after npy_sync(); only its counts and open spectrum are used */
+int npy_resume(npyexport *x, const char *prefix, const npyexport *saved)
+{
+	return npy_start(x, prefix, saved);
+}
+
+void npy_record(npyexport *x, const datrecord *r)
+{
+	int64_t time;
+	uint32_t coarse, bin, power;
+	int j;
+
+	time = (int64_t)r->sec * 1000000 + r->usec;
+	if(r->pfbBin < NPY_COARSE_BINS){
+		if(x->rowOpen && (r->pfbBin <= x->lastBin)){
+			end_row(x);
+		}
+		if(!x->rowOpen){
+			memset(x->row, 0, sizeof(x->row));
+			x->rowTime = time;
+			x->rowOpen = 1;
+		}
+		x->row[(r->pfbBin + 2048) % 4096] = r->meanPower;
+		x->lastBin = r->pfbBin;
+	}
+
+	coarse = (r->pfbBin + 2048) % 4096;
+	for(j=0; j<r->nhits; j++){
+		bin = ((dat_hit_bin(r, j) + 16384) % 32768) + 32768*coarse;
+		power = dat_hit_power(r, j);
+		col_put(&x->time, &time);
+		col_put(&x->fineBin, &bin);
+		col_put(&x->power, &power);
+		col_put(&x->error, &r->errorCode);
+	}
+	x->hits += r->nhits;
+}
+
+/* Writes out what is buffered and headers for the spectra completed so far, and syncs the files; returns 0 after a write error */
+int npy_sync(npyexport *x)
+{
+	npycolumn *columns[6];
+	char header[NPY_HEADER_BYTES];
+	int i, ok = 1;
+
+	columns[0] = &x->time;
+	columns[1] = &x->fineBin;
+	columns[2] = &x->power;
+	columns[3] = &x->error;
+	columns[4] = &x->coarse;
+	columns[5] = &x->spectrumTime;
+	for(i=0; i<6; i++){
+		col_flush(columns[i]);
+		npy_header(header, columns[i]);
+		col_write(columns[i], header, sizeof(header), 0);
+		if((fdatasync(columns[i]->fd) != 0) && (columns[i]->error == 0)){
+			columns[i]->error = errno;
+		}
+		ok &= (columns[i]->error == 0);
+	}
+	return ok;
+}
+
+/* Writes out the last spectrum and the final headers; returns 0 if anything could not be written */
+int npy_close(npyexport *x)
+{
+	int ok = 1;
+
+	if(x->rowOpen){
+		end_row(x);
+	}
+	ok &= col_close(&x->time);
+	ok &= col_close(&x->fineBin);
+	ok &= col_close(&x->power);
+	ok &= col_close(&x->error);
+	ok &= col_close(&x->coarse);
+	ok &= col_close(&x->spectrumTime);
+	return ok;
+}
+
+/* The file that failed first and why, or NULL */
+const char *npy_failure(const npyexport *x, int *error)
+{
+	const npycolumn *columns[6];
+	int i;
+
+	columns[0] = &x->time;
+	columns[1] = &x->fineBin;
+	columns[2] = &x->power;
+	columns[3] = &x->error;
+	columns[4] = &x->coarse;
+	columns[5] = &x->spectrumTime;
+	for(i=0; i<6; i++){
+		if(columns[i]->error != 0){
+			*error = columns[i]->error;
+			return columns[i]->path;
+		}
+	}
+	*error = 0;
+	return NULL;
+}
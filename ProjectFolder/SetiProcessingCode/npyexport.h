@@ -0,0 +1,68 @@
+/*
+NPY Export v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+Writes the records of a series of receive .dat files (see datparse.h) as
+.npy arrays that numpy (numpy.load(..., mmap_mode='r')) or Octave can map
+straight from disk.  Given the prefix out it writes
+
+out_time.npy            <i8   per hit, microseconds since 1970 of its packet
+out_fine_bin.npy        <u4   per hit, ((bin+16384)%32768)+32768*coarse bin
+out_power.npy           <u4   per hit, power as received (/2147483648 to plot)
+out_error.npy           <u4   per hit, error code of its packet
+out_coarse.npy          <u4   spectra x 4096, mean power by coarse bin, 0 if missing
+out_spectrum_time.npy   <i8   per spectrum, microseconds since 1970 of its first packet
+
+(byte order '>' instead of '<' on a big endian host).  The coarse bin is
+the PFB bin after the +2048 rotation, so columns are in frequency order.  A
+new spectrum starts whenever a PFB bin, as sent, is not above the one before
+it.  The element count is not known until the end, so each file starts with
+a header of fixed size that npy_close() rewrites with the final shape.
+npy_sync() does the same with the spectra completed so far and puts the
+files on disk; a copy of the npyexport taken then lets npy_resume() carry on
+with them after a restart, cutting off anything written since.
+*/
+
+#ifndef NPYEXPORT_H
+#define NPYEXPORT_H
+
+#include <stdint.h>
+#include "datparse.h"
+
+#define NPY_HEADER_BYTES  128
+#define NPY_BUFFER_SIZE   (1 << 20)
+#define NPY_COARSE_BINS   4096
+
+typedef struct npycolumn_s {
+	int fd;
+	char path[256];
+	const char *descr;
+	int itemSize;
+	int columns;                /* 0 for a 1-D array */
+	unsigned long long count;   /* items written */
+	char *buffer;
+	size_t used;
+	int error;                  /* errno of the first failure, 0 if none */
+} npycolumn;
+
+typedef struct npyexport_s {
+	npycolumn time, fineBin, power, error;
+	npycolumn coarse, spectrumTime;
+	uint32_t row[NPY_COARSE_BINS];    /* spectrum being filled */
+	int64_t rowTime;
+	int rowOpen;
+	uint32_t lastBin;
+	unsigned long long hits;
+	unsigned long long spectra;
+} npyexport;
+
+int npy_open(npyexport *x, const char *prefix);
+int npy_resume(npyexport *x, const char *prefix, const npyexport *saved);
+void npy_record(npyexport *x, const datrecord *r);
+int npy_sync(npyexport *x);
+int npy_close(npyexport *x);
+const char *npy_failure(const npyexport *x, int *error);
+
+#endif
@@ -0,0 +1,56 @@
+/*
+Packet Record Writer v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+See pktwrite.h.
+*/
+
+#include <string.h>
+#include "pktwrite.h"
+
+static unsigned int swap32(unsigned int x)
+{
+	return ((x & 0x000000FF) << 24) | ((x & 0x0000FF00) << 8) |
+	       ((x & 0x00FF0000) >> 8)  | ((x & 0xFF000000) >> 24);
+}
+
+/* Returns the number of bytes written, header included */
+int pkt_write(FILE *out, const char *msg, int numBytes, int sec, int usec,
+	const int *mask, int maskSize, int swap)
+{
+	unsigned int record[3 + PKT_MAX_MSG/4];
+	unsigned int word, currentbin, tempbin, temppower;
+	int index, actualBin, words = 6;
+
+	if(numBytes > PKT_MAX_MSG){
+		numBytes = PKT_MAX_MSG;
+	}
+
+	/* PFB bin number, mean power and error code are always kept */
+	for(index = 0; index < 3; index++){
+		memcpy(&word, msg + 4*index, 4);
+		record[3+index] = swap ? swap32(word) : word;
+	}
+	currentbin = (record[3] + 2048) % 4096;
+
+	for(index = 0; index < (numBytes-12)/ 8; index++){
+		memcpy( &tempbin,    msg + ((index*8) + 12), 4);
+		if(swap){
+			tempbin = swap32(tempbin);
+		}
+		actualBin = ((((tempbin) + 16384) % 32768) + 32768*currentbin);
+		if(mask[(int)(actualBin*(double)maskSize/134217728.0)]){
+			memcpy( &temppower,  msg + ((index*8) + 16), 4);
+			record[words++] = tempbin;
+			record[words++] = swap ? swap32(temppower) : temppower;
+		}
+	}
+
+	record[0] = (words-3) * 4;
+	record[1] = sec;
+	record[2] = usec;
+	fwrite(record, sizeof(int), words, out);
+	return words * 4;
+}
@@ -0,0 +1,28 @@
+/*
+Packet Record Writer v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+Turns one BEE2 UDP packet into one record of a receive .dat file:
+
+length of data (12 + 8 * hits kept)
+seconds field of time stamp
+microseconds field of time stamp
+PFBbinNumber, meanPower, errorCode, hit #1 bin number, hit #1 power, ...
+
+Hits whose absolute fine bin falls in a zero entry of the PFB mask are dropped.
+The record is built in memory and handed to stdio with a single fwrite.
+*/
+
+#ifndef PKTWRITE_H
+#define PKTWRITE_H
+
+#include <stdio.h>
+
+#define PKT_MAX_MSG 1060
+
+int pkt_write(FILE *out, const char *msg, int numBytes, int sec, int usec,
+	const int *mask, int maskSize, int swap);
+
+#endif
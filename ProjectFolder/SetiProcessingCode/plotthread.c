@@ -0,0 +1,247 @@
+/*
+Plotting Thread v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+See plotthread.h.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/time.h>
+#include "plotthread.h"
+
+static gnuplot_ctrl *plotHandle;
+static double plotXmin, plotXmax;
+static double (*plotPosition)(double fine);
+static int *plotHitsFlag;
+static void (*plotService)(int requests);
+
+static pyramid frames[3];
+static int backFrame = 0;          /* filled by the capture loop */
+static int waitingFrame = 1;       /* the mailbox */
+static int frontFrame = 2;         /* being drawn */
+static int fresh = 0;
+static unsigned long dropped = 0;
+static volatile int pendingRequests = 0;
+
+/* the view, only the plotting thread touches it */
+static int viewLevel = 0;          /* PYR_FINE >> viewLevel fine bins across */
+static int viewCenter = PYR_FINE / 2;
+
+static double plotX[PYR_COARSE + 1];
+static double plotY[PYR_COARSE + 1];
+static double columnStart[PYR_COARSE];
+static pyrcell columns[PYR_COARSE];
+
+static pthread_t plotThread;
+static pthread_mutex_t plotLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t plotCond = PTHREAD_COND_INITIALIZER;
+
+/* Keeps the view inside the band */
+static void center_view(int center)
+{
+	int half = (PYR_FINE >> viewLevel) / 2;
+
+	if(center < half){
+		center = half;
+	}
+	if(center > PYR_FINE - half){
+		center = PYR_FINE - half;
+	}
+	viewCenter = center;
+}
+
+/* Returns 1 if the requests moved the view */
+static int move_view(int requests)
+{
+	int level = viewLevel, center = viewCenter;
+
+	if(requests & PLOT_REQ_ZOOM_OUT){
+		viewLevel = 0;
+		viewCenter = PYR_FINE / 2;
+	}
+	if((requests & PLOT_REQ_ZOOM_IN) && (viewLevel < PLOT_DEEPEST)){
+		viewLevel++;
+	}
+	if((requests & PLOT_REQ_WIDEN) && (viewLevel > 0)){
+		viewLevel--;
+		center_view(viewCenter);
+	}
+	if(requests & PLOT_REQ_LEFT){
+		center_view(viewCenter - (PYR_FINE >> viewLevel) / 4);
+	}
+	if(requests & PLOT_REQ_RIGHT){
+		center_view(viewCenter + (PYR_FINE >> viewLevel) / 4);
+	}
+	return (level != viewLevel) || (center != viewCenter) || (requests & PLOT_REQ_ZOOM_OUT);
+}
+
+static void draw(const pyramid *f, int moved)
+{
+	char rangeCommand[100];
+	double from, to, width;
+	int n, i, powerColumns;
+
+	from = (double)viewCenter - (double)(PYR_FINE >> viewLevel) / 2;
+	to = from + (double)(PYR_FINE >> viewLevel);
+	if(moved){
+		if(viewLevel > 0){
+			sprintf(rangeCommand, "set xrange [%.10g:%.10g]", plotPosition(from), plotPosition(to));
+		}
+		else{
+			sprintf(rangeCommand, "set xrange [%.10g:%.10g]", plotXmin, plotXmax);
+		}
+		gnuplot_cmd(plotHandle, rangeCommand);
+	}
+
+	gnuplot_resetplot(plotHandle);
+	if(f->packets == 0){
+		return;
+	}
+	if(*plotHitsFlag){
+		n = pyr_render(f, PYR_HITS, from, to, PYR_SCREEN, columnStart, columns);
+		width = (to - from) / PYR_SCREEN;
+		for(i=0; i<n; i++){
+			plotX[i] = plotPosition(columnStart[i] + width / 2);
+			plotY[i] = columns[i].max;
+		}
+		printf("Plot: %llu packets, %llu hits (%i shown, %lu frames dropped).\n", f->packets, f->totalHits, n, dropped);
+		if(n > 0){
+			gnuplot_setstyle(plotHandle, "points ls 5");
+			gnuplot_plot_xy(plotHandle, plotX, plotY, n, "Hits");
+		}
+	}
+	else{
+		printf("Plot: %llu packets, %llu hits. (Hits are off).\n", f->packets, f->totalHits);
+	}
+
+	/* a column a coarse bin, down to one when zoomed into a coarse bin */
+	powerColumns = (viewLevel < PYR_COARSE_LEVEL) ? (PYR_COARSE >> viewLevel) : 1;
+	n = pyr_render(f, PYR_POWER, from, to, powerColumns, columnStart, columns);
+	width = (to - from) / powerColumns;
+	for(i=0; i<n; i++){
+		plotX[i] = plotPosition(columnStart[i]);
+		plotY[i] = columns[i].sum / columns[i].count;
+	}
+	if(n > 0){
+		/* the last step needs somewhere to end */
+		plotX[n] = plotPosition(columnStart[n-1] + width);
+		plotY[n] = plotY[n-1];
+		gnuplot_setstyle(plotHandle, "steps ls 6");
+		gnuplot_plot_xy(plotHandle, plotX, plotY, n + 1, "");
+	}
+}
+
+static void *plot_thread(void *arg)
+{
+	struct timeval now;
+	struct timespec until;
+	int requests, swap, ready, moved;
+	sigset_t all;
+
+	/* the key bindings signal the process; let the capture thread take them */
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, NULL);
+
+	while(1){
+		pthread_mutex_lock(&plotLock);
+		if(!fresh){
+			/* wake up now and then for requests from signal handlers */
+			gettimeofday(&now, NULL);
+			until.tv_sec = now.tv_sec;
+			until.tv_nsec = now.tv_usec * 1000 + 100000000;
+			if(until.tv_nsec >= 1000000000){
+				until.tv_sec++;
+				until.tv_nsec -= 1000000000;
+			}
+			pthread_cond_timedwait(&plotCond, &plotLock, &until);
+		}
+		ready = fresh;
+		if(fresh){
+			swap = frontFrame;
+			frontFrame = waitingFrame;
+			waitingFrame = swap;
+			fresh = 0;
+		}
+		pthread_mutex_unlock(&plotLock);
+
+		requests = __sync_fetch_and_and(&pendingRequests, 0);
+		moved = move_view(requests);
+		if(requests && (plotService != NULL)){
+			plotService(requests);
+		}
+		/* a new view of the old spectrum when paused or between spectra */
+		if(ready || moved){
+			draw(&frames[frontFrame], moved);
+		}
+	}
+	return NULL;
+}
+
+/* xmin and xmax are the whole band on the x axis, position(fine bin) where a fine bin is on it */
+int plot_start(gnuplot_ctrl *h, double xmin, double xmax, double (*position)(double fine), int *plotHits, void (*service)(int requests))
+{
+	int i;
+
+	plotHandle = h;
+	plotXmin = xmin;
+	plotXmax = xmax;
+	plotPosition = position;
+	plotHitsFlag = plotHits;
+	plotService = service;
+	for(i=0; i<3; i++){
+		if(!pyr_init(&frames[i])){
+			printf("Out of memory for plotting.\n");
+			while(--i >= 0){
+				pyr_free(&frames[i]);
+			}
+			return 0;
+		}
+	}
+	if(pthread_create(&plotThread, NULL, plot_thread, NULL) != 0){
+		printf("Could not start plotting thread.\n");
+		return 0;
+	}
+	return 1;
+}
+
+/* The frame for the capture loop to put the next spectrum in, emptied */
+pyramid *plot_frame()
+{
+	pyr_begin(&frames[backFrame]);
+	return &frames[backFrame];
+}
+
+/* Called by the capture loop at a spectrum boundary once the frame is filled; returns at once */
+void plot_post()
+{
+	int swap;
+
+	pthread_mutex_lock(&plotLock);
+	if(fresh){
+		dropped++;
+	}
+	swap = waitingFrame;
+	waitingFrame = backFrame;
+	backFrame = swap;
+	fresh = 1;
+	pthread_cond_signal(&plotCond);
+	pthread_mutex_unlock(&plotLock);
+}
+
+/* Safe to call from a signal handler */
+void plot_request(int requests)
+{
+	__sync_fetch_and_or(&pendingRequests, requests);
+}
+
+unsigned long plot_dropped()
+{
+	return dropped;
+}
@@ -0,0 +1,47 @@
+/*
+Plotting Thread v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+Draws spectra with gnuplot on a thread of its own.  The capture loop fills the
+frame plot_frame() hands it, a pyramid (see pyramid.h), and posts it into a
+latest-value mailbox (three frames: one being filled, one waiting, one being
+drawn) and never waits on gnuplot; if gnuplot falls behind the waiting frame is
+simply replaced and counted as dropped.
+
+The thread draws the part of the band in view from the frame's pyramid, so a
+plot never has more points than a screen can show however far it is zoomed:
+the strongest hit in each of PYR_SCREEN columns and a step per coarse bin.
+PLOT_REQ_ZOOM_IN and PLOT_REQ_WIDEN halve and double the view, down to 64 fine
+bins, PLOT_REQ_LEFT and PLOT_REQ_RIGHT move it by a quarter and
+PLOT_REQ_ZOOM_OUT goes back to the whole band; the last frame is drawn again
+at once, paused or not.
+
+Signal handlers must not talk to gnuplot while the thread does, so they call
+plot_request() and the thread runs the service function given to plot_start().
+*/
+
+#ifndef PLOTTHREAD_H
+#define PLOTTHREAD_H
+
+#include "/home/danw/SPECTROSUITE/gnuplot_i-2.10/src/gnuplot_i.h"
+#include "pyramid.h"
+
+#define PLOT_DEEPEST  21                 /* zoomed in to PYR_FINE >> 21 = 64 fine bins */
+
+#define PLOT_REQ_TITLE     0x1
+#define PLOT_REQ_ZOOM_OUT  0x2
+#define PLOT_REQ_LOG       0x4
+#define PLOT_REQ_ZOOM_IN   0x8
+#define PLOT_REQ_WIDEN     0x10
+#define PLOT_REQ_LEFT      0x20
+#define PLOT_REQ_RIGHT     0x40
+
+int plot_start(gnuplot_ctrl *h, double xmin, double xmax, double (*position)(double fine), int *plotHits, void (*service)(int requests));
+pyramid *plot_frame();
+void plot_post();
+void plot_request(int requests);
+unsigned long plot_dropped();
+
+#endif
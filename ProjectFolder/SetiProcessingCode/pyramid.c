@@ -0,0 +1,301 @@
+/*
+Spectrum Pyramid v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+See pyramid.h.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "pyramid.h"
+
+#define PYR_INITIAL_HITS  65536
+
+static inline void cell_add(pyrcell *c, float value)
+{
+	if(c->count == 0){
+		c->min = value;
+		c->max = value;
+	}
+	else if(value < c->min){
+		c->min = value;
+	}
+	else if(value > c->max){
+		c->max = value;
+	}
+	c->sum += value;
+	c->count++;
+}
+
+static inline void cell_merge(pyrcell *into, const pyrcell *from)
+{
+	if(from->count == 0){
+		return;
+	}
+	if((into->count == 0) || (from->min < into->min)){
+		into->min = from->min;
+	}
+	if((into->count == 0) || (from->max > into->max)){
+		into->max = from->max;
+	}
+	into->sum += from->sum;
+	into->count += from->count;
+}
+
+/* Returns 0 if there is no memory */
+int pyr_init(pyramid *p)
+{
+	memset(p, 0, sizeof(pyramid));
+	p->hits = (pyrcell *)calloc((size_t)2 << PYR_DENSE_LEVEL, sizeof(pyrcell));
+	p->raw = (pyrhit *)malloc(PYR_INITIAL_HITS * sizeof(pyrhit));
+	if((p->hits == NULL) || (p->raw == NULL)){
+		pyr_free(p);
+		return 0;
+	}
+	p->rawCapacity = PYR_INITIAL_HITS;
+	pyr_begin(p);
+	return 1;
+}
+
+/* Starts a new spectrum */
+void pyr_begin(pyramid *p)
+{
+	p->generation++;
+	if(p->generation == 0){
+		memset(p->stamp, 0, sizeof(p->stamp));
+		p->generation = 1;
+	}
+	/* the levels above the coarse bins are shared by all of them, the rest waits for its coarse bin */
+	memset(p->power, 0, PYR_COARSE * sizeof(pyrcell));
+	memset(p->hits, 0, PYR_COARSE * sizeof(pyrcell));
+	p->rawUsed = 0;
+	p->packets = 0;
+	p->totalHits = 0;
+}
+
+/* Takes coarse bin's place in the spectrum; returns 0 if there is no memory for its hits, -1 if it is already in */
+static int open_bin(pyramid *p, uint32_t coarse, uint32_t meanPower, int nhits)
+{
+	uint32_t node, top;
+	size_t capacity;
+	pyrhit *grown;
+	float power;
+	int level;
+
+	if(p->stamp[coarse] == p->generation){
+		return -1;
+	}
+	if(p->rawUsed + nhits > p->rawCapacity){
+		capacity = 2 * p->rawCapacity;
+		if(capacity < p->rawUsed + nhits){
+			capacity = p->rawUsed + nhits;
+		}
+		grown = (pyrhit *)realloc(p->raw, capacity * sizeof(pyrhit));
+		if(grown == NULL){
+			return 0;
+		}
+		p->raw = grown;
+		p->rawCapacity = capacity;
+	}
+	p->stamp[coarse] = p->generation;
+
+	top = PYR_COARSE + coarse;
+	power = (float)(meanPower / 2147483648.0);
+	p->power[top].count = 0;
+	cell_add(&p->power[top], power);
+	for(node = top >> 1; node >= 1; node >>= 1){
+		cell_add(&p->power[node], power);
+	}
+
+	for(level = PYR_COARSE_LEVEL; level <= PYR_DENSE_LEVEL; level++){
+		memset(&p->hits[(1 << level) + (coarse << (level - PYR_COARSE_LEVEL))], 0,
+			((size_t)1 << (level - PYR_COARSE_LEVEL)) * sizeof(pyrcell));
+	}
+	p->rawStart[coarse] = p->rawUsed;
+	p->rawCount[coarse] = 0;
+	return 1;
+}
+
+/* bin is the fine bin within the coarse bin as the BEE2 sends it */
+static inline void add_hit(pyramid *p, uint32_t coarse, uint32_t bin, uint32_t rawPower)
+{
+	uint32_t fine, node, top = PYR_COARSE + coarse;
+	float power;
+
+	fine = ((bin + 16384) % 32768) + 32768*coarse;
+	power = (float)(rawPower / 2147483648.0);
+	p->raw[p->rawUsed].fine = fine;
+	p->raw[p->rawUsed].power = power;
+	p->rawUsed++;
+	p->rawCount[coarse]++;
+	for(node = (1 << PYR_DENSE_LEVEL) + (fine >> (PYR_TOP_LEVEL - PYR_DENSE_LEVEL)); node >= top; node >>= 1){
+		cell_add(&p->hits[node], power);
+	}
+}
+
+static void close_bin(pyramid *p, uint32_t coarse)
+{
+	uint32_t node, top = PYR_COARSE + coarse;
+
+	for(node = top >> 1; node >= 1; node >>= 1){
+		cell_merge(&p->hits[node], &p->hits[top]);
+	}
+	p->packets++;
+	p->totalHits += p->rawCount[coarse];
+}
+
+/* Adds a packet to the spectrum; returns 0 if there is no memory for its hits */
+int pyr_packet(pyramid *p, const datrecord *r)
+{
+	uint32_t coarse;
+	int opened, j;
+
+	if(r->pfbBin >= PYR_COARSE){
+		return 1;
+	}
+	coarse = (r->pfbBin + 2048) % 4096;
+	opened = open_bin(p, coarse, r->meanPower, r->nhits);
+	if(opened <= 0){
+		return opened < 0;
+	}
+	for(j=0; j<r->nhits; j++){
+		add_hit(p, coarse, dat_hit_bin(r, j), dat_hit_power(r, j));
+	}
+	close_bin(p, coarse);
+	return 1;
+}
+
+/* The same for a coarse bin (after the rotation) whose hits are in two arrays, as receive assembles them */
+int pyr_bin(pyramid *p, uint32_t coarse, uint32_t meanPower, const uint32_t *bins, const uint32_t *powers, int nhits)
+{
+	int opened, j;
+
+	if(coarse >= PYR_COARSE){
+		return 1;
+	}
+	opened = open_bin(p, coarse, meanPower, nhits);
+	if(opened <= 0){
+		return opened < 0;
+	}
+	for(j=0; j<nhits; j++){
+		add_hit(p, coarse, bins[j], powers[j]);
+	}
+	close_bin(p, coarse);
+	return 1;
+}
+
+/*
+Summarizes fine bins [from, to) of the spectrum in columns of equal width, from
+the coarsest level whose cells are no wider than a column.  Writes the columns
+that have something in them, in order, to out, and the fine bin each starts at
+to x (both need room for columns); returns how many.
+*/
+int pyr_render(const pyramid *p, int which, double from, double to, int columns, double *x, pyrcell *out)
+{
+	const pyrcell *table = (which == PYR_POWER) ? p->power : p->hits;
+	int deepest = (which == PYR_POWER) ? PYR_COARSE_LEVEL : PYR_DENSE_LEVEL;
+	double width, cellWidth, start, end;
+	long long first, last, c, coarse, k, limit;
+	int level, column, lastColumn, i, n;
+
+	if(from < 0){
+		from = 0;
+	}
+	if(to > PYR_FINE){
+		to = PYR_FINE;
+	}
+	if((columns <= 0) || (to <= from)){
+		return 0;
+	}
+	width = (to - from) / columns;
+	memset(out, 0, columns * sizeof(pyrcell));
+
+	level = 0;
+	while((level < deepest) && ((double)(PYR_FINE >> (level + 1)) >= width)){
+		level++;
+	}
+	cellWidth = (double)(PYR_FINE >> level);
+
+	if((which == PYR_HITS) && (cellWidth > width)){
+		/* finer than the cells go: the hits themselves, from the few coarse bins in view */
+		first = (long long)floor(from / 32768.0);
+		last = (long long)ceil(to / 32768.0) - 1;
+		for(coarse = first; coarse <= last; coarse++){
+			if(p->stamp[coarse] != p->generation){
+				continue;
+			}
+			limit = p->rawStart[coarse] + p->rawCount[coarse];
+			for(k = p->rawStart[coarse]; k < limit; k++){
+				start = p->raw[k].fine + 0.5;
+				if((start < from) || (start >= to)){
+					continue;
+				}
+				column = (int)((start - from) / width);
+				if(column >= columns){
+					column = columns - 1;
+				}
+				cell_add(&out[column], p->raw[k].power);
+			}
+		}
+	}
+	else{
+		first = (long long)floor(from / cellWidth);
+		last = (long long)ceil(to / cellWidth) - 1;
+		if(last > (1LL << level) - 1){
+			last = (1LL << level) - 1;
+		}
+		for(c = first; c <= last; c++){
+			if((level >= PYR_COARSE_LEVEL) && (p->stamp[c >> (level - PYR_COARSE_LEVEL)] != p->generation)){
+				continue;
+			}
+			if(table[(1LL << level) + c].count == 0){
+				continue;
+			}
+			start = c * cellWidth;
+			end = start + cellWidth;
+			if(cellWidth <= width){
+				/* a column takes the cells whose middle is in it */
+				start = (start + end) / 2;
+				if((start < from) || (start >= to)){
+					continue;
+				}
+				column = (int)((start - from) / width);
+				lastColumn = column;
+			}
+			else{
+				/* a coarse bin zoomed into fills every column it covers */
+				column = (start <= from) ? 0 : (int)((start - from) / width);
+				lastColumn = (end >= to) ? columns - 1 : (int)ceil((end - from) / width) - 1;
+			}
+			if(lastColumn >= columns){
+				lastColumn = columns - 1;
+			}
+			for(i = column; i <= lastColumn; i++){
+				cell_merge(&out[i], &table[(1LL << level) + c]);
+			}
+		}
+	}
+
+	n = 0;
+	for(i=0; i<columns; i++){
+		if(out[i].count > 0){
+			x[n] = from + i * width;
+			out[n] = out[i];
+			n++;
+		}
+	}
+	return n;
+}
+
+void pyr_free(pyramid *p)
+{
+	free(p->hits);
+	p->hits = NULL;
+	free(p->raw);
+	p->raw = NULL;
+	p->rawCapacity = 0;
+	p->rawUsed = 0;
+}
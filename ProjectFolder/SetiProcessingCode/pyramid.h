@@ -0,0 +1,83 @@
+/*
+Spectrum Pyramid v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+A multi-resolution summary of one spectrum, built a packet at a time, from
+which any stretch of the band can be drawn with no more points than a screen
+has columns.  The band is the 134217728 absolute fine bins
+((bin+16384)%32768)+32768*coarse bin, coarse bin being the PFB bin after the
++2048 rotation.  Level L cuts it into 2^L cells of 2^(27-L) fine bins; each
+cell keeps the count, min, max and sum of what fell in it, so a column drawn
+from several cells still has the right extremes and mean.
+
+Coarse power (the mean power of each packet) has levels 0 to 12, the last
+one being the 4096 coarse bins themselves.  Hits have levels 0 to
+PYR_DENSE_LEVEL (256 fine bins a cell) as arrays; below that they are drawn
+from the spectrum's hits themselves, kept grouped by coarse bin, so the
+finest zoom is one fine bin per column.  A packet adds its hits to its own
+coarse bin's cells and then once to the cells above, so building costs a few
+cell updates per hit.  The count of a hit cell is the hit density.
+
+Cells finer than a coarse bin belong to it and are cleared the first time it
+reports in a spectrum; a coarse bin that does not report keeps stale cells
+that are never read.  A second packet for the same coarse bin in one
+spectrum is ignored.  Powers are scaled as the plots show them
+(/2147483648).
+
+analyze adds the .dat records with pyr_packet(); receive, whose spectra come
+assembled by coarse bin, adds each bin with pyr_bin().
+*/
+
+#ifndef PYRAMID_H
+#define PYRAMID_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "datparse.h"
+
+#define PYR_FINE          134217728
+#define PYR_COARSE        4096
+#define PYR_TOP_LEVEL     27          /* one cell per fine bin */
+#define PYR_COARSE_LEVEL  12          /* one cell per coarse bin */
+#define PYR_DENSE_LEVEL   19          /* finest hit level kept as cells */
+#define PYR_SCREEN        2048        /* columns in a screen */
+
+#define PYR_POWER  0
+#define PYR_HITS   1
+
+typedef struct pyrcell_s {
+	uint32_t count;
+	float min;
+	float max;
+	float sum;
+} pyrcell;
+
+typedef struct pyrhit_s {
+	uint32_t fine;
+	float power;
+} pyrhit;
+
+typedef struct pyramid_s {
+	uint32_t generation;                  /* the spectrum being built */
+	uint32_t stamp[PYR_COARSE];           /* generation each coarse bin last reported in */
+	pyrcell power[2*PYR_COARSE];          /* level L, cell c at [2^L + c] */
+	pyrcell *hits;                        /* the same, 2^(PYR_DENSE_LEVEL+1) cells */
+	pyrhit *raw;                          /* this spectrum's hits */
+	uint32_t rawStart[PYR_COARSE];
+	uint32_t rawCount[PYR_COARSE];
+	size_t rawUsed;
+	size_t rawCapacity;
+	unsigned long long packets;           /* in this spectrum */
+	unsigned long long totalHits;
+} pyramid;
+
+int pyr_init(pyramid *p);
+void pyr_begin(pyramid *p);
+int pyr_packet(pyramid *p, const datrecord *r);
+int pyr_bin(pyramid *p, uint32_t coarse, uint32_t meanPower, const uint32_t *bins, const uint32_t *powers, int nhits);
+int pyr_render(const pyramid *p, int which, double from, double to, int columns, double *x, pyrcell *out);
+void pyr_free(pyramid *p);
+
+#endif
@@ -0,0 +1,265 @@
+/*
+Raw Packet Capture v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+See rawcap.h.  Files are opened with O_DIRECT so a burst does not fill the page
+cache; filesystems that refuse it (tmpfs for one) get ordinary buffered writes.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include "rawcap.h"
+#include "specpool.h"
+
+static char *block_at(rawcapture *c, unsigned long long n)
+{
+	return c->blocks + (size_t)(n % RAW_BUFFERS) * RAW_BLOCK_SIZE;
+}
+
+static int open_raw(rawcapture *c, int index)
+{
+	char name[RAW_NAME_SIZE + 32];
+	int fd;
+
+	snprintf(name, sizeof(name), "%s_%i.raw", c->prefix, index);
+	fd = open(name, O_WRONLY | O_CREAT | O_TRUNC | (c->directIO ? O_DIRECT : 0), 0644);
+	if((fd < 0) && c->directIO && (errno == EINVAL)){
+		c->directIO = 0;
+		fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	}
+	if(fd < 0){
+		printf("Could not open file %s.\n", name);
+	}
+	return fd;
+}
+
+/* Writes length bytes of a block; O_DIRECT takes whole pages, so the tail of the last block of a file goes through the page cache */
+static int write_block(rawcapture *c, int fd, const char *block, uint32_t length)
+{
+	uint32_t aligned = length;
+
+	if(c->directIO){
+		aligned = length & ~(uint32_t)(RAW_ALIGNMENT - 1);
+	}
+	if((aligned > 0) && (write(fd, block, aligned) != (ssize_t)aligned)){
+		return 0;
+	}
+	if(aligned < length){
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+		if(write(fd, block + aligned, length - aligned) != (ssize_t)(length - aligned)){
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static void *raw_thread(void *arg)
+{
+	rawcapture *c = (rawcapture *)arg;
+	int fd = -1, openIndex = -1;
+	uint32_t length;
+	char *block;
+	sigset_t all;
+
+	/* signal handlers run on the receive thread */
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, NULL);
+
+	pthread_mutex_lock(&c->lock);
+	while(1){
+		if(c->written < c->filled){
+			block = block_at(c, c->written);
+			if(c->blockFile[c->written % RAW_BUFFERS] != openIndex){
+				openIndex = c->blockFile[c->written % RAW_BUFFERS];
+				pthread_mutex_unlock(&c->lock);
+				if(fd >= 0){
+					close(fd);
+				}
+				fd = open_raw(c, openIndex);
+				pthread_mutex_lock(&c->lock);
+			}
+			length = c->blockLength[c->written % RAW_BUFFERS];
+			pthread_mutex_unlock(&c->lock);
+			if((fd >= 0) && !write_block(c, fd, block, length)){
+				printf("Write to raw capture file %i failed.\n", openIndex);
+				close(fd);
+				fd = -1;
+			}
+			pthread_mutex_lock(&c->lock);
+			if(fd < 0){
+				c->failed = 1;
+			}
+			c->written++;
+			pthread_cond_broadcast(&c->cond);
+		}
+		else if(c->stop){
+			break;
+		}
+		else{
+			pthread_cond_wait(&c->cond, &c->lock);
+		}
+	}
+	pthread_mutex_unlock(&c->lock);
+	if(fd >= 0){
+		close(fd);
+	}
+	return NULL;
+}
+
+static void begin_block(rawcapture *c)
+{
+	char *block = block_at(c, c->filled);
+
+	c->blockFile[c->filled % RAW_BUFFERS] = c->fileIndex;
+	c->used = RAW_BLOCK_HEADER;
+	c->packets = 0;
+	memset(block, 0, RAW_BLOCK_HEADER);
+}
+
+/* Seals the block being filled and hands it to the writer, whole unless it is the last of its file;
+   returns 0 if no block is free */
+static int hand_off(rawcapture *c, int last)
+{
+	char *block = block_at(c, c->filled);
+	uint32_t header[4];
+
+	header[0] = RAW_MAGIC;
+	header[1] = c->used;
+	header[2] = c->packets;
+	header[3] = 0;
+	memcpy(block, header, RAW_BLOCK_HEADER);
+	if(last){
+		c->blockLength[c->filled % RAW_BUFFERS] = c->used;
+	}
+	else{
+		memset(block + c->used, 0, RAW_BLOCK_SIZE - c->used);
+		c->blockLength[c->filled % RAW_BUFFERS] = RAW_BLOCK_SIZE;
+	}
+
+	pthread_mutex_lock(&c->lock);
+	c->filled++;
+	pthread_cond_broadcast(&c->cond);
+	if(c->filled - c->written >= RAW_BUFFERS){
+		pthread_mutex_unlock(&c->lock);
+		c->used = 0;
+		return 0;
+	}
+	pthread_mutex_unlock(&c->lock);
+	begin_block(c);
+	return 1;
+}
+
+/* The writer may have freed a block since the ring was last full */
+static int block_ready(rawcapture *c)
+{
+	int ready;
+
+	if(c->used != 0){
+		return 1;
+	}
+	pthread_mutex_lock(&c->lock);
+	ready = (c->filled - c->written < RAW_BUFFERS);
+	pthread_mutex_unlock(&c->lock);
+	if(ready){
+		begin_block(c);
+	}
+	return ready;
+}
+
+/* Prepares the buffers and the writer thread; <prefix>_<firstIndex>.raw is opened with the first block */
+int raw_start(rawcapture *c, const char *prefix, int firstIndex)
+{
+	memset(c, 0, sizeof(rawcapture));
+	strncpy(c->prefix, prefix, RAW_NAME_SIZE-1);
+	c->fileIndex = firstIndex;
+	c->directIO = 1;
+	/* mapped, so page aligned for O_DIRECT, and on huge pages when there are any */
+	c->blockBytes = (size_t)RAW_BUFFERS * RAW_BLOCK_SIZE;
+	c->blocks = (char *)spec_alloc(&c->blockBytes, &c->hugePages);
+	if(c->blocks == NULL){
+		printf("Out of memory for raw capture buffers.\n");
+		return 0;
+	}
+	begin_block(c);
+
+	pthread_mutex_init(&c->lock, NULL);
+	pthread_cond_init(&c->cond, NULL);
+	if(pthread_create(&c->thread, NULL, raw_thread, c) != 0){
+		printf("Could not start raw capture thread.\n");
+		spec_free(c->blocks, c->blockBytes);
+		c->blocks = NULL;
+		return 0;
+	}
+	c->running = 1;
+	return 1;
+}
+
+void raw_append(rawcapture *c, const char *msg, int numBytes, int sec, int usec)
+{
+	uint32_t header[3];
+	int padded = (numBytes + 3) & ~3;
+	char *at;
+
+	if(!block_ready(c)){
+		c->dropped++;
+		return;
+	}
+	if(c->used + RAW_RECORD_HEADER + padded > RAW_BLOCK_SIZE){
+		if(!hand_off(c, 0)){
+			c->dropped++;
+			return;
+		}
+	}
+	at = block_at(c, c->filled) + c->used;
+	header[0] = numBytes;
+	header[1] = sec;
+	header[2] = usec;
+	memcpy(at, header, RAW_RECORD_HEADER);
+	memcpy(at + RAW_RECORD_HEADER, msg, numBytes);
+	memset(at + RAW_RECORD_HEADER + numBytes, 0, padded - numBytes);
+	c->used += RAW_RECORD_HEADER + padded;
+	c->packets++;
+}
+
+/* Ends the current file at this packet; returns 0 once a write has failed */
+int raw_next_file(rawcapture *c)
+{
+	if(block_ready(c) && (c->packets > 0)){
+		hand_off(c, 1);
+	}
+	c->fileIndex++;
+	if(c->used != 0){
+		c->blockFile[c->filled % RAW_BUFFERS] = c->fileIndex;
+	}
+	return !c->failed;
+}
+
+/* Writes out the last block and waits for the writer */
+void raw_stop(rawcapture *c)
+{
+	if(!c->running){
+		return;
+	}
+	if(block_ready(c) && (c->packets > 0)){
+		hand_off(c, 1);
+	}
+	pthread_mutex_lock(&c->lock);
+	c->stop = 1;
+	pthread_cond_broadcast(&c->cond);
+	pthread_mutex_unlock(&c->lock);
+	pthread_join(c->thread, NULL);
+	c->running = 0;
+	if(c->dropped > 0){
+		printf("Raw capture: %llu packets dropped waiting for the disk.\n", c->dropped);
+	}
+	spec_free(c->blocks, c->blockBytes);
+	c->blocks = NULL;
+}
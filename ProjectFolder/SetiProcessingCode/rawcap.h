@@ -0,0 +1,95 @@
+/*
+Raw Packet Capture v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+Capture-only writing for receive -w -raw.  Datagrams are appended untouched
+(network byte order, no mask) behind a 12 byte header into 1 MB blocks that are
+aligned for O_DIRECT.  A background thread writes full blocks to
+<prefix>_<N>.raw while the receive thread fills the next one; if every block is
+still waiting for the disk the packet is dropped and counted.  rawconvert turns
+the files into the usual <prefix>_<N>.dat.
+
+Each block of a .raw file looks like this:
+
+magic ("SRAW")
+bytes used in the block, this header included
+number of packets in the block
+0
+packets, each: length of datagram, seconds, microseconds, datagram padded to 4 bytes
+zeros up to RAW_BLOCK_SIZE
+
+except that the last block of a file ends where its used bytes do, so a capture
+that moves on to a new file often does not leave most of a megabyte of zeros
+behind.  Read the blocks with raw_read_block().
+
+All header words are host byte order.
+*/
+
+#ifndef RAWCAP_H
+#define RAWCAP_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define RAW_MAGIC          0x57415253
+#define RAW_BLOCK_SIZE     (1 << 20)
+#define RAW_BLOCK_HEADER   16
+#define RAW_RECORD_HEADER  12
+#define RAW_BUFFERS        8
+#define RAW_ALIGNMENT      4096
+#define RAW_NAME_SIZE      256
+
+typedef struct rawcapture_s {
+	char prefix[RAW_NAME_SIZE];
+	int fileIndex;                     /* file the block being filled belongs to */
+	char *blocks;                      /* RAW_BUFFERS blocks, RAW_ALIGNMENT aligned */
+	size_t blockBytes;
+	int hugePages;                     /* blocks are on huge pages */
+	int blockFile[RAW_BUFFERS];
+	uint32_t blockLength[RAW_BUFFERS]; /* bytes of the block to write, less for the last of a file */
+	unsigned long long filled;         /* blocks handed to the writer */
+	unsigned long long written;        /* blocks the writer is done with */
+	uint32_t used;                     /* bytes used in block (filled % RAW_BUFFERS) */
+	uint32_t packets;
+	unsigned long long dropped;
+	int directIO;
+	int failed;
+	int stop;
+	int running;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+} rawcapture;
+
+int raw_start(rawcapture *c, const char *prefix, int firstIndex);
+void raw_append(rawcapture *c, const char *msg, int numBytes, int sec, int usec);
+int raw_next_file(rawcapture *c);
+void raw_stop(rawcapture *c);
+
+/* Reads the next block of a .raw file into block (RAW_BLOCK_SIZE bytes).
+   Returns the bytes used in it, 0 at the end of the file and -1 if it is damaged. */
+static inline int raw_read_block(FILE *in, char *block)
+{
+	uint32_t blockHeader[4];
+	size_t length;
+
+	length = fread(block, 1, RAW_BLOCK_SIZE, in);
+	if(length == 0){
+		return 0;
+	}
+	if(length < RAW_BLOCK_HEADER){
+		return -1;
+	}
+	memcpy(blockHeader, block, RAW_BLOCK_HEADER);
+	if((blockHeader[0] != RAW_MAGIC) || (blockHeader[1] < RAW_BLOCK_HEADER) || (blockHeader[1] > length)){
+		return -1;
+	}
+	return blockHeader[1];
+}
+
+#endif
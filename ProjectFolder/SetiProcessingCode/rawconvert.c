@@ -0,0 +1,168 @@
+/*
+Raw Capture Converter v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+To compile: gcc -O -Wall -o rawconvert pktwrite.c rawconvert.c
+
+Turns the <prefix>_<N>.raw files written by "receive -w -raw" into the usual
+<prefix>_<N>.dat files, byte-swapping and applying the PFB mask exactly as
+receive -w does, so analyze reads them as if they had been written live.  Files
+are converted starting with <prefix>_1.raw until the next one cannot be found.
+
+Usage: rawconvert <prefix> [options]
+-o <output prefix>     Write <output prefix>_<N>.dat (default <prefix>).
+-m <mask size>         Size of the PFB mask (default 65536).
+-mask <file>           PFB mask file (default /etc/PFBmask.txt, all hits kept if
+                       it cannot be found).
+-v                     Report every file.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "rawcap.h"
+#include "pktwrite.h"
+
+#define BYTE_SWAPPING 1
+
+static void print_usage(const char *prog_name)
+{
+	printf("Usage: %s <prefix> [options]\n", prog_name);
+	printf(" -o <output prefix>     Write <output prefix>_<N>.dat (default <prefix>).\n");
+	printf(" -m <mask size>         Size of the PFB mask (default 65536).\n");
+	printf(" -mask <file>           PFB mask file (default /etc/PFBmask.txt, all hits kept if\n");
+	printf("                        it cannot be found).\n");
+	printf(" -v                     Report every file.\n");
+}
+
+/* Returns the number of packets converted, -1 if the input is damaged */
+static long long convert_file(FILE *in, FILE *out, char *block, const int *mask, int maskSize)
+{
+	uint32_t record[3];
+	uint32_t offset, padded;
+	long long packets = 0;
+	int used;
+
+	while((used = raw_read_block(in, block)) != 0){
+		if(used < 0){
+			return -1;
+		}
+		offset = RAW_BLOCK_HEADER;
+		while(offset + RAW_RECORD_HEADER <= (uint32_t)used){
+			memcpy(record, block + offset, RAW_RECORD_HEADER);
+			padded = (record[0] + 3) & ~3;
+			if(offset + RAW_RECORD_HEADER + padded > (uint32_t)used){
+				return -1;
+			}
+			if(record[0] >= 12){
+				pkt_write(out, block + offset + RAW_RECORD_HEADER, record[0], record[1], record[2],
+					mask, maskSize, BYTE_SWAPPING);
+				packets++;
+			}
+			offset += RAW_RECORD_HEADER + padded;
+		}
+	}
+	return packets;
+}
+
+int main(int argc, const char *argv[])
+{
+	const char *prefix = NULL, *outPrefix = NULL, *maskName = "/etc/PFBmask.txt";
+	char name[1024];
+	int maskSize = 65536, verbose = 0, index, i, j;
+	int *mask;
+	char *block;
+	FILE *in, *out, *maskFile;
+	long long packets, totalPackets = 0;
+
+	for(i=1; i<argc; i++){
+		if((strcmp(argv[i], "-o") == 0) && (i < argc-1)){
+			outPrefix = argv[++i];
+		}
+		else if((strcmp(argv[i], "-m") == 0) && (i < argc-1)){
+			maskSize = atoi(argv[++i]);
+			if(maskSize < 1){
+				printf("Invalid mask size.\n");
+				return 1;
+			}
+		}
+		else if((strcmp(argv[i], "-mask") == 0) && (i < argc-1)){
+			maskName = argv[++i];
+		}
+		else if(strcmp(argv[i], "-v") == 0){
+			verbose = 1;
+		}
+		else if((argv[i][0] != '-') && (prefix == NULL)){
+			prefix = argv[i];
+		}
+		else{
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+	if(prefix == NULL){
+		print_usage(argv[0]);
+		return 1;
+	}
+	if(outPrefix == NULL){
+		outPrefix = prefix;
+	}
+
+	mask = (int *)malloc(maskSize * sizeof(int));
+	block = (char *)malloc(RAW_BLOCK_SIZE);
+	if((mask == NULL) || (block == NULL)){
+		printf("Out of memory.\n");
+		return 1;
+	}
+	maskFile = fopen(maskName, "rt");
+	if(maskFile == NULL){
+		printf("Could not find PFB mask file %s.\n", maskName);
+	}
+	for(i=0; i<maskSize; i++){
+		j = 1;
+		if(maskFile != NULL){
+			fscanf(maskFile, "%i", &j);
+		}
+		mask[i] = j;
+	}
+	if(maskFile != NULL){
+		fclose(maskFile);
+	}
+
+	for(index=1; ; index++){
+		snprintf(name, sizeof(name), "%s_%i.raw", prefix, index);
+		in = fopen(name, "rb");
+		if(in == NULL){
+			break;
+		}
+		snprintf(name, sizeof(name), "%s_%i.dat", outPrefix, index);
+		out = fopen(name, "wb");
+		if(out == NULL){
+			printf("Could not open file %s.\n", name);
+			fclose(in);
+			return 1;
+		}
+		packets = convert_file(in, out, block, mask, maskSize);
+		fclose(in);
+		fclose(out);
+		if(packets < 0){
+			printf("%s_%i.raw is damaged, converted up to the bad block.\n", prefix, index);
+			return 1;
+		}
+		if(verbose){
+			printf("%s: %lld packets\n", name, packets);
+		}
+		totalPackets += packets;
+	}
+	if(index == 1){
+		printf("Could not find %s_1.raw.\n", prefix);
+		return 1;
+	}
+	printf("Converted %i files, %lld packets.\n", index-1, totalPackets);
+	free(mask);
+	free(block);
+	return 0;
+}
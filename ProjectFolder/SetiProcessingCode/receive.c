@@ -5,7 +5,7 @@ SETI group
 Space Sciences Lab
 University of California, Berkeley
 
-To compile: gcc -O -Wall -o myprogram gnuplot_i.c myprogram.c -lm
+To compile: gcc -O -Wall -o receive gnuplot_i.c seqtrack.c assemble.c rotate.c shmpub.c plotthread.c pyramid.c specpool.c pktwrite.c multiqueue.c multistream.c rawcap.c replay.c metrics.c bee2serial.c chanstats.c rtprof.c receive.c -lm -lpthread -lrt
 
 This program receives UDP packets and either writes each packet, each packet's size, and a time stamp
 to binary files or plots the data it receives.
@@ -35,8 +35,40 @@ Usage: receive [options]
                        (Default, default center 2275.)
 -port0                 Change serial port connection to the BEE2 from the
                        default port /dev/ttyS1 to /dev/ttyS0.
+-serial <device>       Talk to the BEE2 on <device> (e.g. a bee2sim pty).
+-serialtimeout <ms>    Give up on a BEE2 command after <ms> milliseconds
+                       (default 1000).
+-cs <seconds>          Keep hit count, event limit saturation and mean power
+                       statistics for every PFB bin and append them to
+                       <file name>.chs every <seconds> seconds (see chanstats.h).
 -N                     For use from within Matlab/Octave. Write 2nd spectrum
                        to file.
+-st <seconds>          Print packet loss and BEE2 error counters to stderr every
+                       <seconds> seconds (default off).
+-shm <name>            Publish the latest complete spectrum in POSIX shared memory
+                       for live viewers such as shmwatch (default name
+                       /seti_receive_<port>).
+-q <queues>            Receive on <queues> SO_REUSEPORT sockets, one thread pinned
+                       per socket, each writing its own files <prefix>q<k>_<N>.dat
+                       for the one board it serves (write mode only).
+-qbpf                  With -q, steer each packet to the socket of the CPU that
+                       received it instead of the kernel's flow hash.
+-c <config file>       Receive every stream listed in <config file> (one line of
+                       <ip address> <port> <file prefix> [PFB mask file] each) from
+                       one event loop with shared writer threads; implies -w.
+-raw                   With -w, capture the datagrams untouched into
+                       <file name>_<integer>.raw (see rawcap.h) and leave decoding
+                       to rawconvert.
+-replay <prefix>       Read packets from <prefix>_<N>.raw (or .dat) files instead of
+                       the network and report the throughput at the end.
+-rate <factor>         Replay pace relative to the recorded time stamps: 1 is real
+                       time (default), 10 ten times faster, 0 as fast as possible.
+-metrics <port | path> Serve counters in the Prometheus text format over HTTP on
+                       127.0.0.1:<port> or on the Unix socket <path> (not with -c).
+-rt <priority>         Realtime profile: lock all memory and run the receive
+                       thread SCHED_FIFO at <priority> (1 to 99), see rtprof.h.
+-cpu <cpu>             Pin the receive thread to <cpu>, preferably one isolated
+                       with isolcpus= (not with -q or -c).
 -h (or any other garbage) -- Get this help.
 ** Use file name /dev/stdout for screen output.
 
@@ -144,23 +176,48 @@ missing PFB bin number.
 #include <unistd.h> /* close() */
 #include <string.h> /* memset() */
 #include <fcntl.h>
+#include "seqtrack.h"
+#include "rotate.h"
+#include "shmpub.h"
+#include "plotthread.h"
+#include "specpool.h"
+#include "pktwrite.h"
+#include "multiqueue.h"
+#include "multistream.h"
+#include "rawcap.h"
+#include "replay.h"
+#include "metrics.h"
+#include "bee2serial.h"
+#include "chanstats.h"
+#include "assemble.h"
+#include "rtprof.h"
 
 #define MAX_MSG 1060
+#define MAX_BIN_HITS ((MAX_MSG-12)/8)  /* the most hits one packet can carry */
 #define INTSIZE 10
 #define BYTE_SWAPPING 1
-#define MAXHITS 424288
 
 void setTitle();
 void quit();
+void requestQuit();
 void togglePaused();
 void toggleHits();
 void toggleLogPlot();
 void toggleKeyCommands();
 void zoomOut();
+void zoomIn();
+void zoomOutStep();
+void panLeft();
+void panRight();
+void setZoomOut();
+void setLogPlot();
+void plotService(int requests);
+double coarsePosition(int pfbBin);
+double hitPosition(double actualBin);
+void deliverSpectrum(const asmspectrum *s, void *arg);
 void print_usage(const char *prog_name);
 void parse_args(int argc, const char** argv);
 int endianSwap32(int x);
-int searchForPercent(int fd);
 
 // Required by ntptime
 typedef struct ntptimeval_s{
@@ -195,9 +252,36 @@ int processID=0;
 int spectrum2 = 0;
 int testMode = 0;
 float threshold = 0.09375;
-char port[11] = "/dev/ttyS1";
+char port[256] = "/dev/ttyS1";
+int serialTimeout = B2_DEFAULT_TIMEOUT;
+int channelInterval = 0;
+chanstats channelStats;
 int eventLimit = 128;
 int PFB_MASK_SIZE = 65536;
+int statusInterval = 0;
+seqtrack seqTracker;
+rotator fileRotator;
+int rotating = 0;
+int sharedMemory = 0;
+char sharedMemoryName[SHM_NAME_SIZE] = "";
+shmpub publisher;
+specpool spectrumPool;
+specbuf *spectrum = NULL;
+int *PFBmask = NULL;
+int receiveQueues = 1;
+int queueSteering = 0;
+char *streamConfig = NULL;
+int rawCapture = 0;
+rawcapture capture;
+char *replayPrefix = NULL;
+double replayRate = 1.0;
+replay player;
+char *metricsWhere = NULL;
+mxcounters *metrics = NULL;
+assembler spectrumAssembler;
+int assembling = 0;
+rtprofile realtime = {0, -1};
+volatile sig_atomic_t quitRequested = 0;
 
 int main (int argc, const char * argv[]) {
 
@@ -206,51 +290,43 @@ int main (int argc, const char * argv[]) {
 	
 	char result[1024];
 	char toSend[1024];
-	int sd, rc, numBytes, cliLen, index, index2;
-	int lastbin = -1;
+	int sd, rc, numBytes, cliLen;
 	int lastPFBbin = -1;
-	int pktcountLeft = 0;
-	int pktcountRight = 0;	
 	struct sockaddr_in cliAddr, servAddr;
 	char msg[MAX_MSG];
                                                                                                                              
-	//Graphing Arrays to be passed to GNUPlot
-	double binsLeft[2049];
-	double avgpowerLeft[2049];
-	double binsRight[2049];
-	double avgpowerRight[2049];
-	double binsConnection[2];
-	double avgpowerConnection[2];
-
-	//Reduced to meet requirements of dave
-	double hitbins[MAXHITS];
-	double hitpowers[MAXHITS];
-
-	int PFBmask[PFB_MASK_SIZE];
 	int filesWritten = 0;
 	int numberOfSpectra;
 	int skipNextReceive = 0;
 	int numfilecounter = 1;
-	int totalHits = 0;
-	int totalBins = 0; 
-	int actualBin;
-	int numBytesToWrite;
-
-	unsigned int curavgpower, currentbin, currentPFBbin, tempbin, temppower;
-	char fileheader2[100];
-	char fileheader3[100];
+
+	unsigned int currentbin;
+	unsigned int seqbin, seqerror, seqpower;
+	int newSpectrum;
+	int replaySec = 0, replayUsec = 0;
+	int recordBytes = 0;
+	struct timespec writeStart;
+	struct timeval arrival;
+	time_t nextStatus = 0;
+	time_t nextChannelDump = 0;
+	char fileheader3[130];
 	char pauseCommand[100];
 	char zoomOutCommand[100];
+	char zoomInCommand[100];
+	char zoomOutStepCommand[100];
+	char panLeftCommand[100];
+	char panRightCommand[100];
 	char quitCommand[100];
 	char toggleHitsCommand[100];
 	char toggleLogPlotCommand[100];
 	char toggleKeyCommandsCommand[100];	
 	FILE *fpToWrite;
-	char lastChar;
-	int fd;
+	bee2serial board;
+	struct sigaction stopAction;
 	
 	time(&timestuff);
 	sprintf(fileheader, "%i", (int)timestuff);
+	seq_init(&seqTracker);
 
 	if(argc >= 2){
   		parse_args(argc, argv);
@@ -259,11 +335,40 @@ int main (int argc, const char * argv[]) {
 		print_usage(argv[0]);
 		quit();
 	}
-	if(!writing && !plotting && !spectrum2){
+	if(!writing && !plotting && !spectrum2 && !sharedMemory){
 	        printf("\nWhat should I do with this data?\n\n");
 		print_usage(argv[0]);
 		quit();
 	}
+	if(channelInterval && ((receiveQueues > 1) || (streamConfig != NULL))){
+		printf("-cs cannot be combined with -q or -c.\n");
+		quit();
+	}
+	if((metricsWhere != NULL) && (streamConfig != NULL)){
+		printf("-metrics cannot be combined with -c.\n");
+		quit();
+	}
+	if(((realtime.priority > 0) || (realtime.cpu >= 0)) && ((receiveQueues > 1) || (streamConfig != NULL))){
+		printf("-rt and -cpu cannot be combined with -q or -c.\n");
+		quit();
+	}
+	if(rawCapture && (!writing || crudeoutput || (receiveQueues > 1) || (streamConfig != NULL))){
+		printf("-raw needs -w with a file name (not /dev/stdout, -q or -c).\n");
+		rawCapture = 0;
+		quit();
+	}
+
+	/* Working buffers come from the heap so main's stack stays small */
+	spec_pool_init(&spectrumPool);
+	spectrum = spec_get(&spectrumPool);
+	PFBmask = (int *)malloc(PFB_MASK_SIZE * sizeof(int));
+	if((spectrum == NULL) || (PFBmask == NULL)){
+		printf("Out of memory.\n");
+		quit();
+	}
+	if(verboseflag == 1){
+		printf("Spectrum buffers %s huge pages.\n", spectrumPool.hugePages ? "use" : "do not use");
+	}
 
 	/* Set the PFB mask */
 	fpToWrite = fopen("/etc/PFBmask.txt", "rt");
@@ -281,44 +386,25 @@ int main (int argc, const char * argv[]) {
 		fclose(fpToWrite);
 	}
 
-	/* Set the threshold level on the BEE2 */
-	fd = open(port, O_RDWR | O_NOCTTY | O_NDELAY);
-//	fd = open("/dev/ttyS0", O_RDWR | O_NOCTTY | O_NDELAY | O_NONBLOCK);
-//	fd = open("/dev/ttyS0", O_RDWR);	
-	if (fd == -1){
+	/* Set the threshold level on the BEE2, every step gives up after serialTimeout ms */
+	if(!b2_open(&board, port, serialTimeout, result, sizeof(result))){
 		printf("Warning: Unable to open port %s. Threshold scaler and event limit not set.\n", port);
 	}
 	else{
 		toSend[0] = 3;
-		write(fd, toSend, 1);
 		i=0;
-		if(searchForPercent(fd)){
-			write(fd, "`c", 2);
-			searchForPercent(fd);
-			toSend[0] = 3;
-			write(fd, toSend, 1);
-			searchForPercent(fd);
+		if(b2_command(&board, toSend, 1)){
+			b2_command(&board, "`c", 2);
+			b2_command(&board, toSend, 1);
 			sprintf(toSend, "setscaler %i\n", (int)(threshold * 512));
-			write(fd, toSend, strlen(toSend));
-			searchForPercent(fd);
+			rc = b2_command(&board, toSend, strlen(toSend));
 			sprintf(toSend, "seteventlimit %i\n", eventLimit);
-			write(fd, toSend, strlen(toSend));
-			if(searchForPercent(fd) && writing){
-				i=0;			
-				j=0;
-				lastChar = 0;
-				write(fd, "boardinfo\n", 11);
-				do{
-					if((read(fd, &result[i], 1) != -1) && (result[i] != '\r')){
-						lastChar = result[i];
-//						printf("%c", result[i]);
-						i++;
-					}
-					j++;
-				}while((i < 1024) && (j<1000000) && (lastChar != '%'));
-				if(j == 1000000){
-					i=0;
-				}
+			rc = b2_command(&board, toSend, strlen(toSend)) && rc;
+			if(!rc){
+				printf("Warning: BEE2 did not acknowledge the threshold scaler or event limit.\n");
+			}
+			if(rc && writing && b2_command(&board, "boardinfo\n", 10)){
+				i = board.length;
 			}
 		}
 		else{
@@ -349,7 +435,31 @@ int main (int argc, const char * argv[]) {
 				fclose(fpToWrite);
 			}
 		}
-		close(fd);
+		b2_close(&board);
+	}
+
+	/* per PFB bin statistics, dumped as we go */
+	if(channelInterval){
+		snprintf(fileheader3, sizeof(fileheader3), "%s.chs", fileheader);
+		if(!chs_open(&channelStats, fileheader3, eventLimit)){
+			quit();
+		}
+		nextChannelDump = time(NULL) + channelInterval;
+		if(verboseflag == 1){
+			printf("PFB bin statistics every %i s to %s\n", channelInterval, fileheader3);
+		}
+	}
+
+	if(sharedMemory){
+		if(sharedMemoryName[0] == '\0'){
+			sprintf(sharedMemoryName, "/seti_receive_%i", LOCAL_SERVER_PORT);
+		}
+		if(!shm_pub_open(&publisher, sharedMemoryName)){
+			quit();
+		}
+		if(verboseflag == 1){
+			printf("Publishing spectra to shared memory %s\n", sharedMemoryName);
+		}
 	}
 
 	if(testMode){
@@ -359,12 +469,20 @@ int main (int argc, const char * argv[]) {
 		testMode = 2;
 	}
 
-	signal(SIGHUP, quit);
-	signal(SIGINT, quit);
-	signal(SIGQUIT, quit);
+	/* the handler only asks; without SA_RESTART a waiting recvfrom() returns so the loop sees it */
+	memset(&stopAction, 0, sizeof(stopAction));
+	stopAction.sa_handler = requestQuit;
+	sigemptyset(&stopAction.sa_mask);
+	sigaction(SIGHUP, &stopAction, NULL);
+	sigaction(SIGINT, &stopAction, NULL);
+	sigaction(SIGQUIT, &stopAction, NULL);
+	sigaction(63, &stopAction, NULL);
 	signal(SIGALRM, togglePaused);
 	signal(60, zoomOut);
-	signal(63, quit);
+	signal(58, zoomIn);
+	signal(57, zoomOutStep);
+	signal(56, panLeft);
+	signal(55, panRight);
 	signal(62, toggleHits);
 	signal(61, toggleKeyCommands);
 	signal(59, toggleLogPlot);
@@ -377,6 +495,10 @@ int main (int argc, const char * argv[]) {
 
 		sprintf(pauseCommand, "bind x \"!kill -14 %i\"", processID);
 		sprintf(zoomOutCommand, "bind z \"!kill -60 %i\"", processID);
+		sprintf(zoomInCommand, "bind \"+\" \"!kill -58 %i\"", processID);
+		sprintf(zoomOutStepCommand, "bind \"-\" \"!kill -57 %i\"", processID);
+		sprintf(panLeftCommand, "bind Left \"!kill -56 %i\"", processID);
+		sprintf(panRightCommand, "bind Right \"!kill -55 %i\"", processID);
 		sprintf(quitCommand, "bind 9 \"!kill -63 %i\"", processID);
 		sprintf(toggleHitsCommand, "bind c \"!kill -62 %i\"", processID);
 		sprintf(toggleKeyCommandsCommand, "bind k \"!kill -61 %i\"", processID);
@@ -386,6 +508,10 @@ int main (int argc, const char * argv[]) {
 		gnuplot_cmd(h1, "set mouse");
 		gnuplot_cmd(h1, pauseCommand);
 		gnuplot_cmd(h1, zoomOutCommand);
+		gnuplot_cmd(h1, zoomInCommand);
+		gnuplot_cmd(h1, zoomOutStepCommand);
+		gnuplot_cmd(h1, panLeftCommand);
+		gnuplot_cmd(h1, panRightCommand);
 		gnuplot_cmd(h1, quitCommand);
 		gnuplot_cmd(h1, toggleHitsCommand);
 		gnuplot_cmd(h1, toggleLogPlotCommand);
@@ -420,46 +546,163 @@ int main (int argc, const char * argv[]) {
 		}
 
 		//initialize plotting arrays
-		memset(&binsLeft, 0, 2049);
-		memset(&avgpowerLeft, 0, 2049);
-		memset(&binsRight, 0, 2049);
-		memset(&avgpowerRight, 0, 2049);
-		memset(&hitbins, 0, MAXHITS);
-		memset(&hitpowers, 0, MAXHITS);
-
-		totalHits = 0;
-		pktcountLeft = 0;
-		pktcountRight = 0;		
-		lastbin = -1;
+		memset(spectrum->binsLeft, 0, SPEC_COARSE * sizeof(double));
+		memset(spectrum->avgpowerLeft, 0, SPEC_COARSE * sizeof(double));
+		memset(spectrum->binsRight, 0, SPEC_COARSE * sizeof(double));
+		memset(spectrum->avgpowerRight, 0, SPEC_COARSE * sizeof(double));
                 
 		gnuplot_resetplot(h1);
 		gnuplot_setstyle(h1, "steps ls 6");
-		gnuplot_plot_xy(h1, binsLeft, avgpowerLeft, 1, "Waiting for data...");
+		gnuplot_plot_xy(h1, spectrum->binsLeft, spectrum->avgpowerLeft, 1, "Waiting for data...");
 		setTitle();
+
+		/* from here on only the plotting thread talks to gnuplot */
+		if(domainBin){
+			rc = plot_start(h1, 0.0, 4096.0, hitPosition, &plotHits, plotService);
+		}
+		else if(domainAdjustedFrequency){
+			rc = plot_start(h1, frequencyCenter-100.0, frequencyCenter+100.0, hitPosition, &plotHits, plotService);
+		}
+		else{
+			rc = plot_start(h1, 0.0, 134217728.0, hitPosition, &plotHits, plotService);
+		}
+		if(!rc){
+			quit();
+		}
 	}
 
-	/* socket creation */
-	sd=socket(AF_INET, SOCK_DGRAM, 0);
-	if(sd<0) {
-		printf("%s: cannot open socket \n",argv[0]);
+	/* plotting, -N and live viewers all take whole spectra from the assembler */
+	if(plotting || spectrum2 || sharedMemory){
+		if(!asm_init(&spectrumAssembler, ASM_DEFAULT_TIMEOUT, deliverSpectrum, NULL)){
+			printf("Out of memory.\n");
+			quit();
+		}
+		assembling = 1;
+	}
+
+	/* counters for monitoring, kept by this thread and summed when scraped */
+	if(metricsWhere != NULL){
+		if(!mx_start(metricsWhere)){
+			quit();
+		}
+		/* with -q every queue registers its own */
+		if(receiveQueues == 1){
+			mx_seq(&seqTracker.stats);
+			metrics = mx_register("receive");
+		}
+		if(verboseflag == 1){
+			printf("Serving metrics on %s\n", metricsWhere);
+		}
+	}
+
+	/* every board and port of this host from one event loop */
+	if(streamConfig != NULL){
+		msconfig streamSettings;
+
+		if(crudeoutput || plotting || spectrum2 || sharedMemory || (receiveQueues > 1)){
+			printf("-c only supports writing to files (without -g, -N, -shm, -q or /dev/stdout).\n");
+			quit();
+		}
+		if(!ms_load(streamConfig, PFB_MASK_SIZE)){
+			quit();
+		}
+		streamSettings.spectraPerFile = spectraPerFile;
+		streamSettings.filesToWrite = filesToWrite;
+		streamSettings.maskSize = PFB_MASK_SIZE;
+		streamSettings.swap = BYTE_SWAPPING;
+		streamSettings.verbose = verboseflag;
+		streamSettings.statusInterval = statusInterval;
+		streamSettings.stop = &quitRequested;
+		ms_run(&streamSettings);
 		quit();
 	}
-	/* bind local server port */
-	servAddr.sin_family = AF_INET;
-	if (strcmp(ServerIP, "ANY") == 0){
-		servAddr.sin_addr.s_addr = htonl(INADDR_ANY);
-	}
-	else {
-		servAddr.sin_addr.s_addr = inet_addr(ServerIP);
-	} 
-	servAddr.sin_port = htons(LOCAL_SERVER_PORT);
-	rc = bind (sd, (struct sockaddr *) &servAddr,sizeof(servAddr));
-	if(rc<0){
-		printf("%s: cannot bind port number %d on network device %s\n", argv[0], LOCAL_SERVER_PORT, ServerIP);
+
+	/* several sockets on one port, one thread each, no plotting */
+	if(receiveQueues > 1){
+		mqconfig queueConfig;
+
+		if(!writing || crudeoutput || plotting || spectrum2 || sharedMemory){
+			printf("-q only supports writing to files (-w without -g, -N, -shm or /dev/stdout).\n");
+			quit();
+		}
+		queueConfig.serverIP = ServerIP;
+		queueConfig.port = LOCAL_SERVER_PORT;
+		queueConfig.queues = receiveQueues;
+		queueConfig.steer = queueSteering;
+		queueConfig.prefix = fileheader;
+		queueConfig.spectraPerFile = spectraPerFile;
+		queueConfig.filesToWrite = filesToWrite;
+		queueConfig.mask = PFBmask;
+		queueConfig.maskSize = PFB_MASK_SIZE;
+		queueConfig.swap = BYTE_SWAPPING;
+		queueConfig.verbose = verboseflag;
+		queueConfig.statusInterval = statusInterval;
+		queueConfig.tracker = &seqTracker;
+		queueConfig.metrics = (metricsWhere != NULL);
+		queueConfig.stop = &quitRequested;
+		if(verboseflag == 1){
+			printf("Receiving on %i queues, filenames will be: %sq<queue>_<integer>.dat\n", receiveQueues, fileheader);
+		}
+		mq_run(&queueConfig);
 		quit();
 	}
-	if (verboseflag == 1) {
-		printf("%s: waiting for data on network device %s -- port UDP %u\n", argv[0],ServerIP,LOCAL_SERVER_PORT);
+
+	/* recorded packets instead of the network */
+	if(replayPrefix != NULL){
+		if((receiveQueues > 1) || (streamConfig != NULL) || testMode){
+			printf("-replay cannot be combined with -q, -c or -t.\n");
+			quit();
+		}
+		if(!replay_open(&player, replayPrefix, replayRate, BYTE_SWAPPING)){
+			replayPrefix = NULL;
+			quit();
+		}
+		if(verboseflag == 1){
+			printf("Replaying %s_<integer>.%s", replayPrefix, player.raw ? "raw" : "dat");
+			if(replayRate > 0.0){
+				printf(" at %g times real time\n", replayRate);
+			}
+			else{
+				printf(" as fast as possible\n");
+			}
+		}
+		sd = -1;
+	}
+	else{
+		/* socket creation */
+		sd=socket(AF_INET, SOCK_DGRAM, 0);
+		if(sd<0) {
+			printf("%s: cannot open socket \n",argv[0]);
+			quit();
+		}
+		/* bind local server port */
+		servAddr.sin_family = AF_INET;
+		if (strcmp(ServerIP, "ANY") == 0){
+			servAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+		}
+		else {
+			servAddr.sin_addr.s_addr = inet_addr(ServerIP);
+		} 
+		servAddr.sin_port = htons(LOCAL_SERVER_PORT);
+		rc = bind (sd, (struct sockaddr *) &servAddr,sizeof(servAddr));
+		if(rc<0){
+			printf("%s: cannot bind port number %d on network device %s\n", argv[0], LOCAL_SERVER_PORT, ServerIP);
+			quit();
+		}
+		if(metrics != NULL){
+			mx_watch_socket(sd);
+		}
+		{
+			/* wake up now and then so a spectrum is not held back when the stream stops, nor a quit */
+			struct timeval wakeUp;
+
+			wakeUp.tv_sec = 0;
+			wakeUp.tv_usec = 250000;
+			setsockopt(sd, SOL_SOCKET, SO_RCVTIMEO, &wakeUp, sizeof(wakeUp));
+		}
+		if (verboseflag == 1) {
+			printf("%s: waiting for data on network device %s -- port UDP %u\n", argv[0],ServerIP,LOCAL_SERVER_PORT);
+		}
 	}
 
 	if(writing){
@@ -469,12 +712,22 @@ int main (int argc, const char * argv[]) {
 				printf("Files to write will be: %i\n", filesToWrite);
 				printf("Spectra per file will be: %i\n", spectraPerFile);
 			}
-			sprintf(fileheader2, "%s_%i.dat", fileheader, numfilecounter);
-			fp = fopen(fileheader2, "wb");
-			if(fp == NULL){
-				printf("Could not open file %s.\n", fileheader2);
+			/* capture only, the disk writes happen on another thread */
+			if(rawCapture){
+				if(verboseflag == 1){
+					printf("Capturing raw packets to %s_<integer>.raw\n", fileheader);
+				}
+				if(!raw_start(&capture, fileheader, numfilecounter)){
+					quit();
+				}
+			}
+			/* the following files are opened and preallocated in the background */
+			else if((fp = rot_start(&fileRotator, fileheader, numfilecounter, filesToWrite, (long long)spectraPerFile * 4096 * 24)) == NULL){
 				quit();
 			}
+			else{
+				rotating = 1;
+			}
 		}
 		else if(crudeoutput == 1){
 			if (verboseflag == 1){
@@ -484,15 +737,98 @@ int main (int argc, const char * argv[]) {
 		}
 	}
 
+	/* last, so the helper threads started above keep normal scheduling and every CPU */
+	if((realtime.priority > 0) || (realtime.cpu >= 0)){
+		rt_apply(&realtime);
+		rt_report(stdout, &realtime);
+		printf("Huge pages: spectrum buffers %s", spectrumPool.hugePages ? "yes" : "no");
+		if(rawCapture){
+			printf(", capture blocks %s", capture.hugePages ? "yes" : "no");
+		}
+		else if(rotating){
+			printf(", file buffers %s", fileRotator.current.huge ? "yes" : "no");
+		}
+		printf("\n");
+	}
+
 	while (1){
 		numberOfSpectra = 0;
 		while(1){
+			if(quitRequested){
+				quit();
+			}
 			if(!skipNextReceive){
 				/* init buffer */
 				memset(msg,0x0,MAX_MSG);
 				/* receive message */
-				cliLen = sizeof(cliAddr);
-				numBytes = recvfrom(sd, msg, MAX_MSG, 0, (struct sockaddr *) &cliAddr, &cliLen);
+				if(replayPrefix != NULL){
+					numBytes = replay_next(&player, msg, MAX_MSG, &replaySec, &replayUsec);
+					if(numBytes == REPLAY_END){
+						quit();
+					}
+					if(metrics != NULL){
+						metrics->packets++;
+						metrics->bytes += numBytes;
+					}
+				}
+				else if(metrics != NULL){
+					numBytes = mx_recv(sd, msg, MAX_MSG, metrics, NULL);
+				}
+				else{
+					cliLen = sizeof(cliAddr);
+					numBytes = recvfrom(sd, msg, MAX_MSG, 0, (struct sockaddr *) &cliAddr, &cliLen);
+				}
+				if(numBytes < 0){
+					/* timed out or interrupted, nothing to write */
+					if(assembling){
+						gettimeofday(&arrival, NULL);
+						asm_poll(&spectrumAssembler, &arrival);
+					}
+					continue;
+				}
+
+				/* account for sequence gaps and error codes as packets arrive */
+				if(numBytes >= 12){
+					memcpy(&seqbin, msg, 4);
+					memcpy(&seqerror, msg + 8, 4);
+					if(BYTE_SWAPPING){
+						seqbin = endianSwap32(seqbin);
+						seqerror = endianSwap32(seqerror);
+					}
+					if(seqbin < 4096){
+						seqbin = (seqbin + 2048) % 4096;
+					}
+					newSpectrum = seq_track(&seqTracker, seqbin, seqerror);
+					if(newSpectrum && (metrics != NULL)){
+						mx_spectrum(metrics);
+					}
+					if(newSpectrum && statusInterval && (time(NULL) >= nextStatus)){
+						seq_print(stderr, &seqTracker.stats);
+						nextStatus = time(NULL) + statusInterval;
+					}
+
+					if(channelInterval){
+						memcpy(&seqpower, msg + 4, 4);
+						if(BYTE_SWAPPING){
+							seqpower = endianSwap32(seqpower);
+						}
+						chs_packet(&channelStats, seqbin, (numBytes-12)/8, seqpower / 2147483648.0);
+						if(newSpectrum && (time(NULL) >= nextChannelDump)){
+							chs_dump(&channelStats);
+							nextChannelDump = time(NULL) + channelInterval;
+						}
+					}
+
+					/* plotting and live viewers get each spectrum once it is assembled */
+					if(assembling){
+						gettimeofday(&arrival, NULL);
+						if(asm_packet(&spectrumAssembler, msg, numBytes, BYTE_SWAPPING, arrival.tv_sec, arrival.tv_usec) < 0){
+							printf("Out of memory assembling spectrum %llu.\n", (unsigned long long)spectrumAssembler.opened);
+							quit();
+						}
+						asm_poll(&spectrumAssembler, &arrival);
+					}
+				}
 			}
 			else{
 				skipNextReceive = 0;
@@ -502,21 +838,29 @@ int main (int argc, const char * argv[]) {
 			if(writing){
 				
 				ntp_gettime((struct ntptimeval *) &times);
-				memcpy(&currentbin, &msg, 4);
-				if(BYTE_SWAPPING){
-					currentbin = endianSwap32(currentbin);
+				if(replayPrefix != NULL){
+					/* keep the recorded time stamps */
+					times.time.tv_sec = replaySec;
+					times.time.tv_usec = replayUsec;
 				}
-				currentbin = (currentbin + 2048) % 4096;
-
-				if((signed int)currentbin <= lastPFBbin){
-					numberOfSpectra++;
-					if(numberOfSpectra >= spectraPerFile){
-						lastPFBbin = currentbin-1;
-						skipNextReceive = 1;
-						break;
+				/* a datagram too short for a header is written but is no spectrum boundary */
+				if(numBytes >= 12){
+					memcpy(&currentbin, &msg, 4);
+					if(BYTE_SWAPPING){
+						currentbin = endianSwap32(currentbin);
+					}
+					currentbin = (currentbin + 2048) % 4096;
+
+					if((signed int)currentbin <= lastPFBbin){
+						numberOfSpectra++;
+						if(numberOfSpectra >= spectraPerFile){
+							lastPFBbin = currentbin-1;
+							skipNextReceive = 1;
+							break;
+						}
 					}
+					lastPFBbin = currentbin;
 				}
-				lastPFBbin = currentbin;
 /*
 
 				if((currentbin >= 0) && (currentbin < 4096) && PFBmask[currentbin]){
@@ -553,235 +897,24 @@ int main (int argc, const char * argv[]) {
 					}
 				}
 */
-				if((currentbin >= 0) && (currentbin < 4096)){
-
-					numBytesToWrite=12;
-					for(index = 0; index < (numBytes-12)/ 8; index++){
-						memcpy( &tempbin,    msg + ((index*8) + 12), 4);
-						if(BYTE_SWAPPING){
-							tempbin = endianSwap32(tempbin);
-						}
-						actualBin = ((((tempbin) + 16384) % 32768) + 32768*currentbin);
-						if(PFBmask[(int)(actualBin*(double)PFB_MASK_SIZE/134217728.0)]){
-							numBytesToWrite += 8;
-						}
-					}
-
-					fwrite(&numBytesToWrite, sizeof(int), 1, fp);
-					fwrite(&times.time.tv_sec, sizeof(int), 1, fp);
-					fwrite(&times.time.tv_usec, sizeof(int), 1, fp);
-
-					if(BYTE_SWAPPING){
-						for(j=0; j<12/4; j++){
-							fwrite(msg+4*j+3, sizeof(char), 1, fp);
-							fwrite(msg+4*j+2, sizeof(char), 1, fp);
-							fwrite(msg+4*j+1, sizeof(char), 1, fp);
-							fwrite(msg+4*j+0, sizeof(char), 1, fp);
-						}
-					}
-					else{
-						fwrite(msg, sizeof(char), 12, fp);
-					}
-
-					for(index = 0; index < (numBytes-12)/ 8; index++){
-						memcpy( &tempbin,    msg + ((index*8) + 12), 4);
-						if(BYTE_SWAPPING){
-							tempbin = endianSwap32(tempbin);
-						}
-						actualBin = ((((tempbin) + 16384) % 32768) + 32768*currentbin);
-						if(PFBmask[(int)(actualBin*(double)PFB_MASK_SIZE/134217728.0)]){
-							memcpy( &temppower,  msg + ((index*8) + 16), 4);
-							if(BYTE_SWAPPING){
-								temppower = endianSwap32(temppower);
-							}
-							fwrite(&tempbin, sizeof(int), 1, fp);
-							fwrite(&temppower, sizeof(int), 1, fp);
-						}
-					}				
+				if(metrics != NULL){
+					clock_gettime(CLOCK_MONOTONIC, &writeStart);
 				}
-				
-				
-			}
-
-			if(plotting || spectrum2){
-				memcpy(&currentbin, &msg, 4);
-				if(BYTE_SWAPPING){
-					currentbin = endianSwap32(currentbin);
-				}
-
-				currentPFBbin = (currentbin + 2048) % 4096;
-
-				index2=0;
-				for(index = 0; index < (numBytes-12)/ 8; index++){
-					memcpy( &tempbin,    msg + ((index*8) + 12), 4);
-					memcpy( &temppower,  msg + ((index*8) + 16), 4);
-					if(BYTE_SWAPPING){
-						tempbin = endianSwap32(tempbin);
-						temppower = endianSwap32(temppower);
-					}
-					actualBin = ((((tempbin) + 16384) % 32768) + 32768*currentPFBbin);
-					
-					if(PFBmask[(int)(actualBin*(double)PFB_MASK_SIZE/134217728.0)]){
-						if(domainBin){
-							hitbins[totalHits+index2] = ((double) actualBin) / 32768.0 - 0.5;
-						}
-						else if(domainAdjustedFrequency){
-							hitbins[totalHits+index2]  = ((double) actualBin) / 671088.64 - 100.0 - 0.0244140625 + (double)frequencyCenter;
-						}
-						else{
-							printf("Internal error: No domain preference.\n");
-							hitbins[totalHits+index2] = (double) actualBin;
-						}
-						hitpowers[totalHits+index2] = ((double) temppower) / 2147483648.0;
-						index2++;
-					}
-				}				
-				totalHits += index2;
-
-				
-				if(currentbin <= lastbin){
-
-					if(spectrum2 == 1){
-						spectrum2++;
-					}
-					else if(spectrum2 == 2){
-						//  WRITE TO FILE
-
-						fpToWrite = fopen("/tmp/receiveVectorBin","w");
-						//write bins, avgpower, hitbins, hitpowers
-						for(j=0; j<pktcountLeft-1; j++){
-							fprintf(fpToWrite, "%g\t", binsLeft[j]);
-						}
-						for(j=0; j<pktcountRight-1; j++){
-							fprintf(fpToWrite, "%g\t", binsRight[j]);
-						}
-						fclose(fpToWrite);
-						fpToWrite = fopen("/tmp/receiveVectorAvgPower","w");
-						for(j=0; j<pktcountLeft-1; j++){
-							fprintf(fpToWrite, "%g\t", avgpowerLeft[j]);
-						}
-						for(j=0; j<pktcountRight-1; j++){
-							fprintf(fpToWrite, "%g\t", avgpowerRight[j]);
-						}
-						fclose(fpToWrite);
-						fpToWrite = fopen("/tmp/receiveVectorHitBin","w");
-						for(j=0; j<totalHits; j++){
-							fprintf(fpToWrite, "%g\t", hitbins[j]);
-						}
-						fclose(fpToWrite);
-						fpToWrite = fopen("/tmp/receiveVectorHitPower","w");
-						for(j=0; j<totalHits; j++){
-							fprintf(fpToWrite, "%g\t", hitpowers[j]);						
-						}
-						fclose(fpToWrite);
-						quit();
-					}
-					else if(!paused){
-						totalBins = pktcountLeft+pktcountRight;
-						gnuplot_resetplot(h1);
-						if(totalBins && totalHits){
-							if(plotHits){
-								printf("Plot: totalBins: %i, totalHits: %i.\n", totalBins, totalHits);
-								gnuplot_setstyle(h1, "points ls 5");
-								gnuplot_plot_xy(h1, hitbins, hitpowers, totalHits, "Hits");
-
-							}
-							else{
-								printf("Plot: totalBins: %i, totalHits: %i. (Hits are off).\n", totalBins, totalHits);
-							}
-							gnuplot_setstyle(h1, "steps ls 6");
-							binsConnection[0] = binsLeft[pktcountLeft-1];
-							binsConnection[1] = binsRight[0];						
-							avgpowerConnection[0] = avgpowerLeft[pktcountLeft-1];
-							avgpowerConnection[1] = avgpowerRight[0];
-							gnuplot_plot_xy(h1, binsLeft, avgpowerLeft, pktcountLeft, "");
-							gnuplot_plot_xy(h1, binsRight, avgpowerRight, pktcountRight, "");
-//							gnuplot_plot_xy(h1, binsConnection, avgpowerConnection, 2, "");
-						}
-					}
-
-					lastbin = currentbin;
-					totalHits = 0;
-					pktcountLeft = 0;
-					pktcountRight = 0;					
-					memset(&avgpowerLeft, 0, 2049);
-					memset(&binsLeft, 0, 2049);
-					memset(&avgpowerRight, 0, 2049);
-					memset(&binsRight, 0, 2049);
-					memset(&hitbins, 0, MAXHITS);
-					memset(&hitpowers, 0, MAXHITS);
-				}
-				lastbin = currentbin;
-				memcpy(&curavgpower, msg + 4, 4);
-				if(BYTE_SWAPPING){
-					curavgpower = endianSwap32(curavgpower);
-				}
-				// ADJUST FOR THRESHOLDER BINARY POINT, MOVING 32_22 TO 32_31
-				//curavgpower <<= 9;
-
-				if(currentPFBbin < 2048){
-					/*avgpowerLeft[pktcountLeft] = ((double) curavgpower) / 4194304.0;*/
-					avgpowerLeft[pktcountLeft] = ((double) curavgpower) / 2147483648.0;
-
-					if(domainBin){
-						binsLeft[pktcountLeft] = ((double) currentPFBbin)-0.5;
-					}
-					else if(domainAdjustedFrequency){
-						binsLeft[pktcountLeft] = (((double) currentPFBbin)-0.5) / 20.48 - 100.0 + (double)frequencyCenter;
-					}
-					else{
-						printf("Internal error: No domain preference.\n");
-						binsLeft[pktcountLeft] = (((double) currentPFBbin) - 0.5) * 32768.0;
-					}
-					pktcountLeft++;
-					if(currentPFBbin == 2047 && 0){
-						/*avgpowerLeft[pktcountLeft] = ((double) curavgpower) / 4194304.0;*/
-						avgpowerLeft[pktcountLeft] = ((double) curavgpower) / 2147483648.0;
-
-						if(domainBin){
-							binsLeft[pktcountLeft] = ((double) currentPFBbin)+0.5;
-						}
-						else if(domainAdjustedFrequency){
-							binsLeft[pktcountLeft] = (((double) currentPFBbin)+0.5) / 20.48 - 100.0 + (double)frequencyCenter;
-						}
-						else{
-							printf("Internal error: No domain preference.\n");
-							binsLeft[pktcountLeft] = (((double) currentPFBbin) + 0.5) * 32768.0;
-						}
-						pktcountLeft++;
-					}
+				if(rawCapture){
+					raw_append(&capture, msg, numBytes, times.time.tv_sec, times.time.tv_usec);
 				}
 				else{
-					/*avgpowerRight[pktcountRight] = ((double) curavgpower) / 4194304.0;*/
-					avgpowerRight[pktcountRight] = ((double) curavgpower) / 2147483648.0;
-					
-					if(domainBin){
-						binsRight[pktcountRight] = ((double) currentPFBbin)-0.5;
-					}
-					else if(domainAdjustedFrequency){
-						binsRight[pktcountRight] = (((double) currentPFBbin)-0.5) / 20.48 - 100.0 + (double)frequencyCenter;
-					}
-					else{
-						printf("Internal error: No domain preference.\n");
-						binsRight[pktcountRight] = (((double) currentPFBbin) - 0.5) * 32768.0;
-					}
-					pktcountRight++;
-					if(currentPFBbin == 4095 && 0){
-						/*avgpowerRight[pktcountRight] = ((double) curavgpower) / 4194304.0;*/
-						avgpowerRight[pktcountRight] = ((double) curavgpower) / 2147483648.0;
-						if(domainBin){
-							binsRight[pktcountRight] = ((double) currentPFBbin)+0.5;
-						}
-						else if(domainAdjustedFrequency){
-							binsRight[pktcountRight] = (((double) currentPFBbin)+0.5) / 20.48 - 100.0 + (double)frequencyCenter;
-						}
-						else{
-							printf("Internal error: No domain preference.\n");
-							binsRight[pktcountRight] = (((double) currentPFBbin) + 0.5) * 32768.0;
-						}
-						pktcountRight++;
+					recordBytes = pkt_write(fp, msg, numBytes, times.time.tv_sec, times.time.tv_usec, PFBmask, PFB_MASK_SIZE, BYTE_SWAPPING);
+				}
+				if(metrics != NULL){
+					mx_write_done(metrics, &writeStart);
+					if(!rawCapture && (numBytes >= 12)){
+						metrics->hitsKept += (recordBytes - 24) / 8;
+						metrics->hitsMasked += (numBytes - 12) / 8 - (recordBytes - 24) / 8;
 					}
 				}
+				
+				
 			}
 		}
 		if(writing && (crudeoutput == 0)){
@@ -794,12 +927,16 @@ int main (int argc, const char * argv[]) {
 				// printf("Number of files written: %i\n", (numfilecounter+1)  );
 				printf("Since execution: %i files written\n", numfilecounter); 
 			}
-			fclose(fp);
 			numfilecounter++;
-			sprintf(fileheader2, "%s_%i.dat", fileheader, numfilecounter);
-			fp = fopen(fileheader2, "wb");
-			if(fp == NULL){
-				printf("Could not open file %s.\n", fileheader2);
+			if(metrics != NULL){
+				metrics->rotations++;
+			}
+			if(rawCapture){
+				if(!raw_next_file(&capture)){
+					quit();
+				}
+			}
+			else if((fp = rot_swap(&fileRotator)) == NULL){
 				quit();
 			}
 		}
@@ -810,14 +947,61 @@ int main (int argc, const char * argv[]) {
 
 
 
+/* SIGINT, SIGHUP, SIGQUIT and the 9 key; the receive loop does the shutting down */
+void requestQuit()
+{
+	quitRequested = 1;
+}
+
 void quit(){
 	char fakeudpPID[100];
 	FILE *fpToWrite;
 	int j;
 
-	if(writing && (fp != NULL)){
+	if(receiveQueues > 1){
+		mq_stop();
+	}
+	if(streamConfig != NULL){
+		ms_stop();
+	}
+	if(rotating){
+		rotating = 0;
+		rot_stop(&fileRotator);
+	}
+	else if(rawCapture){
+		rawCapture = 0;
+		raw_stop(&capture);
+	}
+	else if(writing && (fp != NULL)){
 		fclose(fp);
 	}
+	if(assembling){
+		assembling = 0;
+		if(verboseflag == 1){
+			printf("Spectra assembled: %llu (%llu incomplete), packets dropped: %llu\n",
+				(unsigned long long)spectrumAssembler.delivered, (unsigned long long)spectrumAssembler.incomplete,
+				(unsigned long long)spectrumAssembler.dropped);
+		}
+		asm_destroy(&spectrumAssembler);
+	}
+	if(sharedMemory){
+		sharedMemory = 0;
+		shm_pub_close(&publisher);
+	}
+	if(channelInterval){
+		channelInterval = 0;
+		chs_close(&channelStats);
+	}
+	if(replayPrefix != NULL){
+		replay_report(stdout, &player);
+		replay_close(&player);
+		replayPrefix = NULL;
+	}
+	if(seqTracker.stats.packets > 0){
+		seq_finish(&seqTracker);
+		fprintf(stderr, "Final counts: ");
+		seq_print(stderr, &seqTracker.stats);
+	}
 	if(testMode == 2){
 		fpToWrite = fopen("/tmp/fakeudpPID", "rt");
 		if(fpToWrite == NULL){
@@ -838,15 +1022,173 @@ void quit(){
 		}
 	}
 
-	/*  To be used if malloc becomes implemented
-	free(hitbins);
-	free(hitpowers);
-	*/
+	if(spectrum != NULL){
+		spec_put(&spectrumPool, spectrum);
+		spectrum = NULL;
+		spec_pool_destroy(&spectrumPool);
+	}
+	free(PFBmask);
+	PFBmask = NULL;
+	mx_stop();
 
 	exit(0);	
 }
 
 
+/* Left edge of a PFB bin (rotated) on the plot's x axis */
+double coarsePosition(int pfbBin)
+{
+	if(domainBin){
+		return ((double) pfbBin)-0.5;
+	}
+	else if(domainAdjustedFrequency){
+		return (((double) pfbBin)-0.5) / 20.48 - 100.0 + (double)frequencyCenter;
+	}
+	printf("Internal error: No domain preference.\n");
+	return (((double) pfbBin) - 0.5) * 32768.0;
+}
+
+/* Position of an absolute fine bin on the plot's x axis */
+double hitPosition(double actualBin)
+{
+	if(domainBin){
+		return actualBin / 32768.0 - 0.5;
+	}
+	else if(domainAdjustedFrequency){
+		return actualBin / 671088.64 - 100.0 - 0.0244140625 + (double)frequencyCenter;
+	}
+	printf("Internal error: No domain preference.\n");
+	return actualBin;
+}
+
+/* Called by the assembler with every finished spectrum, bins in order */
+void deliverSpectrum(const asmspectrum *s, void *arg)
+{
+	FILE *fpToWrite;
+	int pktcountLeft = 0, pktcountRight = 0, totalHits = 0;
+	int bin, index, actualBin, j, kept;
+	unsigned int hit;
+	uint32_t keptBin[MAX_BIN_HITS], keptPower[MAX_BIN_HITS];
+	pyramid *frame;
+
+	/* live viewers get the masked hits in raw units */
+	if(sharedMemory){
+		for(bin = 0; bin < ASM_NUM_BINS; bin++){
+			if(!(s->present[bin >> 6] & (((uint64_t)1) << (bin & 63)))){
+				continue;
+			}
+			shm_pub_bin(&publisher, bin, s->meanPower[bin], s->firstPacket.tv_sec, s->firstPacket.tv_usec);
+			for(index = 0; index < s->hitCount[bin]; index++){
+				hit = s->hitStart[bin] + index;
+				actualBin = (((s->hitBin[hit] + 16384) % 32768) + 32768*bin);
+				if(PFBmask[(int)(actualBin*(double)PFB_MASK_SIZE/134217728.0)]){
+					shm_pub_hit(&publisher, actualBin, s->hitPower[hit]);
+				}
+			}
+		}
+		shm_pub_publish(&publisher);
+	}
+
+	if(spectrum2 == 1){
+		/* the first spectrum is usually partial, -N writes the second */
+		spectrum2++;
+		return;
+	}
+	if(!plotting && !spectrum2){
+		return;
+	}
+	if(paused && !spectrum2){
+		return;
+	}
+
+	if(spectrum2 == 2){
+		/* the hit arrays only grow when a spectrum outgrows them */
+		if(!spec_reserve(&spectrumPool, spectrum, s->nhits)){
+			printf("Out of memory for %i hits.\n", s->nhits);
+			quit();
+		}
+
+		for(bin = 0; bin < ASM_NUM_BINS; bin++){
+			if(!(s->present[bin >> 6] & (((uint64_t)1) << (bin & 63)))){
+				continue;
+			}
+			if(bin < 2048){
+				spectrum->avgpowerLeft[pktcountLeft] = ((double) s->meanPower[bin]) / 2147483648.0;
+				spectrum->binsLeft[pktcountLeft] = coarsePosition(bin);
+				pktcountLeft++;
+			}
+			else{
+				spectrum->avgpowerRight[pktcountRight] = ((double) s->meanPower[bin]) / 2147483648.0;
+				spectrum->binsRight[pktcountRight] = coarsePosition(bin);
+				pktcountRight++;
+			}
+			for(index = 0; index < s->hitCount[bin]; index++){
+				hit = s->hitStart[bin] + index;
+				actualBin = (((s->hitBin[hit] + 16384) % 32768) + 32768*bin);
+				if(PFBmask[(int)(actualBin*(double)PFB_MASK_SIZE/134217728.0)]){
+					spectrum->hitbins[totalHits] = hitPosition(actualBin);
+					spectrum->hitpowers[totalHits] = ((double) s->hitPower[hit]) / 2147483648.0;
+					totalHits++;
+				}
+			}
+		}
+
+		//  WRITE TO FILE
+
+		fpToWrite = fopen("/tmp/receiveVectorBin","w");
+		//write bins, avgpower, hitbins, hitpowers
+		for(j=0; j<pktcountLeft-1; j++){
+			fprintf(fpToWrite, "%g\t", spectrum->binsLeft[j]);
+		}
+		for(j=0; j<pktcountRight-1; j++){
+			fprintf(fpToWrite, "%g\t", spectrum->binsRight[j]);
+		}
+		fclose(fpToWrite);
+		fpToWrite = fopen("/tmp/receiveVectorAvgPower","w");
+		for(j=0; j<pktcountLeft-1; j++){
+			fprintf(fpToWrite, "%g\t", spectrum->avgpowerLeft[j]);
+		}
+		for(j=0; j<pktcountRight-1; j++){
+			fprintf(fpToWrite, "%g\t", spectrum->avgpowerRight[j]);
+		}
+		fclose(fpToWrite);
+		fpToWrite = fopen("/tmp/receiveVectorHitBin","w");
+		for(j=0; j<totalHits; j++){
+			fprintf(fpToWrite, "%g\t", spectrum->hitbins[j]);
+		}
+		fclose(fpToWrite);
+		fpToWrite = fopen("/tmp/receiveVectorHitPower","w");
+		for(j=0; j<totalHits; j++){
+			fprintf(fpToWrite, "%g\t", spectrum->hitpowers[j]);
+		}
+		fclose(fpToWrite);
+		quit();
+	}
+
+	/* hand the spectrum to the plotting thread as a pyramid, never wait for gnuplot */
+	frame = plot_frame();
+	for(bin = 0; bin < ASM_NUM_BINS; bin++){
+		if(!(s->present[bin >> 6] & (((uint64_t)1) << (bin & 63)))){
+			continue;
+		}
+		kept = 0;
+		for(index = 0; (index < s->hitCount[bin]) && (kept < MAX_BIN_HITS); index++){
+			hit = s->hitStart[bin] + index;
+			actualBin = (((s->hitBin[hit] + 16384) % 32768) + 32768*bin);
+			if(PFBmask[(int)(actualBin*(double)PFB_MASK_SIZE/134217728.0)]){
+				keptBin[kept] = s->hitBin[hit];
+				keptPower[kept] = s->hitPower[hit];
+				kept++;
+			}
+		}
+		if(!pyr_bin(frame, bin, s->meanPower[bin], keptBin, keptPower, kept)){
+			printf("Out of memory for %i hits.\n", s->nhits);
+			quit();
+		}
+	}
+	plot_post();
+}
+
 void setTitle()
 {
 	char title[16384];
@@ -864,7 +1206,7 @@ void setTitle()
 		strcat(title, " - PAUSED, HITS OFF");
 	}
 	if(keyCommands){
-		strcat(title, "\\n(Press k to hide key commands)\\nZ: zoom default  A: auto-scale  P: previous zoom  N: next zoom  [Right Click]: zoom\\nK: toggle key commands  X: toggle pause  C: toggle hits  L: toggle log plot  9: quit\"");
+		strcat(title, "\\n(Press k to hide key commands)\\nZ: whole band  +/-: zoom in/out  Left/Right: move along  A: auto-scale  P: previous zoom  N: next zoom\\nK: toggle key commands  X: toggle pause  C: toggle hits  L: toggle log plot  9: quit\"");
 	}
 	else{
 		strcat(title, "\\n(Press k to show key commands)\"");
@@ -877,10 +1219,29 @@ void setTitle()
 void toggleHits()
 {
 	plotHits = (plotHits+1)%2;
-	setTitle();
+	plot_request(PLOT_REQ_TITLE);
 }
 
 void toggleLogPlot()
+{
+	plot_request(PLOT_REQ_LOG);
+}
+
+/* Runs on the plotting thread for requests made by the signal handlers */
+void plotService(int requests)
+{
+	if(requests & PLOT_REQ_TITLE){
+		setTitle();
+	}
+	if(requests & PLOT_REQ_ZOOM_OUT){
+		setZoomOut();
+	}
+	if(requests & PLOT_REQ_LOG){
+		setLogPlot();
+	}
+}
+
+void setLogPlot()
 {
 	static int logScaling=0;
 	char word[100];
@@ -933,16 +1294,41 @@ void toggleLogPlot()
 void toggleKeyCommands()
 {
 	keyCommands = (keyCommands+1)%2;
-	setTitle();
+	plot_request(PLOT_REQ_TITLE);
 }
 
 void togglePaused()
 {
 	paused = (paused+1)%2;
-	setTitle();
+	plot_request(PLOT_REQ_TITLE);
 }
 
 void zoomOut()
+{
+	plot_request(PLOT_REQ_ZOOM_OUT);
+}
+
+void zoomIn()
+{
+	plot_request(PLOT_REQ_ZOOM_IN);
+}
+
+void zoomOutStep()
+{
+	plot_request(PLOT_REQ_WIDEN);
+}
+
+void panLeft()
+{
+	plot_request(PLOT_REQ_LEFT);
+}
+
+void panRight()
+{
+	plot_request(PLOT_REQ_RIGHT);
+}
+
+void setZoomOut()
 {
 	if(domainBin){
 		gnuplot_cmd(h1, "set xrange [0:4096]");
@@ -985,8 +1371,40 @@ void print_usage(const char *prog_name)
         printf("                        (Default, default center 2275.)\n");
 	printf(" -port0                 Change serial port connection to the BEE2 from the\n");
 	printf("                        default port /dev/ttyS1 to /dev/ttyS0.\n");
+	printf(" -serial <device>       Talk to the BEE2 on <device> (e.g. a bee2sim pty).\n");
+	printf(" -serialtimeout <ms>    Give up on a BEE2 command after <ms> milliseconds\n");
+	printf("                        (default 1000).\n");
+	printf(" -cs <seconds>          Keep hit count, event limit saturation and mean power\n");
+	printf("                        statistics for every PFB bin and append them to\n");
+	printf("                        <file name>.chs every <seconds> seconds (see chanstats.h).\n");
 	printf(" -N                     For use from within Matlab/Octave. Write 2nd spectrum\n");
 	printf("                        to file.\n");
+	printf(" -st <seconds>          Print packet loss and BEE2 error counters to stderr every\n");
+	printf("                        <seconds> seconds (default off).\n");
+	printf(" -shm <name>            Publish the latest complete spectrum in POSIX shared memory\n");
+	printf("                        for live viewers such as shmwatch (default name\n");
+	printf("                        /seti_receive_<port>).\n");
+	printf(" -q <queues>            Receive on <queues> SO_REUSEPORT sockets, one thread pinned\n");
+	printf("                        per socket, each writing its own files <prefix>q<k>_<N>.dat\n");
+	printf("                        for the one board it serves (write mode only).\n");
+	printf(" -qbpf                  With -q, steer each packet to the socket of the CPU that\n");
+	printf("                        received it instead of the kernel's flow hash.\n");
+	printf(" -c <config file>       Receive every stream listed in <config file> (one line of\n");
+	printf("                        <ip address> <port> <file prefix> [PFB mask file] each) from\n");
+	printf("                        one event loop with shared writer threads; implies -w.\n");
+	printf(" -raw                   With -w, capture the datagrams untouched into\n");
+	printf("                        <file name>_<integer>.raw (see rawcap.h) and leave decoding\n");
+	printf("                        to rawconvert.\n");
+	printf(" -replay <prefix>       Read packets from <prefix>_<N>.raw (or .dat) files instead of\n");
+	printf("                        the network and report the throughput at the end.\n");
+	printf(" -rate <factor>         Replay pace relative to the recorded time stamps: 1 is real\n");
+	printf("                        time (default), 10 ten times faster, 0 as fast as possible.\n");
+	printf(" -metrics <port | path> Serve counters in the Prometheus text format over HTTP on\n");
+	printf("                        127.0.0.1:<port> or on the Unix socket <path> (not with -c).\n");
+	printf(" -rt <priority>         Realtime profile: lock all memory and run the receive\n");
+	printf("                        thread SCHED_FIFO at <priority> (1 to 99), see rtprof.h.\n");
+	printf(" -cpu <cpu>             Pin the receive thread to <cpu>, preferably one isolated\n");
+	printf("                        with isolcpus= (not with -q or -c).\n");
 	printf(" -h (or any other garbage) -- Get this help.\n\n");
 	printf(" ** Use file name /dev/stdout for screen output.\n");
 }  
@@ -1042,7 +1460,7 @@ void parse_args(int argc, const char** argv) {
 		}
 		else if(strcmp(argv[i], "-p") == 0){
 			i++;
-			LOCAL_SERVER_PORT = atoi(argv[i+1]);
+			LOCAL_SERVER_PORT = atoi(argv[i]);
 			if((LOCAL_SERVER_PORT <= 999) || (LOCAL_SERVER_PORT >= 62001)){
 				printf("Invalid server port. \nServer port must be a value between 1000 and 62000\n");
 				quit();
@@ -1105,6 +1523,56 @@ void parse_args(int argc, const char** argv) {
 		else if(strcmp(argv[i], "-v") == 0){
 			verboseflag = 1;
 		}
+		else if(strcmp(argv[i], "-shm") == 0){
+			sharedMemory = 1;
+			if((i+2 <= argc) && (strncmp(argv[i+1], "-", 1) != 0)){
+				snprintf(sharedMemoryName, SHM_NAME_SIZE, "%s%s", (argv[i+1][0] == '/') ? "" : "/", argv[i+1]);
+				i++;
+			}
+		}
+		else if(strcmp(argv[i], "-q") == 0){
+			i++;
+			receiveQueues = atoi(argv[i]);
+			if((receiveQueues < 1) || (receiveQueues > MQ_MAX_QUEUES)){
+				printf("Invalid number of queues. \nQueues must be within the range 1 to %i\n", MQ_MAX_QUEUES);
+				quit();
+			}
+		}
+		else if(strcmp(argv[i], "-qbpf") == 0){
+			queueSteering = 1;
+		}
+		else if(strcmp(argv[i], "-metrics") == 0){
+			i++;
+			metricsWhere = (char *)argv[i];
+		}
+		else if(strcmp(argv[i], "-replay") == 0){
+			i++;
+			replayPrefix = (char *)argv[i];
+		}
+		else if(strcmp(argv[i], "-rate") == 0){
+			i++;
+			replayRate = atof(argv[i]);
+			if(replayRate < 0.0){
+				printf("Invalid replay rate. \nThe rate must be 0 (as fast as possible) or more.\n");
+				quit();
+			}
+		}
+		else if(strcmp(argv[i], "-raw") == 0){
+			rawCapture = 1;
+		}
+		else if(strcmp(argv[i], "-c") == 0){
+			i++;
+			streamConfig = (char *)argv[i];
+			writing = 1;
+		}
+		else if(strcmp(argv[i], "-st") == 0){
+			i++;
+			statusInterval = atoi(argv[i]);
+			if(statusInterval < 0){
+				printf("Invalid status interval. \nStatus interval must be 0 (off) or a number of seconds.\n");
+				quit();
+			}
+		}
 		else if(strcmp(argv[i], "-t") == 0){
 			testMode = 1;
 		}
@@ -1115,6 +1583,42 @@ void parse_args(int argc, const char** argv) {
 		else if(strcmp(argv[i], "-port0") == 0){
 			strcpy(port, "/dev/ttyS0");
 		}
+		else if(strcmp(argv[i], "-rt") == 0){
+			i++;
+			realtime.priority = atoi(argv[i]);
+			if((realtime.priority < 1) || (realtime.priority > 99)){
+				printf("Invalid realtime priority. \nThe priority must be in range [1, 99].\n");
+				quit();
+			}
+		}
+		else if(strcmp(argv[i], "-cpu") == 0){
+			i++;
+			realtime.cpu = atoi(argv[i]);
+			if(realtime.cpu < 0){
+				printf("Invalid CPU number.\n");
+				quit();
+			}
+		}
+		else if(strcmp(argv[i], "-cs") == 0){
+			i++;
+			channelInterval = atoi(argv[i]);
+			if(channelInterval < 1){
+				printf("Invalid statistics interval. \nThe interval must be at least 1 second.\n");
+				quit();
+			}
+		}
+		else if(strcmp(argv[i], "-serial") == 0){
+			i++;
+			strncpy(port, argv[i], sizeof(port)-1);
+		}
+		else if(strcmp(argv[i], "-serialtimeout") == 0){
+			i++;
+			serialTimeout = atoi(argv[i]);
+			if(serialTimeout < 1){
+				printf("Invalid serial timeout. \nThe timeout must be at least 1 ms.\n");
+				quit();
+			}
+		}
 		else{
 			print_usage(argv[0]);
 			printf("%i, %i\n", plotting, writing);
@@ -1133,21 +1637,3 @@ int endianSwap32(int x)
 	swapped[3] = pointer[0];
 	return *(int *)swapped;
 }
-
-int searchForPercent(int fd)
-{
-	char ch;
-	int percentSignCounter = 640;
-	int connectionCounter = 1000000;
-	do{
-		if(read(fd, &ch, 1)!=-1){
-			percentSignCounter--;
-			connectionCounter = 1000000;
-		}
-		else{
-			connectionCounter--;
-		}
-	}while(connectionCounter && percentSignCounter && (ch != '%'));
-	if(connectionCounter && percentSignCounter) return 1;
-	else return 0;
-}
@@ -0,0 +1,212 @@
+/*
+Packet Replay v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+See replay.h.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "replay.h"
+#include "rawcap.h"
+
+#define REPLAY_BUFFER_SIZE (1 << 20)
+
+static unsigned int swap32(unsigned int x)
+{
+	return ((x & 0x000000FF) << 24) | ((x & 0x0000FF00) << 8) |
+	       ((x & 0x00FF0000) >> 8)  | ((x & 0xFF000000) >> 24);
+}
+
+static double seconds(const struct timeval *t)
+{
+	return t->tv_sec + t->tv_usec / 1000000.0;
+}
+
+static int open_file(replay *r)
+{
+	char name[REPLAY_NAME_SIZE + 32];
+
+	snprintf(name, sizeof(name), "%s_%i.%s", r->prefix, r->index, r->raw ? "raw" : "dat");
+	r->in = fopen(name, "rb");
+	if(r->in == NULL){
+		return 0;
+	}
+	setvbuf(r->in, NULL, _IOFBF, REPLAY_BUFFER_SIZE);
+	r->blockUsed = 0;
+	r->offset = 0;
+	return 1;
+}
+
+/* Moves on to the next file; returns 0 when there is none */
+static int next_file(replay *r)
+{
+	if(r->in != NULL){
+		fclose(r->in);
+		r->in = NULL;
+	}
+	r->index++;
+	return open_file(r);
+}
+
+/* Reads one record into msg; returns its length, REPLAY_END at the end of the file, -1 if it is damaged */
+static int read_dat(replay *r, char *msg, int maxBytes, int *sec, int *usec)
+{
+	int header[3], i;
+	unsigned int word;
+
+	if(fread(header, sizeof(int), 3, r->in) != 3){
+		return REPLAY_END;
+	}
+	if((header[0] < 12) || (header[0] > maxBytes) || (header[0] % 4)){
+		return -1;
+	}
+	if(fread(msg, 1, header[0], r->in) != header[0]){
+		return REPLAY_END;
+	}
+	if(r->swap){
+		for(i=0; i<header[0]; i+=4){
+			memcpy(&word, msg + i, 4);
+			word = swap32(word);
+			memcpy(msg + i, &word, 4);
+		}
+	}
+	*sec = header[1];
+	*usec = header[2];
+	return header[0];
+}
+
+/* As read_dat(); a captured datagram may be empty, so its length may be 0 */
+static int read_raw(replay *r, char *msg, int maxBytes, int *sec, int *usec)
+{
+	uint32_t record[3];
+	int used;
+
+	while(r->offset + RAW_RECORD_HEADER > r->blockUsed){
+		used = raw_read_block(r->in, r->block);
+		if(used == 0){
+			return REPLAY_END;
+		}
+		if(used < 0){
+			return -1;
+		}
+		r->blockUsed = used;
+		r->offset = RAW_BLOCK_HEADER;
+	}
+	memcpy(record, r->block + r->offset, RAW_RECORD_HEADER);
+	if((record[0] > maxBytes) || (r->offset + RAW_RECORD_HEADER + record[0] > r->blockUsed)){
+		return -1;
+	}
+	memcpy(msg, r->block + r->offset + RAW_RECORD_HEADER, record[0]);
+	r->offset += RAW_RECORD_HEADER + ((record[0] + 3) & ~3);
+	*sec = record[1];
+	*usec = record[2];
+	return record[0];
+}
+
+/* Opens <prefix>_1.raw, or <prefix>_1.dat if there is no raw capture; returns 0 if neither exists */
+int replay_open(replay *r, const char *prefix, double rate, int swap)
+{
+	memset(r, 0, sizeof(replay));
+	strncpy(r->prefix, prefix, REPLAY_NAME_SIZE-1);
+	r->rate = rate;
+	r->swap = swap;
+	r->index = 1;
+	r->raw = 1;
+	if(!open_file(r)){
+		r->raw = 0;
+		if(!open_file(r)){
+			printf("Could not find %s_1.raw or %s_1.dat.\n", prefix, prefix);
+			return 0;
+		}
+	}
+	if(r->raw){
+		r->block = (char *)malloc(RAW_BLOCK_SIZE);
+		if(r->block == NULL){
+			printf("Out of memory.\n");
+			fclose(r->in);
+			r->in = NULL;
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* Waits until the next packet is due and copies it to msg; returns its length, REPLAY_END when the recording ends */
+int replay_next(replay *r, char *msg, int maxBytes, int *sec, int *usec)
+{
+	struct timeval now;
+	double due, late;
+	int numBytes;
+
+	while(1){
+		if(r->in == NULL){
+			return REPLAY_END;
+		}
+		if(r->raw){
+			numBytes = read_raw(r, msg, maxBytes, sec, usec);
+		}
+		else{
+			numBytes = read_dat(r, msg, maxBytes, sec, usec);
+		}
+		if(numBytes >= 0){
+			break;
+		}
+		if(numBytes == -1){
+			printf("%s_%i.%s is damaged, skipping the rest of it.\n", r->prefix, r->index, r->raw ? "raw" : "dat");
+		}
+		if(!next_file(r)){
+			gettimeofday(&r->endTime, NULL);
+			return REPLAY_END;
+		}
+	}
+
+	if(!r->started){
+		r->started = 1;
+		r->firstStamp = *sec + *usec / 1000000.0;
+		gettimeofday(&r->startTime, NULL);
+	}
+	else if(r->rate > 0.0){
+		due = (*sec + *usec / 1000000.0 - r->firstStamp) / r->rate;
+		gettimeofday(&now, NULL);
+		late = seconds(&now) - seconds(&r->startTime);
+		if(due - late > 0.0005){
+			usleep((useconds_t)((due - late) * 1000000.0));
+		}
+	}
+	r->packets++;
+	r->bytes += numBytes;
+	return numBytes;
+}
+
+void replay_report(FILE *out, replay *r)
+{
+	double elapsed;
+
+	if(!r->started){
+		return;
+	}
+	if(r->endTime.tv_sec == 0){
+		gettimeofday(&r->endTime, NULL);
+	}
+	elapsed = seconds(&r->endTime) - seconds(&r->startTime);
+	if(elapsed <= 0.0){
+		elapsed = 1e-6;
+	}
+	fprintf(out, "Replayed %llu packets, %llu bytes from %i %s files in %.3f s: %.0f packets/s, %.1f MB/s\n",
+		r->packets, r->bytes, (r->in == NULL) ? r->index-1 : r->index, r->raw ? "raw" : "dat", elapsed,
+		r->packets / elapsed, r->bytes / elapsed / 1e6);
+}
+
+void replay_close(replay *r)
+{
+	if(r->in != NULL){
+		fclose(r->in);
+		r->in = NULL;
+	}
+	free(r->block);
+	r->block = NULL;
+}
@@ -0,0 +1,50 @@
+/*
+Packet Replay v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+Feeds recorded packets to receive in place of the socket.  The source is a set
+of <prefix>_<N>.raw captures (receive -w -raw) if <prefix>_1.raw exists,
+otherwise <prefix>_<N>.dat files; files are read in order until the next one
+cannot be found.  Records from .dat files are turned back into the datagram the
+BEE2 sent (byte order restored; masked hits are of course gone).
+
+Packets are released at the pace of their recorded time stamps scaled by the
+rate: 1 is real time, 10 is ten times real time and 0 is as fast as possible.
+*/
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+#define REPLAY_NAME_SIZE 256
+#define REPLAY_END       (-2)           /* no more packets; 0 is an empty datagram */
+
+typedef struct replay_s {
+	char prefix[REPLAY_NAME_SIZE];
+	int raw;                        /* reading .raw captures */
+	int index;                      /* file being read */
+	FILE *in;
+	char *block;                    /* current .raw block */
+	uint32_t blockUsed;
+	uint32_t offset;
+	double rate;
+	int swap;                       /* .dat words need swapping back to network order */
+	int started;
+	double firstStamp;
+	struct timeval startTime;
+	struct timeval endTime;
+	unsigned long long packets;
+	unsigned long long bytes;
+} replay;
+
+int replay_open(replay *r, const char *prefix, double rate, int swap);
+int replay_next(replay *r, char *msg, int maxBytes, int *sec, int *usec);
+void replay_report(FILE *out, replay *r);
+void replay_close(replay *r);
+
+#endif
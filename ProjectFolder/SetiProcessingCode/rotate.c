@@ -0,0 +1,193 @@
+/*
+File Rotation v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+See rotate.h.  Preallocation uses fallocate() with FALLOC_FL_KEEP_SIZE so a file
+that is still being written (or never used) never shows a tail of zeros to the
+analysis code; the unused blocks are released by the ftruncate() at close.
+*/
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <linux/falloc.h>
+#include "rotate.h"
+#include "specpool.h"
+
+static int open_file(rotfile *f, const char *prefix, int index, long long preallocBytes)
+{
+	snprintf(f->name, ROT_NAME_SIZE, "%s_%i.dat", prefix, index);
+	f->fp = fopen(f->name, "wb");
+	if(f->fp == NULL){
+		return 0;
+	}
+	if(preallocBytes > 0){
+		/* best effort, not every filesystem supports it */
+		fallocate(fileno(f->fp), FALLOC_FL_KEEP_SIZE, 0, preallocBytes);
+	}
+	/* on huge pages when there are any, so the stdio buffer costs one TLB entry */
+	f->bufferBytes = ROT_BUFFER_SIZE;
+	f->buffer = (char *)spec_alloc(&f->bufferBytes, &f->huge);
+	if(f->buffer != NULL){
+		setvbuf(f->fp, f->buffer, _IOFBF, ROT_BUFFER_SIZE);
+	}
+	return 1;
+}
+
+/* Returns the number of bytes written to the file */
+static long long close_file(rotfile *f)
+{
+	long long size;
+
+	fflush(f->fp);
+	size = ftell(f->fp);
+	if(size >= 0){
+		ftruncate(fileno(f->fp), size);
+	}
+	fclose(f->fp);
+	spec_free(f->buffer, f->bufferBytes);
+	f->fp = NULL;
+	f->buffer = NULL;
+	return size;
+}
+
+static void *rotation_thread(void *arg)
+{
+	rotator *r = (rotator *)arg;
+	rotfile f;
+	long long size;
+	int index;
+	sigset_t all;
+
+	/* signal handlers run on the receive thread */
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, NULL);
+
+	pthread_mutex_lock(&r->lock);
+	while(1){
+		if(r->nclosing > 0){
+			f = r->closing[--r->nclosing];
+			pthread_mutex_unlock(&r->lock);
+			size = close_file(&f);
+			pthread_mutex_lock(&r->lock);
+			if(size > 0){
+				r->preallocBytes = size;
+			}
+		}
+		else if(r->stop){
+			break;
+		}
+		else if((r->next.fp == NULL) && !r->failed && (r->nextIndex <= r->lastIndex)){
+			index = r->nextIndex;
+			size = r->preallocBytes;
+			pthread_mutex_unlock(&r->lock);
+			memset(&f, 0, sizeof(f));
+			if(!open_file(&f, r->prefix, index, size)){
+				printf("Could not open file %s.\n", f.name);
+			}
+			pthread_mutex_lock(&r->lock);
+			if(f.fp == NULL){
+				r->failed = 1;
+			}
+			r->next = f;
+			pthread_cond_broadcast(&r->cond);
+		}
+		else{
+			pthread_cond_wait(&r->cond, &r->lock);
+		}
+	}
+	pthread_mutex_unlock(&r->lock);
+	return NULL;
+}
+
+/* Opens <prefix>_<firstIndex>.dat and starts preparing the files after it.  Returns NULL on failure. */
+FILE *rot_start(rotator *r, const char *prefix, int firstIndex, int lastIndex, long long preallocBytes)
+{
+	memset(r, 0, sizeof(rotator));
+	strncpy(r->prefix, prefix, ROT_NAME_SIZE-1);
+	r->lastIndex = lastIndex;
+	r->preallocBytes = preallocBytes;
+
+	if(!open_file(&r->current, prefix, firstIndex, preallocBytes)){
+		printf("Could not open file %s.\n", r->current.name);
+		return NULL;
+	}
+	r->nextIndex = firstIndex + 1;
+
+	pthread_mutex_init(&r->lock, NULL);
+	pthread_cond_init(&r->cond, NULL);
+	if(pthread_create(&r->thread, NULL, rotation_thread, r) == 0){
+		r->running = 1;
+	}
+	else{
+		printf("Warning: could not start file rotation thread, files will be opened synchronously.\n");
+	}
+	return r->current.fp;
+}
+
+/* Hands the current file to the background thread and returns the next one, NULL on failure */
+FILE *rot_swap(rotator *r)
+{
+	rotfile old;
+
+	if(!r->running){
+		close_file(&r->current);
+		if(!open_file(&r->current, r->prefix, r->nextIndex++, r->preallocBytes)){
+			printf("Could not open file %s.\n", r->current.name);
+			return NULL;
+		}
+		r->rotations++;
+		return r->current.fp;
+	}
+
+	pthread_mutex_lock(&r->lock);
+	while((r->next.fp == NULL) && !r->failed && (r->nextIndex <= r->lastIndex)){
+		pthread_cond_wait(&r->cond, &r->lock);
+	}
+	if(r->next.fp == NULL){
+		pthread_mutex_unlock(&r->lock);
+		return NULL;
+	}
+	old = r->current;
+	r->current = r->next;
+	memset(&r->next, 0, sizeof(rotfile));
+	r->nextIndex++;
+	r->rotations++;
+	if(r->nclosing < ROT_CLOSE_QUEUE){
+		r->closing[r->nclosing++] = old;
+		old.fp = NULL;
+	}
+	pthread_cond_broadcast(&r->cond);
+	pthread_mutex_unlock(&r->lock);
+
+	if(old.fp != NULL){
+		/* close queue full, the disk is not keeping up anyway */
+		close_file(&old);
+	}
+	return r->current.fp;
+}
+
+/* Closes every file and removes the prepared file that was never written */
+void rot_stop(rotator *r)
+{
+	if(r->running){
+		pthread_mutex_lock(&r->lock);
+		r->stop = 1;
+		pthread_cond_broadcast(&r->cond);
+		pthread_mutex_unlock(&r->lock);
+		pthread_join(r->thread, NULL);
+		r->running = 0;
+	}
+	if(r->current.fp != NULL){
+		close_file(&r->current);
+	}
+	if(r->next.fp != NULL){
+		close_file(&r->next);
+		unlink(r->next.name);
+	}
+}
@@ -0,0 +1,52 @@
+/*
+File Rotation v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+Keeps the next <prefix>_<N>.dat open and preallocated before it is needed, so
+switching files at a spectrum boundary is a pointer swap in the receive thread.
+Opening, preallocating, flushing and closing all happen on a background thread.
+*/
+
+#ifndef ROTATE_H
+#define ROTATE_H
+
+#include <stdio.h>
+#include <pthread.h>
+
+#define ROT_CLOSE_QUEUE   8
+#define ROT_BUFFER_SIZE   (1 << 20)
+#define ROT_NAME_SIZE     256
+
+typedef struct rotfile_s {
+	FILE *fp;
+	char *buffer;
+	size_t bufferBytes;
+	int huge;                   /* buffer is on huge pages */
+	char name[ROT_NAME_SIZE];
+} rotfile;
+
+typedef struct rotator_s {
+	char prefix[ROT_NAME_SIZE];
+	int nextIndex;              /* index of the file being prepared */
+	int lastIndex;              /* never prepare past this file */
+	long long preallocBytes;    /* becomes the size of the last closed file */
+	rotfile current;
+	rotfile next;               /* next.fp is NULL until the thread has it ready */
+	rotfile closing[ROT_CLOSE_QUEUE];
+	int nclosing;
+	int failed;
+	int stop;
+	int running;
+	int rotations;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+} rotator;
+
+FILE *rot_start(rotator *r, const char *prefix, int firstIndex, int lastIndex, long long preallocBytes);
+FILE *rot_swap(rotator *r);
+void rot_stop(rotator *r);
+
+#endif
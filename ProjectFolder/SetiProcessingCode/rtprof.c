@@ -0,0 +1,171 @@
+/*
+Realtime Profile v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+See rtprof.h.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include "rtprof.h"
+
+/* Faults in the stack the receive loop will grow into, while that is still cheap */
+static void prefault_stack()
+{
+	volatile char stack[RT_STACK_PREFAULT];
+
+	memset((char *)stack, 0, sizeof(stack));
+}
+
+/* Whether cpu appears in a kernel CPU list such as "1-3,6"; counts the CPUs listed */
+static int cpu_listed(const char *list, int cpu, int *count)
+{
+	const char *p = list;
+	char *end;
+	long first, last;
+	int found = 0;
+
+	*count = 0;
+	while(*p != '\0'){
+		first = strtol(p, &end, 10);
+		if(end == p){
+			break;
+		}
+		last = first;
+		p = end;
+		if(*p == '-'){
+			last = strtol(p+1, &end, 10);
+			p = end;
+		}
+		*count += last - first + 1;
+		if((cpu >= first) && (cpu <= last)){
+			found = 1;
+		}
+		if(*p == ','){
+			p++;
+		}
+	}
+	return found;
+}
+
+/* Makes each setting asked for and checks it took; returns the number that could not be obtained */
+int rt_apply(rtprofile *rt)
+{
+	struct sched_param param;
+	struct rlimit limit;
+	cpu_set_t cpus;
+	char list[1024];
+	FILE *f;
+	int policy, failures = 0;
+
+	rt->memoryLocked = 0;
+	rt->priorityGranted = 0;
+	rt->cpuPinned = 0;
+	rt->cpuIsolated = 0;
+	rt->isolatedCPUs = 0;
+
+	if(rt->priority > 0){
+		if(mlockall(MCL_CURRENT | MCL_FUTURE) == 0){
+			rt->memoryLocked = 1;
+			prefault_stack();
+		}
+		else{
+			if(getrlimit(RLIMIT_MEMLOCK, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY){
+				printf("Realtime: could not lock memory (%s, locked memory limit %llu kB).\n", strerror(errno), (unsigned long long)limit.rlim_cur / 1024);
+			}
+			else{
+				printf("Realtime: could not lock memory (%s).\n", strerror(errno));
+			}
+			failures++;
+		}
+
+		if(rt->priority < sched_get_priority_min(SCHED_FIFO)){
+			rt->priority = sched_get_priority_min(SCHED_FIFO);
+		}
+		if(rt->priority > sched_get_priority_max(SCHED_FIFO)){
+			rt->priority = sched_get_priority_max(SCHED_FIFO);
+		}
+		param.sched_priority = rt->priority;
+		errno = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+		if(errno != 0){
+			printf("Realtime: could not run SCHED_FIFO at priority %i (%s).\n", rt->priority, strerror(errno));
+		}
+		if((pthread_getschedparam(pthread_self(), &policy, &param) == 0) && (policy == SCHED_FIFO)){
+			rt->priorityGranted = param.sched_priority;
+		}
+		if(rt->priorityGranted != rt->priority){
+			failures++;
+		}
+	}
+
+	if(rt->cpu >= CPU_SETSIZE){
+		printf("Realtime: there is no CPU %i.\n", rt->cpu);
+		failures++;
+	}
+	else if(rt->cpu >= 0){
+		CPU_ZERO(&cpus);
+		CPU_SET(rt->cpu, &cpus);
+		errno = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+		if(errno != 0){
+			printf("Realtime: could not pin to CPU %i (%s).\n", rt->cpu, strerror(errno));
+		}
+		CPU_ZERO(&cpus);
+		if((pthread_getaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0) && CPU_ISSET(rt->cpu, &cpus) && (CPU_COUNT(&cpus) == 1)){
+			rt->cpuPinned = 1;
+		}
+		else{
+			failures++;
+		}
+
+		list[0] = '\0';
+		f = fopen("/sys/devices/system/cpu/isolated", "r");
+		if(f != NULL){
+			if(fgets(list, sizeof(list), f) == NULL){
+				list[0] = '\0';
+			}
+			fclose(f);
+		}
+		rt->cpuIsolated = cpu_listed(list, rt->cpu, &rt->isolatedCPUs);
+		if(!rt->cpuIsolated){
+			/* pinned or not, the scheduler will still put other work there */
+			if(rt->isolatedCPUs > 0){
+				printf("Realtime: CPU %i is not isolated, the isolated CPUs are %s", rt->cpu, list);
+			}
+			else{
+				printf("Realtime: CPU %i is not isolated (no CPUs are, see isolcpus= on the kernel command line).\n", rt->cpu);
+			}
+			failures++;
+		}
+	}
+	return failures;
+}
+
+void rt_report(FILE *out, const rtprofile *rt)
+{
+	fprintf(out, "Realtime profile:");
+	if(rt->priority > 0){
+		fprintf(out, " memory %slocked,", rt->memoryLocked ? "" : "not ");
+		if(rt->priorityGranted > 0){
+			fprintf(out, " SCHED_FIFO priority %i,", rt->priorityGranted);
+		}
+		else{
+			fprintf(out, " normal scheduling,");
+		}
+	}
+	if(rt->cpu >= 0){
+		fprintf(out, " %s CPU %i (%sisolated)", rt->cpuPinned ? "pinned to" : "not pinned to", rt->cpu, rt->cpuIsolated ? "" : "not ");
+	}
+	else{
+		fprintf(out, " not pinned");
+	}
+	fprintf(out, "\n");
+}
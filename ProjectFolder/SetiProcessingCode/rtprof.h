@@ -0,0 +1,48 @@
+/*
+Realtime Profile v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+Keeps the receive thread from being paged or preempted during long captures:
+all memory of the process is locked (mlockall, current and future mappings) and
+the stack the thread will use is touched once, the thread runs SCHED_FIFO at the
+priority asked for, and it can be pinned to one CPU, ideally one the kernel was
+told to keep free (isolcpus=, listed in /sys/devices/system/cpu/isolated).
+
+Every setting is read back after it is made.  Whatever could not be obtained
+(usually for lack of CAP_IPC_LOCK / CAP_SYS_NICE or a small RLIMIT_MEMLOCK) is
+printed and the capture goes on without it.
+
+Threads inherit the policy and affinity of the thread that creates them, so
+rt_apply() must be called after the helper threads (plotting, file rotation,
+raw capture, metrics) are running.
+
+Emails/Sample Seti Software/read_seti4.c, the JPL reader for the same BEE2, has
+the same exposure: a malloc'd payload buffer and a recvfrom() loop at normal
+priority.  It is a reference copy that needs setispec.h, casper.h and grace_np
+from the JPL tree and is not built here, so the profile is applied in receive
+only.
+*/
+
+#ifndef RTPROF_H
+#define RTPROF_H
+
+#include <stdio.h>
+
+#define RT_STACK_PREFAULT  (512 * 1024)
+
+typedef struct rtprofile_s {
+	int priority;               /* SCHED_FIFO priority asked for, 0 leaves scheduling alone */
+	int cpu;                    /* CPU asked for, -1 for none */
+	int memoryLocked;
+	int priorityGranted;        /* SCHED_FIFO priority the thread runs at, 0 if none */
+	int cpuPinned;
+	int cpuIsolated;
+	int isolatedCPUs;           /* CPUs listed in /sys/devices/system/cpu/isolated */
+} rtprofile;
+
+int rt_apply(rtprofile *rt);
+void rt_report(FILE *out, const rtprofile *rt);
+
+#endif
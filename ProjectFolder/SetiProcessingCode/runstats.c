@@ -0,0 +1,215 @@
+/*
+Run Statistics v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+See runstats.h.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "runstats.h"
+
+const double rsLevels[RS_QUANTILES] = { 0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99 };
+
+static void quantity_init(rsquantity *x)
+{
+	x->count = 0;
+	x->mean = 0;
+	x->m2 = 0;
+	td_init(&x->digest);
+}
+
+static inline void quantity_add(rsquantity *x, double value)
+{
+	double delta = value - x->mean;
+
+	x->count++;
+	x->mean += delta / x->count;
+	x->m2 += delta * (value - x->mean);
+	td_add(&x->digest, value, 1.0);
+}
+
+static void quantity_merge(rsquantity *into, const rsquantity *from)
+{
+	double delta, count;
+
+	if(from->count == 0){
+		return;
+	}
+	count = (double)into->count + from->count;
+	delta = from->mean - into->mean;
+	into->mean += delta * from->count / count;
+	into->m2 += from->m2 + delta * delta * ((double)into->count * from->count / count);
+	into->count += from->count;
+	td_merge(&into->digest, &from->digest);
+}
+
+void rs_init(runstats *s)
+{
+	int i;
+
+	s->packets = 0;
+	s->hits = 0;
+	s->firstTime = INT64_MAX;
+	s->lastTime = INT64_MIN;
+	for(i=0; i<RS_CHANNELS; i++){
+		quantity_init(&s->channels[i].meanPower);
+		quantity_init(&s->channels[i].hitPower);
+	}
+}
+
+void rs_record(runstats *s, const datrecord *r)
+{
+	rschannel *c;
+	int64_t time;
+	uint32_t j;
+
+	if(r->pfbBin >= RS_CHANNELS){
+		return;
+	}
+	c = &s->channels[(r->pfbBin + 2048) % 4096];
+	time = (int64_t)r->sec * 1000000 + r->usec;
+	if(time < s->firstTime){
+		s->firstTime = time;
+	}
+	if(time > s->lastTime){
+		s->lastTime = time;
+	}
+	quantity_add(&c->meanPower, r->meanPower);
+	for(j=0; j<r->nhits; j++){
+		quantity_add(&c->hitPower, dat_hit_power(r, j));
+	}
+	s->packets++;
+	s->hits += r->nhits;
+}
+
+void rs_merge(runstats *into, const runstats *from)
+{
+	int i;
+
+	if(from->packets == 0){
+		return;
+	}
+	for(i=0; i<RS_CHANNELS; i++){
+		quantity_merge(&into->channels[i].meanPower, &from->channels[i].meanPower);
+		quantity_merge(&into->channels[i].hitPower, &from->channels[i].hitPower);
+	}
+	into->packets += from->packets;
+	into->hits += from->hits;
+	if(from->firstTime < into->firstTime){
+		into->firstTime = from->firstTime;
+	}
+	if(from->lastTime > into->lastTime){
+		into->lastTime = from->lastTime;
+	}
+}
+
+/* The results for one quantity as rs_write() stores them */
+void rs_entry(rsquantity *x, rsentry *e)
+{
+	int i;
+
+	memset(e, 0, sizeof(rsentry));
+	if(x->count == 0){
+		return;
+	}
+	e->count = x->count;
+	e->mean = x->mean;
+	e->variance = (x->count > 1) ? x->m2 / (x->count - 1) : 0;
+	e->min = x->digest.min;
+	e->max = x->digest.max;
+	for(i=0; i<RS_QUANTILES; i++){
+		e->quantiles[i] = td_quantile(&x->digest, rsLevels[i]);
+	}
+}
+
+/* Written beside path and renamed into place; returns 0 if it could not be written */
+int rs_write(runstats *s, const char *path)
+{
+	char temporary[4096];
+	rsheader h;
+	rsentry e;
+	FILE *f;
+	int i, ok;
+
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, RS_MAGIC, sizeof(h.magic));
+	h.version = RS_VERSION;
+	h.channels = RS_CHANNELS;
+	h.quantiles = RS_QUANTILES;
+	memcpy(h.levels, rsLevels, sizeof(h.levels));
+	h.packets = s->packets;
+	h.hits = s->hits;
+	if(s->packets > 0){
+		h.firstTime = s->firstTime;
+		h.lastTime = s->lastTime;
+	}
+
+	snprintf(temporary, sizeof(temporary), "%s.%i.tmp", path, (int)getpid());
+	f = fopen(temporary, "wb");
+	if(f == NULL){
+		return 0;
+	}
+	ok = (fwrite(&h, sizeof(h), 1, f) == 1);
+	for(i=0; ok && (i<RS_CHANNELS); i++){
+		rs_entry(&s->channels[i].meanPower, &e);
+		ok = (fwrite(&e, sizeof(e), 1, f) == 1);
+		if(ok){
+			rs_entry(&s->channels[i].hitPower, &e);
+			ok = (fwrite(&e, sizeof(e), 1, f) == 1);
+		}
+	}
+	if(fclose(f) != 0){
+		ok = 0;
+	}
+	if(!ok || (rename(temporary, path) != 0)){
+		unlink(temporary);
+		return 0;
+	}
+	return 1;
+}
+
+int rs_summary(runstats *s, const char *path)
+{
+	rsentry p, h;
+	FILE *f;
+	int i, ok;
+
+	f = fopen(path, "w");
+	if(f == NULL){
+		return 0;
+	}
+	fprintf(f, "# %llu packets, %llu hits", (unsigned long long)s->packets, (unsigned long long)s->hits);
+	if(s->packets > 0){
+		fprintf(f, ", %lli.%06lli to %lli.%06lli", (long long)(s->firstTime / 1000000), (long long)(s->firstTime % 1000000),
+			(long long)(s->lastTime / 1000000), (long long)(s->lastTime % 1000000));
+	}
+	fprintf(f, "\n# powers as received; sd is the sample standard deviation, p1/p50/p99 are approximate\n");
+	fprintf(f, "# coarse packets mean_power sd min p1 p50 p99 max hits hit_power sd min p1 p50 p99 max\n");
+	for(i=0; i<RS_CHANNELS; i++){
+		if(s->channels[i].meanPower.count == 0){
+			continue;
+		}
+		rs_entry(&s->channels[i].meanPower, &p);
+		rs_entry(&s->channels[i].hitPower, &h);
+		fprintf(f, "%i %llu %.1f %.1f %.0f %.1f %.1f %.1f %.0f", i, (unsigned long long)p.count,
+			p.mean, sqrt(p.variance), p.min, p.quantiles[0], p.quantiles[3], p.quantiles[6], p.max);
+		if(h.count == 0){
+			fprintf(f, " 0 - - - - - - -\n");
+		}
+		else{
+			fprintf(f, " %llu %.1f %.1f %.0f %.1f %.1f %.1f %.0f\n", (unsigned long long)h.count,
+				h.mean, sqrt(h.variance), h.min, h.quantiles[0], h.quantiles[3], h.quantiles[6], h.max);
+		}
+	}
+	ok = !ferror(f);
+	if(fclose(f) != 0){
+		ok = 0;
+	}
+	return ok;
+}
@@ -0,0 +1,91 @@
+/*
+Run Statistics v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+Statistics of a whole run by coarse channel (the PFB bin after the +2048
+rotation, so channels are in frequency order), gathered a record at a time:
+for the mean power of each packet and for the power of each hit, the count,
+mean and variance (Welford's method, merged with Chan's formula), min, max
+and the quantiles of a t-digest (see tdigest.h).  Powers are as received,
+the numbers analyze -w writes.  A runstats is a fixed 21 MB or so however
+long the run, and two of them can be merged, so each thread of a parallel
+pass can keep its own.
+
+rs_write() saves the results in a binary file, all fields host byte order:
+
+char magic[8] ("SETIRST1", no terminator), uint32 version, uint32 channels
+(4096), uint32 number of quantiles (RS_QUANTILES), uint32 reserved,
+double quantile levels[RS_QUANTILES],
+uint64 packets, uint64 hits, int64 first and last packet time (microseconds
+since 1970),
+then for every channel in order, first for the mean power and then for the
+hit power: uint64 count, double mean, double sample variance, double min,
+double max, double quantiles[RS_QUANTILES] (all 0 if the count is 0).
+
+rs_summary() writes the same as a text table, one line per channel that has
+packets.
+*/
+
+#ifndef RUNSTATS_H
+#define RUNSTATS_H
+
+#include <stdint.h>
+#include "datparse.h"
+#include "tdigest.h"
+
+#define RS_MAGIC       "SETIRST1"
+#define RS_VERSION     1
+#define RS_CHANNELS    4096
+#define RS_QUANTILES   7
+
+extern const double rsLevels[RS_QUANTILES];
+
+typedef struct rsquantity_s {
+	uint64_t count;
+	double mean;
+	double m2;                  /* sum of squared differences from the mean */
+	tdigest digest;             /* also keeps min and max */
+} rsquantity;
+
+typedef struct rschannel_s {
+	rsquantity meanPower;       /* one value per packet */
+	rsquantity hitPower;        /* one value per hit */
+} rschannel;
+
+typedef struct runstats_s {
+	uint64_t packets;
+	uint64_t hits;
+	int64_t firstTime, lastTime;
+	rschannel channels[RS_CHANNELS];
+} runstats;
+
+typedef struct rsheader_s {
+	char magic[8];
+	uint32_t version;
+	uint32_t channels;
+	uint32_t quantiles;
+	uint32_t reserved;
+	double levels[RS_QUANTILES];
+	uint64_t packets;
+	uint64_t hits;
+	int64_t firstTime, lastTime;
+} rsheader;
+
+typedef struct rsentry_s {
+	uint64_t count;
+	double mean;
+	double variance;
+	double min, max;
+	double quantiles[RS_QUANTILES];
+} rsentry;
+
+void rs_init(runstats *s);
+void rs_record(runstats *s, const datrecord *r);
+void rs_merge(runstats *into, const runstats *from);
+void rs_entry(rsquantity *x, rsentry *e);
+int rs_write(runstats *s, const char *path);
+int rs_summary(runstats *s, const char *path);
+
+#endif
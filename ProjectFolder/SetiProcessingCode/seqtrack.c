@@ -0,0 +1,227 @@
+/*
+Sequence Tracking v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+See seqtrack.h.  Bins are classified by their distance from the newest bin seen:
+
+  distance 0                         duplicate of the newest bin
+  distance 1 .. 4096-WINDOW          forward (distance > 1 is a gap); wrapping
+                                     past 4095 starts a new spectrum
+  distance > 4096-WINDOW             behind the newest bin: out of order, filled
+                                     into the current or previous spectrum
+*/
+
+#include <string.h>
+#include "seqtrack.h"
+
+#define BIT_WORD(b) ((b) >> 6)
+#define BIT_MASK(b) (((uint64_t)1) << ((b) & 63))
+
+static void finalize(seqtrack *st, uint64_t *bitmap, uint64_t spectrum)
+{
+	int i, first, last, present = 0;
+	uint64_t missing;
+
+	for(i=0; i<SEQ_BITMAP_WORDS; i++){
+		present += __builtin_popcountll(bitmap[i]);
+	}
+	st->stats.spectra++;
+	if(present == SEQ_NUM_BINS){
+		st->stats.spectraComplete++;
+	}
+	st->stats.binsMissing += SEQ_NUM_BINS - present;
+
+	if((st->loss == NULL) || (present == SEQ_NUM_BINS)){
+		return;
+	}
+	/* only the missing bits are visited */
+	for(i=0; i<SEQ_BITMAP_WORDS; i++){
+		missing = ~bitmap[i];
+		while(missing){
+			st->loss->missingByBin[i*64 + __builtin_ctzll(missing)]++;
+			missing &= missing - 1;
+		}
+	}
+	last = -1;
+	while(seq_next_gap(bitmap, last+1, &first, &last)){
+		st->loss->ranges++;
+	}
+	if(st->loss->incomplete != NULL){
+		st->loss->incomplete(st->loss->arg, spectrum, bitmap, present);
+	}
+}
+
+/* Mark bins [from, to) present without having seen them (start and end of a run) */
+static void fill(uint64_t *bitmap, int from, int to)
+{
+	int b;
+	for(b=from; b<to; b++){
+		bitmap[BIT_WORD(b)] |= BIT_MASK(b);
+	}
+}
+
+/* Finds the first run of missing bins at or after from; returns 0 if there is none */
+int seq_next_gap(const uint64_t *bitmap, int from, int *first, int *last)
+{
+	int b = from;
+	uint64_t word;
+
+	/* the first clear bit, then the first set bit after it, a word at a time */
+	while(b < SEQ_NUM_BINS){
+		word = ~bitmap[BIT_WORD(b)] & (~(uint64_t)0 << (b & 63));
+		if(word){
+			b = (b & ~63) + __builtin_ctzll(word);
+			break;
+		}
+		b = (b & ~63) + 64;
+	}
+	if(b >= SEQ_NUM_BINS){
+		return 0;
+	}
+	*first = b;
+	while(b < SEQ_NUM_BINS){
+		word = bitmap[BIT_WORD(b)] & (~(uint64_t)0 << (b & 63));
+		if(word){
+			b = (b & ~63) + __builtin_ctzll(word);
+			break;
+		}
+		b = (b & ~63) + 64;
+	}
+	*last = b - 1;
+	return 1;
+}
+
+void seq_init(seqtrack *st)
+{
+	memset(st, 0, sizeof(seqtrack));
+	st->lastbin = -1;
+}
+
+/* Account for one packet.  Returns 1 if bin starts a new spectrum, otherwise 0. */
+int seq_track(seqtrack *st, unsigned int bin, unsigned int errorCode)
+{
+	int distance;
+	uint64_t *target;
+	int newSpectrum = 0;
+
+	st->stats.packets++;
+	if(errorCode & FFT_OVERFLOW_MASK) st->stats.fftOverflow++;
+	if(errorCode & PFB_OVERFLOW_MASK) st->stats.pfbOverflow++;
+	if(errorCode & CT_ERROR_MASK)     st->stats.ctError++;
+	if(errorCode & FIFO_OVERRUN_MASK) st->stats.fifoOverrun++;
+
+	if(bin >= SEQ_NUM_BINS){
+		st->stats.outOfRange++;
+		return 0;
+	}
+
+	if(!st->started){
+		/* bins before the first one received were never ours to lose */
+		fill(st->current, 0, bin);
+		st->current[BIT_WORD(bin)] |= BIT_MASK(bin);
+		st->lastbin = bin;
+		st->started = 1;
+		return 0;
+	}
+
+	distance = ((int)bin - st->lastbin + SEQ_NUM_BINS) % SEQ_NUM_BINS;
+
+	if(distance > SEQ_NUM_BINS - SEQ_REORDER_WINDOW){
+		/* behind the newest bin; across the wrap it belongs to the previous spectrum */
+		if((int)bin > st->lastbin){
+			if(!st->previousOpen){
+				st->stats.late++;
+				return 0;
+			}
+			target = st->previous;
+		}
+		else{
+			target = st->current;
+		}
+		if(target[BIT_WORD(bin)] & BIT_MASK(bin)){
+			st->stats.duplicates++;
+		}
+		else{
+			target[BIT_WORD(bin)] |= BIT_MASK(bin);
+			st->stats.outOfOrder++;
+		}
+		return 0;
+	}
+
+	if(distance == 0){
+		st->stats.duplicates++;
+		return 0;
+	}
+
+	if(distance > 1){
+		st->stats.gaps++;
+	}
+	if((int)bin <= st->lastbin){
+		if(st->previousOpen){
+			finalize(st, st->previous, st->spectrum - 1);
+		}
+		memcpy(st->previous, st->current, sizeof(st->current));
+		memset(st->current, 0, sizeof(st->current));
+		st->previousOpen = 1;
+		st->spectrum++;
+		newSpectrum = 1;
+	}
+	st->current[BIT_WORD(bin)] |= BIT_MASK(bin);
+	st->lastbin = bin;
+
+	/* nothing can reach the previous spectrum once we are past the window */
+	if(st->previousOpen && (st->lastbin >= SEQ_REORDER_WINDOW)){
+		finalize(st, st->previous, st->spectrum - 1);
+		st->previousOpen = 0;
+	}
+	return newSpectrum;
+}
+
+/* Finalize whatever is still open.  Bins after the last one received are not counted missing. */
+void seq_finish(seqtrack *st)
+{
+	if(!st->started){
+		return;
+	}
+	if(st->previousOpen){
+		finalize(st, st->previous, st->spectrum - 1);
+		st->previousOpen = 0;
+	}
+	fill(st->current, st->lastbin+1, SEQ_NUM_BINS);
+	finalize(st, st->current, st->spectrum);
+	st->started = 0;
+}
+
+/* For trackers that each see part of the packets */
+void seq_add(seqstats *into, const seqstats *from)
+{
+	into->packets += from->packets;
+	into->spectra += from->spectra;
+	into->spectraComplete += from->spectraComplete;
+	into->binsMissing += from->binsMissing;
+	into->gaps += from->gaps;
+	into->duplicates += from->duplicates;
+	into->outOfOrder += from->outOfOrder;
+	into->late += from->late;
+	into->outOfRange += from->outOfRange;
+	into->fftOverflow += from->fftOverflow;
+	into->pfbOverflow += from->pfbOverflow;
+	into->ctError += from->ctError;
+	into->fifoOverrun += from->fifoOverrun;
+}
+
+void seq_print(FILE *out, const seqstats *s)
+{
+	fprintf(out, "packets %llu, spectra %llu (%llu complete), missing bins %llu, gaps %llu, "
+		"duplicates %llu, out of order %llu, late %llu, out of range %llu; "
+		"errors: FFT overflow %llu, PFB overflow %llu, CT %llu, FIFO overrun %llu\n",
+		(unsigned long long)s->packets, (unsigned long long)s->spectra,
+		(unsigned long long)s->spectraComplete, (unsigned long long)s->binsMissing,
+		(unsigned long long)s->gaps, (unsigned long long)s->duplicates,
+		(unsigned long long)s->outOfOrder, (unsigned long long)s->late,
+		(unsigned long long)s->outOfRange, (unsigned long long)s->fftOverflow,
+		(unsigned long long)s->pfbOverflow, (unsigned long long)s->ctError,
+		(unsigned long long)s->fifoOverrun);
+}
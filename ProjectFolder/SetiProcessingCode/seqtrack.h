@@ -0,0 +1,81 @@
+/*
+Sequence Tracking v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+Tracks the continuity of the PFB bin sequence as packets arrive and counts the
+error code bits reported by the BEE2.  Each spectrum gets a 4096 bit bitmap; a
+spectrum is finalized (and its missing bins counted) once the sequence has moved
+SEQ_REORDER_WINDOW bins into the next spectrum, so a packet that arrives a little
+late is still credited to the spectrum it belongs to.
+
+All state lives in fixed size arrays so a seqtrack can be copied or written to a
+file as is, except loss: a tracker given a seqloss also counts the spectra each
+PFB bin was missing from and hands every incomplete spectrum's bitmap to a
+callback as it is finalized.  seq_next_gap() walks such a bitmap a run of
+missing bins at a time, so reporting costs follow the number of gaps, not the
+number of bins lost.  Whoever copies a tracker sets loss again.
+
+The BEE2 error code bits are defined here for everything that looks at them.
+*/
+
+#ifndef SEQTRACK_H
+#define SEQTRACK_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define FFT_OVERFLOW_MASK 0x20000000
+#define PFB_OVERFLOW_MASK 0x10000000
+#define CT_ERROR_MASK     0x0F000000
+#define FIFO_OVERRUN_MASK 0x00FFC000
+
+#define SEQ_NUM_BINS       4096
+#define SEQ_BITMAP_WORDS   (SEQ_NUM_BINS/64)
+#define SEQ_REORDER_WINDOW 64
+
+/* Running counters, safe to read (a little stale) from any thread */
+typedef struct seqstats_s {
+	uint64_t packets;
+	uint64_t spectra;           /* spectra finalized */
+	uint64_t spectraComplete;   /* finalized with all 4096 bins present */
+	uint64_t binsMissing;
+	uint64_t gaps;              /* forward jumps in the bin sequence */
+	uint64_t duplicates;
+	uint64_t outOfOrder;        /* arrived behind the newest bin, within the window */
+	uint64_t late;              /* arrived after its spectrum was finalized */
+	uint64_t outOfRange;        /* bin number > 4095 */
+	uint64_t fftOverflow;
+	uint64_t pfbOverflow;
+	uint64_t ctError;
+	uint64_t fifoOverrun;
+} seqstats;
+
+/* Optional loss accounting, see above */
+typedef struct seqloss_s {
+	uint64_t ranges;                      /* runs of missing bins in finalized spectra */
+	uint64_t missingByBin[SEQ_NUM_BINS];  /* spectra each bin was missing from */
+	void (*incomplete)(void *arg, uint64_t spectrum, const uint64_t *bitmap, int present);
+	void *arg;
+} seqloss;
+
+typedef struct seqtrack_s {
+	seqstats stats;
+	seqloss *loss;                        /* NULL unless wanted */
+	int started;
+	int lastbin;
+	uint64_t spectrum;                    /* spectrum number lastbin belongs to */
+	int previousOpen;
+	uint64_t current[SEQ_BITMAP_WORDS];
+	uint64_t previous[SEQ_BITMAP_WORDS];
+} seqtrack;
+
+void seq_init(seqtrack *st);
+int seq_track(seqtrack *st, unsigned int bin, unsigned int errorCode);
+void seq_finish(seqtrack *st);
+void seq_add(seqstats *into, const seqstats *from);
+void seq_print(FILE *out, const seqstats *s);
+int seq_next_gap(const uint64_t *bitmap, int from, int *first, int *last);
+
+#endif
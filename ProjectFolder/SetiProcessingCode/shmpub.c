@@ -0,0 +1,184 @@
+/*
+Live Spectrum Publisher v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+See shmpub.h.  The receive thread fills a private staging spectrum packet by packet
+and copies it into the shared region once per spectrum, so readers never slow
+the capture path and the capture path never waits for readers.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shmpub.h"
+
+int shm_pub_open(shmpub *p, const char *name)
+{
+	int fd;
+
+	memset(p, 0, sizeof(shmpub));
+	strncpy(p->name, name, SHM_NAME_SIZE-1);
+
+	fd = shm_open(p->name, O_CREAT | O_RDWR, 0644);
+	if(fd == -1){
+		printf("Could not create shared memory %s.\n", p->name);
+		return 0;
+	}
+	if(ftruncate(fd, sizeof(shmspectrum)) == -1){
+		printf("Could not size shared memory %s.\n", p->name);
+		close(fd);
+		return 0;
+	}
+	p->shm = (shmspectrum *)mmap(NULL, sizeof(shmspectrum), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(p->shm == MAP_FAILED){
+		printf("Could not map shared memory %s.\n", p->name);
+		p->shm = NULL;
+		return 0;
+	}
+	p->staging = (shmspectrum *)calloc(1, sizeof(shmspectrum));
+	if(p->staging == NULL){
+		munmap(p->shm, sizeof(shmspectrum));
+		p->shm = NULL;
+		return 0;
+	}
+
+	/* a reader may still be attached from an earlier run: the generation must never go back */
+	if((p->shm->magic != SHM_MAGIC) || (p->shm->version != SHM_VERSION)){
+		p->shm->generation = 0;
+	}
+	p->shm->maxHits = SHM_MAX_HITS;
+	p->shm->version = SHM_VERSION;
+	__sync_synchronize();
+	p->shm->magic = SHM_MAGIC;
+	return 1;
+}
+
+void shm_pub_bin(shmpub *p, unsigned int pfbBin, unsigned int meanPower, int sec, int usec)
+{
+	if(pfbBin >= SHM_NUM_BINS){
+		return;
+	}
+	if(!p->started){
+		p->staging->sec = sec;
+		p->staging->usec = usec;
+		p->started = 1;
+	}
+	p->staging->meanPower[pfbBin] = meanPower;
+	p->staging->nbins++;
+}
+
+void shm_pub_hit(shmpub *p, unsigned int fineBin, unsigned int power)
+{
+	if(p->staging->nhits < SHM_MAX_HITS){
+		p->staging->hitBin[p->staging->nhits] = fineBin;
+		p->staging->hitPower[p->staging->nhits] = power;
+		p->staging->nhits++;
+	}
+}
+
+/* Copy the staged spectrum into the shared region and start a new one */
+void shm_pub_publish(shmpub *p)
+{
+	shmspectrum *shm = p->shm;
+	shmspectrum *s = p->staging;
+	uint32_t generation;
+
+	if(!p->started){
+		return;
+	}
+	/* odd if an earlier writer died while copying, then it stays odd until this copy is done */
+	generation = shm->generation | 1;
+	shm->generation = generation;
+	__sync_synchronize();
+
+	shm->spectrum = s->spectrum;
+	shm->sec = s->sec;
+	shm->usec = s->usec;
+	shm->nbins = s->nbins;
+	shm->nhits = s->nhits;
+	memcpy(shm->meanPower, s->meanPower, sizeof(s->meanPower));
+	memcpy(shm->hitBin, s->hitBin, s->nhits * sizeof(uint32_t));
+	memcpy(shm->hitPower, s->hitPower, s->nhits * sizeof(uint32_t));
+
+	__sync_synchronize();
+	shm->generation = generation + 1;
+
+	s->spectrum++;
+	s->nbins = 0;
+	s->nhits = 0;
+	memset(s->meanPower, 0, sizeof(s->meanPower));
+	p->started = 0;
+}
+
+void shm_pub_close(shmpub *p)
+{
+	if(p->shm != NULL){
+		munmap(p->shm, sizeof(shmspectrum));
+		shm_unlink(p->name);
+		p->shm = NULL;
+	}
+	free(p->staging);
+	p->staging = NULL;
+}
+
+/* Reader side: map an existing region read-only, NULL if there is none */
+const shmspectrum *shm_attach(const char *name)
+{
+	int fd;
+	shmspectrum *shm;
+
+	fd = shm_open(name, O_RDONLY, 0);
+	if(fd == -1){
+		return NULL;
+	}
+	shm = (shmspectrum *)mmap(NULL, sizeof(shmspectrum), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(shm == MAP_FAILED){
+		return NULL;
+	}
+	if((shm->magic != SHM_MAGIC) || (shm->version != SHM_VERSION)){
+		munmap(shm, sizeof(shmspectrum));
+		return NULL;
+	}
+	return shm;
+}
+
+/* Reader side: take a consistent copy of the latest spectrum.  Returns 0 if nothing is published yet. */
+int shm_read(const shmspectrum *shm, shmspectrum *copy)
+{
+	uint32_t before, after, nhits;
+
+	do{
+		before = shm->generation;
+		if(before & 1){
+			sched_yield();
+			continue;
+		}
+		__sync_synchronize();
+		copy->spectrum = shm->spectrum;
+		copy->sec = shm->sec;
+		copy->usec = shm->usec;
+		copy->nbins = shm->nbins;
+		nhits = shm->nhits;
+		if(nhits > SHM_MAX_HITS){
+			nhits = SHM_MAX_HITS;
+		}
+		copy->nhits = nhits;
+		memcpy(copy->meanPower, shm->meanPower, sizeof(copy->meanPower));
+		memcpy(copy->hitBin, shm->hitBin, nhits * sizeof(uint32_t));
+		memcpy(copy->hitPower, shm->hitPower, nhits * sizeof(uint32_t));
+		__sync_synchronize();
+		after = shm->generation;
+	}while((before & 1) || (before != after));
+
+	copy->generation = after;
+	return after != 0;
+}
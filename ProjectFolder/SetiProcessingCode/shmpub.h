@@ -0,0 +1,66 @@
+/*
+Live Spectrum Publisher v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+Publishes the latest complete spectrum into a POSIX shared memory object
+(/dev/shm/<name>) that any number of viewers may map read-only.  The region is a
+single shmspectrum guarded by a generation counter (a seqlock): the writer makes
+the counter odd, copies the spectrum in, then makes it even again.  A reader
+copies out what it needs and retries if the counter was odd or changed meanwhile.
+A receiver restarted on a region left behind carries its counter on rather than
+resetting it, so a viewer still attached never sees it go back.
+
+All values are the raw 32 bit numbers sent by the BEE2.  Dividing a power by
+2^31 gives the values plotted by receive -g.  meanPower is indexed by PFB bin
+after the +2048 rotation receive applies, hitBin is the absolute fine bin
+(((bin + 16384) % 32768) + 32768 * PFB bin).  Masked hits are not published.
+
+From Octave, the region can be read with fopen("/dev/shm/<name>") and fread using
+the field offsets below (all little endian on the receiving host).
+*/
+
+#ifndef SHMPUB_H
+#define SHMPUB_H
+
+#include <stdint.h>
+
+#define SHM_MAGIC      0x49544553   /* "SETI" */
+#define SHM_VERSION    1
+#define SHM_NUM_BINS   4096
+#define SHM_MAX_HITS   424288
+#define SHM_NAME_SIZE  64
+
+typedef struct shmspectrum_s {
+	uint32_t magic;
+	uint32_t version;
+	volatile uint32_t generation;    /* odd while the writer is copying */
+	uint32_t maxHits;
+	uint64_t spectrum;               /* spectra published since the receiver started */
+	int32_t sec;                     /* time stamp of the first packet of the spectrum */
+	int32_t usec;
+	uint32_t nbins;                  /* PFB bins received */
+	uint32_t nhits;
+	uint32_t meanPower[SHM_NUM_BINS];
+	uint32_t hitBin[SHM_MAX_HITS];
+	uint32_t hitPower[SHM_MAX_HITS];
+} shmspectrum;
+
+typedef struct shmpub_s {
+	char name[SHM_NAME_SIZE];
+	shmspectrum *shm;
+	shmspectrum *staging;            /* spectrum being received, private */
+	int started;
+} shmpub;
+
+int shm_pub_open(shmpub *p, const char *name);
+void shm_pub_bin(shmpub *p, unsigned int pfbBin, unsigned int meanPower, int sec, int usec);
+void shm_pub_hit(shmpub *p, unsigned int fineBin, unsigned int power);
+void shm_pub_publish(shmpub *p);
+void shm_pub_close(shmpub *p);
+
+const shmspectrum *shm_attach(const char *name);
+int shm_read(const shmspectrum *shm, shmspectrum *copy);
+
+#endif
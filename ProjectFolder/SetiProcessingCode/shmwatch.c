@@ -0,0 +1,63 @@
+/*
+Live Spectrum Monitor v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+To compile: gcc -O -Wall -o shmwatch shmpub.c shmwatch.c -lrt
+
+Attaches read-only to the shared memory spectrum published by "receive -shm" and
+prints one line per spectrum: number, time stamp, PFB bins received, hits, and
+the strongest hit.  Any number of these (or other readers) may run at once.
+
+Usage: shmwatch [name]    (default /seti_receive_2010)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "shmpub.h"
+
+int main(int argc, const char *argv[])
+{
+	const char *name = "/seti_receive_2010";
+	const shmspectrum *shm;
+	shmspectrum *copy;
+	uint32_t lastGeneration = 0;
+	uint32_t i, best;
+
+	if(argc >= 2){
+		name = argv[1];
+	}
+
+	while((shm = shm_attach(name)) == NULL){
+		printf("Waiting for %s...\n", name);
+		sleep(1);
+	}
+	copy = (shmspectrum *)malloc(sizeof(shmspectrum));
+	if(copy == NULL){
+		printf("Out of memory.\n");
+		return 1;
+	}
+
+	while(1){
+		if(shm_read(shm, copy) && (copy->generation != lastGeneration)){
+			lastGeneration = copy->generation;
+			best = 0;
+			for(i=1; i<copy->nhits; i++){
+				if(copy->hitPower[i] > copy->hitPower[best]){
+					best = i;
+				}
+			}
+			printf("spectrum %llu at %i.%06i: %u PFB bins, %u hits",
+				(unsigned long long)copy->spectrum, copy->sec, copy->usec, copy->nbins, copy->nhits);
+			if(copy->nhits){
+				printf(", strongest %g at fine bin %u", copy->hitPower[best] / 2147483648.0, copy->hitBin[best]);
+			}
+			printf("\n");
+			fflush(stdout);
+		}
+		usleep(100000);
+	}
+	return 0;
+}
@@ -0,0 +1,160 @@
+/*
+Spectrum Buffer Pool v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+See specpool.h.
+*/
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "specpool.h"
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+/* Map at least *bytes of zeroed memory; *bytes is rounded up to what was mapped.
+   Less than a huge page gets ordinary pages, rounding it up would waste the rest of the page. */
+void *spec_alloc(size_t *bytes, int *huge)
+{
+	void *memory;
+	size_t rounded = (*bytes + HUGE_PAGE_SIZE - 1) & ~((size_t)HUGE_PAGE_SIZE - 1);
+
+	if(*bytes >= HUGE_PAGE_SIZE){
+		memory = mmap(NULL, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if(memory != MAP_FAILED){
+			*bytes = rounded;
+			if(huge != NULL){
+				*huge = 1;
+			}
+			return memory;
+		}
+	}
+
+	memory = mmap(NULL, *bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(memory == MAP_FAILED){
+		return NULL;
+	}
+	if(*bytes >= HUGE_PAGE_SIZE){
+		madvise(memory, *bytes, MADV_HUGEPAGE);
+	}
+	return memory;
+}
+
+void spec_free(void *memory, size_t bytes)
+{
+	if(memory != NULL){
+		munmap(memory, bytes);
+	}
+}
+
+void spec_pool_init(specpool *p)
+{
+	p->freeList = NULL;
+	p->hugePages = 0;
+	pthread_mutex_init(&p->lock, NULL);
+}
+
+/* A buffer with room for at least SPEC_INITIAL_HITS hits, NULL if out of memory */
+specbuf *spec_get(specpool *p)
+{
+	specbuf *b;
+	char *coarse;
+	int huge = 0;
+
+	pthread_mutex_lock(&p->lock);
+	b = p->freeList;
+	if(b != NULL){
+		p->freeList = b->nextFree;
+	}
+	pthread_mutex_unlock(&p->lock);
+	if(b != NULL){
+		return b;
+	}
+
+	b = (specbuf *)calloc(1, sizeof(specbuf));
+	if(b == NULL){
+		return NULL;
+	}
+	b->coarseBytes = 4 * SPEC_COARSE * sizeof(double);
+	coarse = (char *)spec_alloc(&b->coarseBytes, &huge);
+	if(coarse == NULL){
+		free(b);
+		return NULL;
+	}
+	b->binsLeft = (double *)coarse;
+	b->avgpowerLeft = b->binsLeft + SPEC_COARSE;
+	b->binsRight = b->avgpowerLeft + SPEC_COARSE;
+	b->avgpowerRight = b->binsRight + SPEC_COARSE;
+	if(!spec_reserve(p, b, SPEC_INITIAL_HITS)){
+		spec_free(coarse, b->coarseBytes);
+		free(b);
+		return NULL;
+	}
+	if(huge){
+		p->hugePages = 1;
+	}
+	return b;
+}
+
+/* Make room for at least hits hits, keeping the ones already stored.  Returns 0 if out of memory. */
+int spec_reserve(specpool *p, specbuf *b, int hits)
+{
+	int capacity, huge = 0;
+	size_t bytes;
+	double *memory;
+
+	if(hits <= b->hitCapacity){
+		return 1;
+	}
+	capacity = (b->hitCapacity > 0) ? b->hitCapacity : SPEC_INITIAL_HITS;
+	while(capacity < hits){
+		capacity *= 2;
+	}
+
+	bytes = 2 * (size_t)capacity * sizeof(double);
+	memory = (double *)spec_alloc(&bytes, &huge);
+	if(memory == NULL){
+		return 0;
+	}
+	/* the mapping may be bigger than asked for, use all of it */
+	capacity = bytes / (2 * sizeof(double));
+	if(b->hitCapacity > 0){
+		memcpy(memory, b->hitbins, b->hitCapacity * sizeof(double));
+		memcpy(memory + capacity, b->hitpowers, b->hitCapacity * sizeof(double));
+		spec_free(b->hitbins, b->hitBytes);
+	}
+	b->hitbins = memory;
+	b->hitpowers = memory + capacity;
+	b->hitCapacity = capacity;
+	b->hitBytes = bytes;
+	if(huge){
+		p->hugePages = 1;
+	}
+	return 1;
+}
+
+void spec_put(specpool *p, specbuf *b)
+{
+	pthread_mutex_lock(&p->lock);
+	b->nextFree = p->freeList;
+	p->freeList = b;
+	pthread_mutex_unlock(&p->lock);
+}
+
+/* Unmaps every buffer returned to the pool */
+void spec_pool_destroy(specpool *p)
+{
+	specbuf *b;
+
+	pthread_mutex_lock(&p->lock);
+	while((b = p->freeList) != NULL){
+		p->freeList = b->nextFree;
+		spec_free(b->binsLeft, b->coarseBytes);
+		spec_free(b->hitbins, b->hitBytes);
+		free(b);
+	}
+	pthread_mutex_unlock(&p->lock);
+}
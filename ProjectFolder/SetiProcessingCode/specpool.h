@@ -0,0 +1,53 @@
+/*
+Spectrum Buffer Pool v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+Per-spectrum working buffers (the coarse plotting arrays and the hit lists) taken
+from the heap instead of main's stack.  A buffer is reused spectrum after
+spectrum and its hit arrays only grow, doubling, when a spectrum has more hits
+than they hold.  Memory comes from mmap; a mapping of at least a huge page goes
+on huge pages when the system has them reserved and otherwise gets a transparent
+huge page hint, smaller ones (the coarse arrays) stay on ordinary pages.  The pool is thread
+safe, so several receivers can share one process.
+*/
+
+#ifndef SPECPOOL_H
+#define SPECPOOL_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define SPEC_COARSE        2049
+#define SPEC_INITIAL_HITS  65536
+
+typedef struct specbuf_s {
+	double *binsLeft;
+	double *avgpowerLeft;
+	double *binsRight;
+	double *avgpowerRight;
+	double *hitbins;
+	double *hitpowers;
+	int hitCapacity;
+	size_t coarseBytes;         /* size of the mapping behind the coarse arrays */
+	size_t hitBytes;            /* size of the mapping behind the hit arrays */
+	struct specbuf_s *nextFree;
+} specbuf;
+
+typedef struct specpool_s {
+	specbuf *freeList;
+	int hugePages;              /* set once a MAP_HUGETLB mapping succeeded */
+	pthread_mutex_t lock;
+} specpool;
+
+void spec_pool_init(specpool *p);
+specbuf *spec_get(specpool *p);
+int spec_reserve(specpool *p, specbuf *b, int hits);
+void spec_put(specpool *p, specbuf *b);
+void spec_pool_destroy(specpool *p);
+
+void *spec_alloc(size_t *bytes, int *huge);
+void spec_free(void *memory, size_t bytes);
+
+#endif
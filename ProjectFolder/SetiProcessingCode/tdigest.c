@@ -0,0 +1,159 @@
+/*
+T-Digest v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+See tdigest.h.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "tdigest.h"
+
+/* The k1 scale function: a centroid may span at most 1 in k */
+static double scale(double q)
+{
+	if(q <= 0.0){
+		return -TD_COMPRESSION / 4.0;
+	}
+	if(q >= 1.0){
+		return TD_COMPRESSION / 4.0;
+	}
+	return TD_COMPRESSION / (2.0 * M_PI) * asin(2.0*q - 1.0);
+}
+
+static int by_mean(const void *a, const void *b)
+{
+	double x = ((const tdcentroid *)a)->mean;
+	double y = ((const tdcentroid *)b)->mean;
+
+	return (x > y) - (x < y);
+}
+
+void td_init(tdigest *t)
+{
+	memset(t, 0, sizeof(tdigest));
+	t->min = INFINITY;
+	t->max = -INFINITY;
+}
+
+void td_add(tdigest *t, double value, double weight)
+{
+	if(t->buffered == TD_BUFFER){
+		td_compress(t);
+	}
+	t->b[t->buffered].mean = value;
+	t->b[t->buffered].weight = weight;
+	t->buffered++;
+	t->total += weight;
+	if(value < t->min){
+		t->min = value;
+	}
+	if(value > t->max){
+		t->max = value;
+	}
+}
+
+/* Merges the buffer into the centroids */
+void td_compress(tdigest *t)
+{
+	tdcentroid all[TD_CENTROIDS + TD_BUFFER];
+	tdcentroid current;
+	double soFar = 0, kLeft;
+	int n = 0, i = 0, j = 0, out = 0;
+
+	if(t->buffered == 0){
+		return;
+	}
+	qsort(t->b, t->buffered, sizeof(tdcentroid), by_mean);
+	while((i < t->centroids) || (j < t->buffered)){
+		if((j == t->buffered) || ((i < t->centroids) && (t->c[i].mean <= t->b[j].mean))){
+			all[n++] = t->c[i++];
+		}
+		else{
+			all[n++] = t->b[j++];
+		}
+	}
+
+	current = all[0];
+	kLeft = scale(0.0);
+	for(i=1; i<n; i++){
+		/* the last slot takes whatever is left, which only rounding can cause */
+		if((scale((soFar + current.weight + all[i].weight) / t->total) - kLeft <= 1.0) || (out == TD_CENTROIDS - 1)){
+			current.weight += all[i].weight;
+			current.mean += (all[i].mean - current.mean) * all[i].weight / current.weight;
+		}
+		else{
+			t->c[out++] = current;
+			soFar += current.weight;
+			kLeft = scale(soFar / t->total);
+			current = all[i];
+		}
+	}
+	t->c[out++] = current;
+	t->centroids = out;
+	t->buffered = 0;
+}
+
+void td_merge(tdigest *into, const tdigest *from)
+{
+	int i;
+
+	for(i=0; i<from->centroids; i++){
+		td_add(into, from->c[i].mean, from->c[i].weight);
+	}
+	for(i=0; i<from->buffered; i++){
+		td_add(into, from->b[i].mean, from->b[i].weight);
+	}
+	/* centroid means lie inside the range, the extremes themselves may not be among them */
+	if(from->min < into->min){
+		into->min = from->min;
+	}
+	if(from->max > into->max){
+		into->max = from->max;
+	}
+}
+
+/* The value below which a fraction q of the weight lies; NAN if nothing was added */
+double td_quantile(tdigest *t, double q)
+{
+	double target, cumulative, gap, half;
+	int i, n;
+
+	td_compress(t);
+	n = t->centroids;
+	if(n == 0){
+		return NAN;
+	}
+	if(q <= 0.0){
+		return t->min;
+	}
+	if(q >= 1.0){
+		return t->max;
+	}
+	if(n == 1){
+		return t->c[0].mean;
+	}
+
+	/* each centroid's weight is taken to be spread evenly around its mean */
+	target = q * t->total;
+	half = t->c[0].weight / 2.0;
+	if(target < half){
+		return t->min + (t->c[0].mean - t->min) * target / half;
+	}
+	cumulative = half;
+	for(i=0; i<n-1; i++){
+		gap = (t->c[i].weight + t->c[i+1].weight) / 2.0;
+		if(target < cumulative + gap){
+			return t->c[i].mean + (t->c[i+1].mean - t->c[i].mean) * (target - cumulative) / gap;
+		}
+		cumulative += gap;
+	}
+	half = t->c[n-1].weight / 2.0;
+	if(target - cumulative >= half){
+		return t->max;
+	}
+	return t->c[n-1].mean + (t->max - t->c[n-1].mean) * (target - cumulative) / half;
+}
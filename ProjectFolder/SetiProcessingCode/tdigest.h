@@ -0,0 +1,48 @@
+/*
+T-Digest v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+Approximate quantiles of a stream of values in fixed memory (Dunning's
+merging t-digest).  Values are gathered in a small buffer; when it fills
+they are sorted and merged with the centroids, each centroid taking as
+much weight as the k1 scale function allows at its quantile.  That keeps
+the centroids small near 0 and 1, so the tails stay accurate, and there
+can be no more than about TD_COMPRESSION+2 of them however many values go
+in.  min and max are exact.
+
+A tdigest is plain data with no pointers: it can be copied, written to a
+file and read back, or merged into another with td_merge().
+*/
+
+#ifndef TDIGEST_H
+#define TDIGEST_H
+
+#include <stdint.h>
+
+#define TD_COMPRESSION  100
+#define TD_CENTROIDS    (TD_COMPRESSION + 8)
+#define TD_BUFFER       48
+
+typedef struct tdcentroid_s {
+	double mean;
+	double weight;
+} tdcentroid;
+
+typedef struct tdigest_s {
+	double total;               /* weight of the centroids and the buffer */
+	double min, max;
+	int centroids;
+	int buffered;
+	tdcentroid c[TD_CENTROIDS];  /* sorted by mean */
+	tdcentroid b[TD_BUFFER];     /* not merged yet */
+} tdigest;
+
+void td_init(tdigest *t);
+void td_add(tdigest *t, double value, double weight);
+void td_compress(tdigest *t);
+void td_merge(tdigest *into, const tdigest *from);
+double td_quantile(tdigest *t, double q);
+
+#endif
@@ -0,0 +1,266 @@
+/*
+Text Export v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+See txtexport.h.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "txtexport.h"
+
+static const char digitPairs[] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+/* Writes v in decimal at p, two digits at a time; returns the end */
+static inline char *put_u32(char *p, uint32_t v)
+{
+	char digits[10];
+	char *q = digits + 10;
+	int n;
+
+	while(v >= 100){
+		q -= 2;
+		memcpy(q, digitPairs + 2*(v % 100), 2);
+		v /= 100;
+	}
+	if(v >= 10){
+		q -= 2;
+		memcpy(q, digitPairs + 2*v, 2);
+	}
+	else{
+		*--q = '0' + v;
+	}
+	n = digits + 10 - q;
+	memcpy(p, q, n);
+	return p + n;
+}
+
+/* As "%i" */
+static inline char *put_i32(char *p, int32_t v)
+{
+	if(v < 0){
+		*p++ = '-';
+		return put_u32(p, 0u - (uint32_t)v);
+	}
+	return put_u32(p, (uint32_t)v);
+}
+
+/* As "%i.%06i" */
+static char *put_time(char *p, int32_t sec, int32_t usec)
+{
+	p = put_i32(p, sec);
+	*p++ = '.';
+	if((usec < 0) || (usec > 999999)){
+		/* not a microsecond count, leave it to printf */
+		return p + sprintf(p, "%06i", usec);
+	}
+	memcpy(p, digitPairs + 2*(usec / 10000), 2);
+	memcpy(p + 2, digitPairs + 2*(usec / 100 % 100), 2);
+	memcpy(p + 4, digitPairs + 2*(usec % 100), 2);
+	return p + 6;
+}
+
+static void txt_flush(txtexport *t)
+{
+	size_t done = 0;
+	ssize_t n;
+
+	while(done < t->used){
+		n = write(t->fd, t->buffer + done, t->used - done);
+		if(n < 0){
+			if(errno == EINTR){
+				continue;
+			}
+			if(t->error == 0){
+				t->error = errno;
+			}
+			break;
+		}
+		done += n;
+	}
+	t->bytes += done;
+	t->used = 0;
+}
+
+/* Room for one more line */
+static inline char *txt_space(txtexport *t)
+{
+	if(t->used + TXT_MAX_LINE > TXT_BUFFER_SIZE){
+		txt_flush(t);
+	}
+	return t->buffer + t->used;
+}
+
+const char *txt_extension(int layout)
+{
+	if(layout == TXT_CSV){
+		return "csv";
+	}
+	if(layout == TXT_TSV){
+		return "tsv";
+	}
+	return "txt";
+}
+
+/* Creates path; returns 0 with errno set if it cannot */
+int txt_open(txtexport *t, const char *path, int layout)
+{
+	memset(t, 0, sizeof(txtexport));
+	t->layout = layout;
+	t->buffer = (char *)malloc(TXT_BUFFER_SIZE);
+	if(t->buffer == NULL){
+		errno = ENOMEM;
+		return 0;
+	}
+	t->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if(t->fd < 0){
+		free(t->buffer);
+		t->buffer = NULL;
+		return 0;
+	}
+	if(layout == TXT_CSV){
+		t->used = sprintf(t->buffer, "time,coarse_bin,fine_bin,power\n");
+	}
+	else if(layout == TXT_TSV){
+		t->used = sprintf(t->buffer, "time\tcoarse_bin\tfine_bin\tpower\n");
+	}
+	return 1;
+}
+
+void txt_record(txtexport *t, const datrecord *r)
+{
+	char time[32];
+	char separator;
+	char *p;
+	int timeLength, j;
+	uint32_t coarse, bin;
+
+	if(t->layout == TXT_LEGACY){
+		p = txt_space(t);
+		p = put_i32(p, (int32_t)r->length);
+		*p++ = '\n';
+		p = put_time(p, r->sec, r->usec);
+		*p++ = '\n';
+		p = put_i32(p, (int32_t)r->pfbBin);
+		*p++ = '\n';
+		p = put_i32(p, (int32_t)r->meanPower);
+		*p++ = '\n';
+		p = put_i32(p, (int32_t)r->errorCode);
+		*p++ = '\n';
+		t->used = p - t->buffer;
+		for(j=0; j<r->nhits; j++){
+			p = txt_space(t);
+			p = put_i32(p, (int32_t)dat_hit_bin(r, j));
+			*p++ = '\n';
+			p = put_i32(p, (int32_t)dat_hit_power(r, j));
+			*p++ = '\n';
+			t->used = p - t->buffer;
+		}
+		p = txt_space(t);
+		*p++ = '\n';
+		t->used = p - t->buffer;
+		return;
+	}
+
+	if(r->nhits == 0){
+		return;
+	}
+	separator = (t->layout == TXT_TSV) ? '\t' : ',';
+	/* every row of the packet starts the same way */
+	coarse = (r->pfbBin + 2048) % 4096;
+	p = put_time(time, r->sec, r->usec);
+	*p++ = separator;
+	p = put_u32(p, coarse);
+	*p++ = separator;
+	timeLength = p - time;
+	for(j=0; j<r->nhits; j++){
+		bin = ((dat_hit_bin(r, j) + 16384) % 32768) + 32768*coarse;
+		p = txt_space(t);
+		memcpy(p, time, timeLength);
+		p += timeLength;
+		p = put_u32(p, bin);
+		*p++ = separator;
+		p = put_u32(p, dat_hit_power(r, j));
+		*p++ = '\n';
+		t->used = p - t->buffer;
+	}
+}
+
+/* Empties the buffer onto the disk, so t->bytes is what a restart can count on; returns 0 after a write error */
+int txt_sync(txtexport *t)
+{
+	txt_flush(t);
+	if((fdatasync(t->fd) != 0) && (t->error == 0)){
+		t->error = errno;
+	}
+	return t->error == 0;
+}
+
+/*
+Opens path, written up to bytes before a restart, to go on after them; returns 0
+if it is shorter than that.  With bytes 0 nothing of it is kept and it is started
+over, header and all, whether or not it was ever created.
+*/
+int txt_resume(txtexport *t, const char *path, int layout, unsigned long long bytes)
+{
+	struct stat info;
+	int ok;
+
+	if(bytes == 0){
+		return txt_open(t, path, layout);
+	}
+	memset(t, 0, sizeof(txtexport));
+	t->layout = layout;
+	t->buffer = (char *)malloc(TXT_BUFFER_SIZE);
+	if(t->buffer == NULL){
+		errno = ENOMEM;
+		return 0;
+	}
+	t->fd = open(path, O_WRONLY);
+	if(t->fd < 0){
+		free(t->buffer);
+		t->buffer = NULL;
+		return 0;
+	}
+	ok = (fstat(t->fd, &info) == 0);
+	if(ok && ((unsigned long long)info.st_size < bytes)){
+		errno = EINVAL;
+		ok = 0;
+	}
+	/* whatever was written after that is written again */
+	if(ok && (ftruncate(t->fd, bytes) == 0) && (lseek(t->fd, bytes, SEEK_SET) >= 0)){
+		t->bytes = bytes;
+		return 1;
+	}
+	close(t->fd);
+	free(t->buffer);
+	t->buffer = NULL;
+	return 0;
+}
+
+/* Writes out what is left and closes the file; returns 0 if any of it could not be written (t->error says why) */
+int txt_close(txtexport *t)
+{
+	if(t->buffer != NULL){
+		txt_flush(t);
+		free(t->buffer);
+		t->buffer = NULL;
+	}
+	if(t->fd >= 0){
+		if((close(t->fd) != 0) && (t->error == 0)){
+			t->error = errno;
+		}
+		t->fd = -1;
+	}
+	return t->error == 0;
+}
@@ -0,0 +1,55 @@
+/*
+Text Export v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+Writes the records of a receive .dat file (see datparse.h) as text.  The
+numbers are formatted by hand into a large buffer that goes to the file
+with one write() whenever it fills, instead of one fprintf per number.
+
+TXT_LEGACY is the analyze -w format, byte for byte: one number per line
+(length, <sec>.<usec>, PFB bin, mean power, error code, then bin and power
+of each hit) and a blank line after each packet.
+
+TXT_CSV and TXT_TSV have a header row and then one row per hit:
+
+time,coarse_bin,fine_bin,power
+
+time is <sec>.<usec>, coarse_bin is the PFB bin after the +2048 rotation
+(0 to 4095, in frequency order), fine_bin is the absolute bin
+((bin+16384)%32768)+32768*coarse_bin (0 to 134217727) and power is the hit
+power as received (divide by 2147483648 for the scale the plots use).
+Packets without hits produce no rows.
+*/
+
+#ifndef TXTEXPORT_H
+#define TXTEXPORT_H
+
+#include <stddef.h>
+#include "datparse.h"
+
+#define TXT_LEGACY 0
+#define TXT_CSV    1
+#define TXT_TSV    2
+
+#define TXT_BUFFER_SIZE (4 << 20)
+#define TXT_MAX_LINE    128         /* longer than any row, or the first five lines of a packet */
+
+typedef struct txtexport_s {
+	int fd;
+	int layout;
+	char *buffer;
+	size_t used;
+	int error;                  /* errno of the first failed write, 0 if none */
+	unsigned long long bytes;   /* written to the file so far */
+} txtexport;
+
+int txt_open(txtexport *t, const char *path, int layout);
+void txt_record(txtexport *t, const datrecord *r);
+int txt_sync(txtexport *t);
+int txt_resume(txtexport *t, const char *path, int layout, unsigned long long bytes);
+int txt_close(txtexport *t);
+const char *txt_extension(int layout);
+
+#endif
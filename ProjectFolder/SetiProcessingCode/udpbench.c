@@ -0,0 +1,410 @@
+/*
+UDP Loopback Benchmark v1.0
+SETI group
+Space Sciences Lab
+University of California, Berkeley
+
+To compile: gcc -O -Wall -o udpbench udpbench.c
+
+Finds the packet rate receive sustains in write mode.  For every hits per packet
+value and every packet rate, receive is started writing to a tmpfs directory,
+packets laid out like fakeudp's (big endian PFB bin, mean power, error code and
+bin/power pairs, bins counting up through 4096) are sent to it over loopback at
+that rate, receive is stopped with SIGINT and the records in the file it wrote
+are counted.  receive's CPU time (all its threads) comes from wait4().
+
+Results go to stdout as one JSON object per line, keys always in the same order:
+
+{"type":"config",...}         the settings of the run
+{"type":"step","hits":H,"rate":R,"sent":S,"received":N,"loss":L,
+ "send_rate":A,"cpu_us_per_packet":C,"cpu_percent":P}
+{"type":"knee","hits":H,"rate":R,"first_loss_rate":F}
+
+The knee is the highest rate before the first one losing more than the loss
+threshold; rate (or first_loss_rate) is null if every step lost packets (or
+none did).  send_rate is what the sender managed, which is below rate once the
+sender itself cannot keep up.
+
+Usage: udpbench [options] [-- <more receive options>]
+-receive <path>        receive binary to run (default ./receive).
+-dir <directory>       Where receive writes (default /dev/shm).
+-port <port>           UDP port (default 2011).
+-rates <r1,r2,...>     Packet rates to try, packets per second
+                       (default 10000,20000,50000,100000,200000,400000,800000).
+-hits <h1,h2,...>      Hits per packet to try, 0 to 131 (default 0,16,64,128).
+-time <seconds>        Sending time per step (default 2).
+-loss <fraction>       Loss above which a step counts as losing (default 0.001).
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define MAX_MSG        1060
+#define MAX_HITS       ((MAX_MSG - 12) / 8)
+#define MAX_STEPS      64
+#define RAW_MAGIC      0x57415253
+#define RAW_BLOCK_SIZE (1 << 20)
+
+const char *receivePath = "./receive";
+const char *directory = "/dev/shm";
+int port = 2011;
+long rates[MAX_STEPS] = {10000, 20000, 50000, 100000, 200000, 400000, 800000};
+int numRates = 7;
+long hitCounts[MAX_STEPS] = {0, 16, 64, 128};
+int numHits = 4;
+double stepTime = 2.0;
+double lossThreshold = 0.001;
+const char **extraArgs = NULL;
+int numExtra = 0;
+
+/* Parses "a,b,c" into values; returns how many, 0 on a bad list */
+int parse_list(const char *text, long *values, long min, long max)
+{
+	const char *p = text;
+	char *end;
+	int n = 0;
+
+	while(*p != '\0'){
+		if(n == MAX_STEPS){
+			return 0;
+		}
+		values[n] = strtol(p, &end, 10);
+		if((end == p) || (values[n] < min) || (values[n] > max)){
+			return 0;
+		}
+		n++;
+		p = end;
+		if(*p == ','){
+			p++;
+		}
+		else if(*p != '\0'){
+			return 0;
+		}
+	}
+	return n;
+}
+
+double now_seconds()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/* Waits until receive has bound the port, that is until we no longer can; returns 0 if it never does */
+int wait_for_bind(pid_t child)
+{
+	struct sockaddr_in addr;
+	double deadline = now_seconds() + 5.0;
+	int sd, rc;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+	while(now_seconds() < deadline){
+		if(waitpid(child, NULL, WNOHANG) == child){
+			return 0;
+		}
+		sd = socket(AF_INET, SOCK_DGRAM, 0);
+		rc = bind(sd, (struct sockaddr *)&addr, sizeof(addr));
+		close(sd);
+		if((rc < 0) && (errno == EADDRINUSE)){
+			return 1;
+		}
+		usleep(10000);
+	}
+	return 0;
+}
+
+pid_t start_receive(const char *prefix, long spectra)
+{
+	const char *args[32 + MAX_STEPS];
+	char portText[16], spectraText[32];
+	pid_t child;
+	int n = 0, i, devnull;
+
+	snprintf(portText, sizeof(portText), "%i", port);
+	snprintf(spectraText, sizeof(spectraText), "%li", spectra);
+	args[n++] = receivePath;
+	args[n++] = "-s";
+	args[n++] = "127.0.0.1";
+	args[n++] = "-p";
+	args[n++] = portText;
+	args[n++] = "-w";
+	args[n++] = "-f";
+	args[n++] = prefix;
+	args[n++] = "-x";
+	args[n++] = spectraText;
+	args[n++] = "-r";
+	args[n++] = "1";
+	for(i=0; (i<numExtra) && (n < 31 + MAX_STEPS); i++){
+		args[n++] = extraArgs[i];
+	}
+	args[n] = NULL;
+
+	child = fork();
+	if(child == 0){
+		devnull = open("/dev/null", O_WRONLY);
+		if(devnull >= 0){
+			dup2(devnull, 1);
+			dup2(devnull, 2);
+		}
+		execv(receivePath, (char * const *)args);
+		_exit(127);
+	}
+	return child;
+}
+
+/* Records in <prefix>_1.dat, or packets in <prefix>_1.raw; removes the file */
+long long count_records(const char *prefix)
+{
+	char name[512];
+	uint32_t header[4];
+	long long records = 0;
+	FILE *f;
+
+	snprintf(name, sizeof(name), "%s_1.dat", prefix);
+	f = fopen(name, "rb");
+	if(f != NULL){
+		while(fread(header, sizeof(uint32_t), 3, f) == 3){
+			if(fseek(f, header[0], SEEK_CUR) != 0){
+				break;
+			}
+			records++;
+		}
+		fclose(f);
+		unlink(name);
+		return records;
+	}
+
+	snprintf(name, sizeof(name), "%s_1.raw", prefix);
+	f = fopen(name, "rb");
+	if(f != NULL){
+		while(fread(header, sizeof(uint32_t), 4, f) == 4){
+			if(header[0] == RAW_MAGIC){
+				records += header[2];
+			}
+			if(fseek(f, RAW_BLOCK_SIZE - 4 * sizeof(uint32_t), SEEK_CUR) != 0){
+				break;
+			}
+		}
+		fclose(f);
+		unlink(name);
+		return records;
+	}
+	return -1;
+}
+
+/* Sends packets with hits hits at rate per second for stepTime seconds; returns how many went out */
+long long send_packets(int sd, const struct sockaddr_in *to, long rate, int hits, double *elapsed)
+{
+	uint32_t packet[MAX_MSG / 4];
+	struct timespec pause;
+	long long sent = 0, attempts, total;
+	double start, due, now, interval;
+	int bin = 0, meanPower = 1000, i;
+
+	total = (long long)(rate * stepTime);
+	interval = 1.0 / rate;
+	start = now_seconds();
+	for(attempts = 0; attempts < total; attempts++){
+		/* pace against the start so a late packet does not slow the rest */
+		due = start + attempts * interval;
+		now = now_seconds();
+		while(now < due){
+			if(due - now > 0.0002){
+				pause.tv_sec = 0;
+				pause.tv_nsec = (long)((due - now - 0.0001) * 1e9);
+				nanosleep(&pause, NULL);
+			}
+			now = now_seconds();
+		}
+
+		/* the layout fakeudp sends */
+		meanPower += rand() % 15 - 7;
+		if(meanPower < 200){
+			meanPower = 220;
+		}
+		if(meanPower > 999){
+			meanPower = 979;
+		}
+		packet[0] = htonl(bin);
+		packet[1] = htonl(meanPower * (2147483/2000));
+		packet[2] = htonl(0);
+		for(i=0; i<hits; i++){
+			packet[3 + 2*i] = htonl(2048*(hits-1-i) + 1024);
+			packet[4 + 2*i] = htonl((meanPower + 1) * (2147483/2000));
+		}
+		if(sendto(sd, packet, 12 + 8*hits, 0, (const struct sockaddr *)to, sizeof(*to)) > 0){
+			sent++;
+		}
+		else if((errno != ENOBUFS) && (errno != EAGAIN)){
+			/* a full local queue only costs that packet, it is not counted as sent */
+			printf("udpbench: cannot send data (%s)\n", strerror(errno));
+			exit(1);
+		}
+		bin = (bin + 1) % 4096;
+	}
+	*elapsed = now_seconds() - start;
+	return sent;
+}
+
+void print_null_or(long value)
+{
+	if(value > 0){
+		printf("%li", value);
+	}
+	else{
+		printf("null");
+	}
+}
+
+int main(int argc, const char *argv[])
+{
+	struct sockaddr_in to;
+	struct rusage usage;
+	char prefix[400];
+	long long sent, received;
+	long knee, firstLoss;
+	double elapsed, cpu, loss;
+	pid_t child;
+	int sd, h, r, i, status;
+
+	for(i=1; i<argc; i++){
+		if((strcmp(argv[i], "-receive") == 0) && (i < argc-1)){
+			receivePath = argv[++i];
+		}
+		else if((strcmp(argv[i], "-dir") == 0) && (i < argc-1)){
+			directory = argv[++i];
+		}
+		else if((strcmp(argv[i], "-port") == 0) && (i < argc-1)){
+			port = atoi(argv[++i]);
+		}
+		else if((strcmp(argv[i], "-rates") == 0) && (i < argc-1)){
+			numRates = parse_list(argv[++i], rates, 1, 100000000);
+			if(numRates == 0){
+				printf("Invalid rate list %s.\n", argv[i]);
+				return 1;
+			}
+		}
+		else if((strcmp(argv[i], "-hits") == 0) && (i < argc-1)){
+			numHits = parse_list(argv[++i], hitCounts, 0, MAX_HITS);
+			if(numHits == 0){
+				printf("Invalid hits list %s (0 to %i hits per packet).\n", argv[i], MAX_HITS);
+				return 1;
+			}
+		}
+		else if((strcmp(argv[i], "-time") == 0) && (i < argc-1)){
+			stepTime = atof(argv[++i]);
+		}
+		else if((strcmp(argv[i], "-loss") == 0) && (i < argc-1)){
+			lossThreshold = atof(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--") == 0){
+			extraArgs = argv + i + 1;
+			numExtra = argc - i - 1;
+			break;
+		}
+		else{
+			printf("Usage: %s [-receive <path>] [-dir <directory>] [-port <port>] [-rates <r1,r2,...>]\n"
+				"       [-hits <h1,h2,...>] [-time <seconds>] [-loss <fraction>] [-- <receive options>]\n", argv[0]);
+			return 1;
+		}
+	}
+	if((stepTime <= 0.0) || (access(receivePath, X_OK) != 0)){
+		printf("Nothing to run: %s is not executable or the step time is not positive.\n", receivePath);
+		return 1;
+	}
+
+	sd = socket(AF_INET, SOCK_DGRAM, 0);
+	if(sd < 0){
+		printf("udpbench: cannot open socket\n");
+		return 1;
+	}
+	memset(&to, 0, sizeof(to));
+	to.sin_family = AF_INET;
+	to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	to.sin_port = htons(port);
+	snprintf(prefix, sizeof(prefix), "%s/udpbench%i", directory, (int)getpid());
+	signal(SIGPIPE, SIG_IGN);
+
+	printf("{\"type\":\"config\",\"receive\":\"%s\",\"dir\":\"%s\",\"port\":%i,\"time\":%.3f,\"loss_threshold\":%g,\"cpus\":%li}\n",
+		receivePath, directory, port, stepTime, lossThreshold, sysconf(_SC_NPROCESSORS_ONLN));
+	fflush(stdout);
+
+	for(h=0; h<numHits; h++){
+		knee = 0;
+		firstLoss = 0;
+		for(r=0; r<numRates; r++){
+			/* room for every spectrum sent, so receive never stops on its own */
+			child = start_receive(prefix, (long)(rates[r] * stepTime) / 4096 + 2);
+			if((child < 0) || !wait_for_bind(child)){
+				printf("udpbench: %s did not start listening on port %i.\n", receivePath, port);
+				return 1;
+			}
+			sent = send_packets(sd, &to, rates[r], (int)hitCounts[h], &elapsed);
+
+			/* let the last packets drain, then stop it the way an operator would */
+			usleep(200000);
+			kill(child, SIGINT);
+			memset(&usage, 0, sizeof(usage));
+			wait4(child, &status, 0, &usage);
+			received = count_records(prefix);
+			if(received < 0){
+				printf("udpbench: %s wrote no %s_1.dat or .raw file.\n", receivePath, prefix);
+				return 1;
+			}
+
+			cpu = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+			loss = (sent > 0) ? 1.0 - (double)received / sent : 0.0;
+			if(loss < 0.0){
+				loss = 0.0;
+			}
+			printf("{\"type\":\"step\",\"hits\":%li,\"rate\":%li,\"sent\":%lli,\"received\":%lli,\"loss\":%.6f,"
+				"\"send_rate\":%.1f,\"cpu_us_per_packet\":",
+				hitCounts[h], rates[r], sent, received, loss, sent / elapsed);
+			if(received > 0){
+				printf("%.3f", cpu * 1e6 / received);
+			}
+			else{
+				printf("null");
+			}
+			printf(",\"cpu_percent\":%.1f}\n", 100.0 * cpu / elapsed);
+			fflush(stdout);
+
+			if(loss > lossThreshold){
+				if(firstLoss == 0){
+					firstLoss = rates[r];
+				}
+			}
+			else if(firstLoss == 0){
+				knee = rates[r];
+			}
+		}
+		printf("{\"type\":\"knee\",\"hits\":%li,\"rate\":", hitCounts[h]);
+		print_null_or(knee);
+		printf(",\"first_loss_rate\":");
+		print_null_or(firstLoss);
+		printf("}\n");
+		fflush(stdout);
+	}
+	close(sd);
+	return 0;
+}